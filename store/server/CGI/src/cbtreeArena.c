@@ -0,0 +1,310 @@
+/****************************************************************************************
+*	Copyright (c) 2012, Peter Jekel
+*	All rights reserved.
+*
+*	The Checkbox Tree File Store CGI (cbtreeFileStore) is released under to following
+*	license:
+*
+*	    BSD 2-Clause		(http://thejekels.com/cbtree/LICENSE)
+*
+*	@author		Peter Jekel
+*
+****************************************************************************************
+*
+*	Description:
+*
+*		This module provides the request arena. While an arena is active all memory
+*		requested with arenaAlloc() is carved out of large blocks instead of being
+*		allocated individually, and all of it is released at once by arenaEnd().
+*		Releasing individual allocations with arenaFree() is a no-op while the arena
+*		is active. When no arena is active the functions simply map to malloc() and
+*		free().
+*
+*		The arena is used for the FILE_INFO structs, their strings and the VECTOR
+*		arrays of a file list which are all discarded at the end of a request.
+*		Each thread allocates from its own block, therefore workers of a deep search
+*		only take the arena lock when they need a new block.
+*
+*	@note	Memory allocated before arenaBegin() must not be released with arenaFree()
+*			until after arenaEnd(), and memory allocated from the arena must not be
+*			passed to free() or survive arenaEnd().
+*
+****************************************************************************************/
+#ifdef _MSC_VER
+	#define _CRT_SECURE_NO_WARNINGS
+#endif	/* _MSC_VER */
+
+#include <stdlib.h>
+#include <string.h>
+#ifdef WIN32
+  #include <windows.h>
+#else
+  #include <pthread.h>
+#endif /* WIN32 */
+
+#include "cbtreeArena.h"
+
+#ifdef WIN32
+  typedef CRITICAL_SECTION		MUTEX;
+
+  #define mutexInit(m)			InitializeCriticalSection(m)
+  #define mutexLock(m)			EnterCriticalSection(m)
+  #define mutexUnlock(m)		LeaveCriticalSection(m)
+  #define THREAD_LOCAL			__declspec(thread)
+#else
+  typedef pthread_mutex_t		MUTEX;
+
+  #define mutexInit(m)			pthread_mutex_init((m), NULL)
+  #define mutexLock(m)			pthread_mutex_lock(m)
+  #define mutexUnlock(m)		pthread_mutex_unlock(m)
+  #define THREAD_LOCAL			__thread
+#endif /* WIN32 */
+
+#define ARENA_ALIGN			8		// Alignment of all arena allocations.
+
+#define arenaRound(s)		(((s) + ARENA_ALIGN - 1) & ~((size_t)ARENA_ALIGN - 1))
+
+typedef struct arenaBlock {
+	struct arenaBlock	*pNext;
+	size_t				iSize;			// Number of bytes available for allocations
+	size_t				iUsed;			// Number of bytes allocated
+} ARENA_BLOCK;
+
+#define BLOCK_HDR_SIZE		arenaRound(sizeof(ARENA_BLOCK))
+
+static MUTEX			arenaLock;
+static bool				bLockInit = false;
+static volatile bool	bActive	  = false;
+static unsigned long	lArenaGen = 0;			// Incremented with each new arena
+static ARENA_BLOCK		*pArenaBlocks = NULL;
+static ARENA_STATS		arenaStat = { 0, 0 };
+
+// The current block of each thread, only valid if the thread generation matches.
+static THREAD_LOCAL ARENA_BLOCK		*pThreadBlock;
+static THREAD_LOCAL unsigned long	lThreadGen;
+
+/**
+*	_newBlock
+*
+*		Allocate a new arena block that can hold at least iSize bytes and link it
+*		to the arena.
+*
+*	@param	iSize			Minimum number of bytes available in the block.
+*
+*	@return		Address of the new block or NULL.
+**/
+static ARENA_BLOCK *_newBlock( size_t iSize )
+{
+	ARENA_BLOCK	*pBlock;
+
+	if( iSize < ARENA_BLOCK_SIZE )
+	{
+		iSize = ARENA_BLOCK_SIZE;
+	}
+	if( (pBlock = (ARENA_BLOCK *)malloc( BLOCK_HDR_SIZE + iSize )) )
+	{
+		pBlock->iSize = iSize;
+		pBlock->iUsed = 0;
+
+		mutexLock( &arenaLock );
+		pBlock->pNext = pArenaBlocks;
+		pArenaBlocks  = pBlock;
+		arenaStat.lBlocks++;
+		arenaStat.lBytes += (long)(BLOCK_HDR_SIZE + iSize);
+		mutexUnlock( &arenaLock );
+	}
+	return pBlock;
+}
+
+/**
+*	arenaActive
+*
+*		Returns true if an arena is active.
+**/
+bool arenaActive( void )
+{
+	return bActive;
+}
+
+/**
+*	arenaAlloc
+*
+*		Allocate iSize bytes from the active arena. If no arena is active the memory
+*		is allocated using malloc().
+*
+*	@param	iSize			Number of bytes to allocate.
+*
+*	@return		Address of the allocated memory or NULL.
+**/
+void *arenaAlloc( size_t iSize )
+{
+	ARENA_BLOCK	*pBlock;
+	void		*pvData;
+
+	if( !bActive )
+	{
+		return malloc( iSize );
+	}
+	iSize  = arenaRound( iSize ? iSize : 1 );
+	pBlock = (lThreadGen == lArenaGen) ? pThreadBlock : NULL;
+	if( !pBlock || pBlock->iUsed + iSize > pBlock->iSize )
+	{
+		if( !(pBlock = _newBlock( iSize )) )
+		{
+			return NULL;
+		}
+		// Oversized requests get a block of their own, keep the current block.
+		if( iSize <= ARENA_BLOCK_SIZE / 2 || lThreadGen != lArenaGen || !pThreadBlock )
+		{
+			pThreadBlock = pBlock;
+			lThreadGen   = lArenaGen;
+		}
+	}
+	pvData = (char *)pBlock + BLOCK_HDR_SIZE + pBlock->iUsed;
+	pBlock->iUsed += iSize;
+	return pvData;
+}
+
+/**
+*	arenaBegin
+*
+*		Start a new arena. All memory allocated with arenaAlloc() or arenaCalloc()
+*		until the next call to arenaEnd() is taken from the arena. arenaBegin() must
+*		be called while no other threads are allocating memory from the arena.
+*
+*	@return		True on success otherwise false.
+**/
+bool arenaBegin( void )
+{
+	if( !bLockInit )
+	{
+		mutexInit( &arenaLock );
+		bLockInit = true;
+	}
+	if( bActive )
+	{
+		arenaEnd();
+	}
+	arenaStat.lBlocks = 0;
+	arenaStat.lBytes  = 0;
+	lArenaGen++;
+	bActive = true;
+	return true;
+}
+
+/**
+*	arenaCalloc
+*
+*		Allocate iSize bytes from the active arena and initialize them to zero. If
+*		no arena is active the memory is allocated using calloc().
+*
+*	@param	iSize			Number of bytes to allocate.
+*
+*	@return		Address of the allocated memory or NULL.
+**/
+void *arenaCalloc( size_t iSize )
+{
+	void	*pvData;
+
+	if( !bActive )
+	{
+		return calloc( 1, iSize );
+	}
+	if( (pvData = arenaAlloc( iSize )) )
+	{
+		memset( pvData, 0, iSize );
+	}
+	return pvData;
+}
+
+/**
+*	arenaEnd
+*
+*		Release all memory allocated from the active arena. arenaEnd() must be called
+*		while no other threads are allocating memory from the arena.
+**/
+void arenaEnd( void )
+{
+	ARENA_BLOCK	*pBlock;
+
+	if( bActive )
+	{
+		bActive = false;
+		while( (pBlock = pArenaBlocks) )
+		{
+			pArenaBlocks = pBlock->pNext;
+			free( pBlock );
+		}
+		pThreadBlock = NULL;
+	}
+}
+
+/**
+*	arenaFree
+*
+*		Release memory allocated with arenaAlloc() or arenaCalloc(). If an arena is
+*		active the memory is released by arenaEnd() instead.
+*
+*	@param	pvData			Address of the memory to be released.
+**/
+void arenaFree( void *pvData )
+{
+	if( !bActive )
+	{
+		free( pvData );
+	}
+}
+
+/**
+*	arenaRealloc
+*
+*		Change the size of memory allocated with arenaAlloc(). If an arena is active
+*		and pvData is the most recent allocation of the calling thread the memory is
+*		extended in place if possible, otherwise new memory is allocated and the old
+*		content is copied, the old memory is released by arenaEnd(). If no arena is
+*		active the memory is reallocated using realloc().
+*
+*	@param	pvData			Address of the memory to be resized or NULL.
+*	@param	iOldSize		Current size of the memory in bytes.
+*	@param	iSize			New size in bytes.
+*
+*	@return		Address of the resized memory or NULL in which case the original
+*				memory is left unchanged.
+**/
+void *arenaRealloc( void *pvData, size_t iOldSize, size_t iSize )
+{
+	ARENA_BLOCK	*pBlock;
+	char		*pcBase;
+	void		*pvNew;
+
+	if( !bActive )
+	{
+		return realloc( pvData, iSize );
+	}
+	if( pvData && (pBlock = (lThreadGen == lArenaGen) ? pThreadBlock : NULL) )
+	{
+		pcBase = (char *)pBlock + BLOCK_HDR_SIZE;
+		if( (char *)pvData + arenaRound(iOldSize) == pcBase + pBlock->iUsed &&
+			(char *)pvData + arenaRound(iSize) <= pcBase + pBlock->iSize )
+		{
+			pBlock->iUsed = ((char *)pvData - pcBase) + arenaRound(iSize);
+			return pvData;
+		}
+	}
+	if( (pvNew = arenaAlloc( iSize )) && pvData )
+	{
+		memcpy( pvNew, pvData, (iOldSize < iSize ? iOldSize : iSize) );
+	}
+	return pvNew;
+}
+
+/**
+*	arenaStats
+*
+*		Returns the address of the ARENA_STATS struct of the active, or most recent,
+*		arena.
+**/
+ARENA_STATS *arenaStats( void )
+{
+	return &arenaStat;
+}
@@ -0,0 +1,32 @@
+#ifndef _CBTREE_ARENA_H_
+#define _CBTREE_ARENA_H_
+
+#include <stdlib.h>
+
+#include "cbtreeCommon.h"
+
+#define ARENA_BLOCK_SIZE	262144		// Default size of an arena block (256 KB).
+
+typedef struct arenaStats {
+	long	lBlocks;					// Number of blocks allocated
+	long	lBytes;						// Total number of bytes allocated
+} ARENA_STATS;
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+bool		 arenaActive( void );
+void		*arenaAlloc( size_t iSize );
+bool		 arenaBegin( void );
+void		*arenaCalloc( size_t iSize );
+void		 arenaEnd( void );
+void		 arenaFree( void *pvData );
+void		*arenaRealloc( void *pvData, size_t iOldSize, size_t iSize );
+ARENA_STATS *arenaStats( void );
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif /* _CBTREE_ARENA_H_ */
@@ -26,14 +26,383 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#ifndef WIN32
+  #include <regex.h>
+#endif
 
 #include "cbtreeArgs.h"
+#include "cbtreeCache.h"
 #include "cbtreeCGI.h"
 #include "cbtreeDebug.h"
 #include "cbtreeFiles.h"
 #include "cbtreeJSON.h"
 #include "cbtreeString.h"
 
+/**
+*	_destroyBatch
+*
+*		Release all resources associated with a list of batch operations.
+*
+*	@param	pBatch			Address of an array of BATCH_OP structs
+*	@param	iCount			Number of batch operations.
+**/
+static void _destroyBatch( BATCH_OP *pBatch, int iCount )
+{
+	int		i;
+
+	if( pBatch )
+	{
+		for( i = 0; i < iCount; i++ )
+		{
+			destroy( pBatch[i].pcPath );
+			destroy( pBatch[i].pcNewValue );
+		}
+		destroy( pBatch );
+	}
+}
+
+/**
+*	_getBatchOp
+*
+*		Decode a single batch operation object.
+*
+*			operation		:== '{' op ',' path (',' newValue)? '}'
+*			op				:== '"op"' ':' ('"delete"' | '"rename"')
+*			path			:== '"path"' ':' string
+*			newValue		:== '"newValue"' ':' string		(rename only)
+*
+*	@param	ptOp			Address of a variable data type (the operation object).
+*	@param	pOp				Address BATCH_OP struct receiving the operation.
+*
+*	@return		True if the operation is valid otherwise false.
+**/
+static bool _getBatchOp( DATA *ptOp, BATCH_OP *pOp )
+{
+	DATA	*ptType,
+			*ptPath,
+			*ptValue;
+
+	if( isObject(ptOp) && (ptType = varGetProperty("op", ptOp)) && isString(ptType) &&
+		(ptPath = varGetProperty("path", ptOp)) && isString(ptPath) )
+	{
+		ptValue = varGetProperty("newValue", ptOp);
+		if( !strcmp( varGet(ptType), "delete" ) && !ptValue )
+		{
+			pOp->iMethod = HTTP_V_DELETE;
+		}
+		else if( !strcmp( varGet(ptType), "rename" ) && ptValue && isString(ptValue) )
+		{
+			pOp->iMethod	= HTTP_V_POST;
+			pOp->pcNewValue = mstrcpy( varGet(ptValue) );
+		}
+		else
+		{
+			return false;
+		}
+		pOp->pcPath = mstrcpy( varGet(ptPath) ? varGet(ptPath) : "" );
+		return true;
+	}
+	return false;
+}
+
+/**
+*	_getBatchArgs
+*
+*		Decode the 'operations' parameter of a batch request.  Because a batch may
+*		exceed MAX_BUF_SIZE, the maximum size of any JSON encoded string, each
+*		operation is decoded separately.
+*
+*			operations		:== 'operations' '=' '[' (operation (',' operation)*)? ']'
+*
+*		Example:
+*
+*			[{"op":"delete","path":"logs/old"},{"op":"rename","path":"a.txt","newValue":"b.txt"}]
+*
+*	@param	pPOST			Address of a variable data type. (php style $_POST variable)
+*	@param	pArgs			Address arguments struct
+*	@param	piResult		Address integer receiving the result code HTTP_V_BAD_REQUEST
+*							in case the parameter is invalid, otherwise unchanged.
+**/
+static void _getBatchArgs( DATA *pPOST, ARGS *pArgs, int *piResult )
+{
+	BATCH_OP	*pBatch;
+	DATA		*ptOp;
+	char		cBuffer[MAX_BUF_SIZE],
+				*pcSrc,
+				*pcEnd;
+	bool		bValid;
+	int			iCount = 0;
+
+	pcSrc = strfchr( varGet(cgiGetArgument("operations", pPOST)) );
+	if( !pcSrc || *pcSrc != '[' )
+	{
+		cbtDebug( "operations parameter is not a JSON array." );
+		*piResult = HTTP_V_BAD_REQUEST;
+		return;
+	}
+	// Allocate one operation for each (potential) object in the array.
+	for( pcEnd = pcSrc; (pcEnd = strchr( pcEnd, '{' )); pcEnd++ )
+	{
+		iCount++;
+	}
+	if( !(pBatch = (BATCH_OP *)calloc( iCount + 1, sizeof(BATCH_OP) )) )
+	{
+		*piResult = HTTP_V_SERVER_ERROR;
+		return;
+	}
+	pArgs->pBatch = pBatch;
+
+	pcSrc = strfchr( pcSrc + 1 );
+	for( bValid = true; bValid && *pcSrc != ']'; )
+	{
+		bValid = false;
+		if( *pcSrc == '{' && (pcEnd = strpair( pcSrc, '{', '}' )) && (pcEnd - pcSrc) < (int)sizeof(cBuffer)-1 )
+		{
+			strncpyz( cBuffer, pcSrc, (pcEnd - pcSrc) + 1 );
+			if( (ptOp = jsonDecode( cBuffer )) )
+			{
+				if( (bValid = _getBatchOp( ptOp, &pBatch[pArgs->iBatchCount] )) )
+				{
+					pArgs->iBatchCount++;
+				}
+				destroy( ptOp );
+			}
+			pcSrc = strfchr( pcEnd + 1 );
+			if( *pcSrc == ',' )
+			{
+				pcSrc = strfchr( pcSrc + 1 );
+				bValid = bValid && (*pcSrc == '{');
+			}
+			else
+			{
+				bValid = bValid && (*pcSrc == ']');
+			}
+		}
+	}
+	if( !bValid || *strfchr( pcSrc + 1 ) )
+	{
+		cbtDebug( "operations parameter contains an invalid operation." );
+		*piResult = HTTP_V_BAD_REQUEST;
+	}
+}
+
+/**
+*	_getFieldArgs
+*
+*		Returns the property mask (PROP_M_xxx) of the file properties requested by
+*		the 'fields' parameter. If the parameter is omitted all file properties are
+*		requested.
+*
+*			fields			:== 'fields' '=' '[' (property (',' property)*)? ']'
+*			property		:== '"' ('name' | 'path' | 'directory' | 'size' | 'modified') '"'
+*
+*		Example:
+*
+*			fields=["name", "directory"]
+*
+*	@param	pGET			Address of a variable data type. (php style $_GET variable)
+*	@param	piResult		Address integer receiving the result code HTTP_V_BAD_REQUEST
+*							in case the parameter is invalid, otherwise unchanged.
+*
+*	@return		Integer property mask.
+**/
+static int _getFieldArgs( DATA *pGET, int *piResult )
+{
+	DATA	*ptFields,
+			*ptField;
+	int		iPropMask = PROP_M_FIELDS,
+			iMask,
+			i;
+
+	if( cgiGetArgument( "fields", pGET ) )
+	{
+		if( (ptFields = jsonDecode( cgiGetArgument("fields", pGET))) && isArray(ptFields) )
+		{
+			iPropMask = PROP_M_UNKNOWN;
+			for( i = 0; (ptField = varGetByIndex( i, ptFields )); i++ )
+			{
+				if( !isString(ptField) || !(iMask = getPropertyMask( varGet(ptField) )) )
+				{
+					cbtDebug( "fields parameter contains an invalid property." );
+					*piResult = HTTP_V_BAD_REQUEST;
+					break;
+				}
+				iPropMask |= iMask;
+			}
+		}
+		else // Ill formatted JSON array
+		{
+			cbtDebug( "fields parameter is not a valid JSON array." );
+			*piResult = HTTP_V_BAD_REQUEST;
+		}
+		destroy( ptFields );
+	}
+	return iPropMask;
+}
+
+/**
+*	_getIndexArg
+*
+*		Returns the value of an optional, non-negative, integer query string
+*		parameter like 'start' or 'count'.
+*
+*	@param	pcName			Address C-string containing the parameter name.
+*	@param	pGET			Address of a variable data type. (php style $_GET variable)
+*	@param	iDefault		Value returned if the parameter is omitted.
+*	@param	piResult		Address integer receiving the result code HTTP_V_BAD_REQUEST
+*							in case the parameter is invalid, otherwise unchanged.
+*
+*	@return		Integer parameter value.
+**/
+static int _getIndexArg( const char *pcName, DATA *pGET, int iDefault, int *piResult )
+{
+	DATA	*ptArg;
+
+	if( (ptArg = cgiGetArgument( pcName, pGET )) )
+	{
+		if( isInteger(ptArg) && (int)(size_t)varGet(ptArg) >= 0 )
+		{
+			return (int)(size_t)varGet( ptArg );
+		}
+		cbtDebug( "%s parameter is not a positive integer.", pcName );
+		*piResult = HTTP_V_BAD_REQUEST;
+	}
+	return iDefault;
+}
+
+/**
+*	_getSinceArg
+*
+*		Returns the decoded change feed token of the optional 'since' query string
+*		parameter.
+*
+*			since	:== 'since' '=' ('0' | token)
+*
+*	@param	pGET			Address of a variable data type. (php style $_GET variable)
+*	@param	piResult		Address integer receiving the result code HTTP_V_BAD_REQUEST
+*							in case the token is invalid, otherwise unchanged.
+*
+*	@return		Address JOURNAL_TOKEN struct or NULL if the parameter is omitted.
+**/
+static JOURNAL_TOKEN *_getSinceArg( DATA *pGET, int *piResult )
+{
+	JOURNAL_TOKEN	*pToken = NULL;
+	DATA			*ptArg;
+	bool			bValid;
+
+	if( (ptArg = cgiGetArgument( "since", pGET )) )
+	{
+		if( (pToken = (JOURNAL_TOKEN *)calloc( 1, sizeof(JOURNAL_TOKEN) )) )
+		{
+			if( isInteger(ptArg) )
+			{
+				bValid = ((int)(size_t)varGet(ptArg) == 0);
+			}
+			else
+			{
+				bValid = isString(ptArg) && journalParse( strtrim(varGet(ptArg), TRIM_M_QUOTES), pToken );
+			}
+			if( !bValid )
+			{
+				cbtDebug( "since parameter is not a valid token." );
+				*piResult = HTTP_V_BAD_REQUEST;
+			}
+		}
+		else
+		{
+			*piResult = HTTP_V_SERVER_ERROR;
+		}
+	}
+	return pToken;
+}
+
+/**
+*	_getSortField
+*
+*		Decode a single sort field object and append it to the list of sort fields.
+*		Sort fields with an unknown attribute are ignored, that is, all files are
+*		considered equal with regards to that attribute.
+*
+*			sort-field		:== '{' attribute (',' descending)? (',' ignoreCase)? '}'
+*			attribute		:== '"attribute"' ':' string
+*			descending		:== '"descending"' ':' ('true' | 'false')
+*			ignoreCase		:== '"ignoreCase"' ':' ('true' | 'false')
+*
+*	@param	ptField			Address of a variable data type (the sort field object).
+*	@param	pArgs			Address arguments struct
+*	@param	piResult		Address integer receiving the result code HTTP_V_BAD_REQUEST
+*							in case the sort field is invalid, otherwise unchanged.
+**/
+static void _getSortField( DATA *ptField, ARGS *pArgs, int *piResult )
+{
+	SORT_FIELD	*pSortField;
+	DATA		*ptAttr;
+	int			iProperty;
+
+	if( !isObject(ptField) || !(ptAttr = varGetProperty("attribute", ptField)) || !isString(ptAttr) )
+	{
+		cbtDebug( "sort parameter contains an invalid sort field." );
+		*piResult = HTTP_V_BAD_REQUEST;
+		return;
+	}
+	if( (iProperty = getPropertyMask( varGet(ptAttr) )) && pArgs->iSortFields < MAX_SORT_FIELDS )
+	{
+		pSortField = &pArgs->sSortFields[pArgs->iSortFields++];
+		pSortField->iProperty	= iProperty;
+		pSortField->bDescending = (bool)(size_t)varGet( varGetProperty("descending", ptField) );
+		pSortField->bIgnoreCase = (bool)(size_t)varGet( varGetProperty("ignoreCase", ptField) );
+	}
+}
+
+/**
+*	_getSortArgs
+*
+*		Decode the 'sort' parameter. The sort parameter is a sort field object or
+*		an array of sort field objects. The files are sorted in the order in which
+*		the sort fields appear in the array. Files that compare equal retain their
+*		natural order, that is, the order in which they were found.
+*
+*			sort			:== 'sort' '=' (sort-field | '[' (sort-field (',' sort-field)*)? ']')
+*
+*		Example:
+*
+*			sort=[{"attribute":"directory", "descending":true}, {"attribute":"name"}]
+*
+*	@param	pGET			Address of a variable data type. (php style $_GET variable)
+*	@param	pArgs			Address arguments struct
+*	@param	piResult		Address integer receiving the result code HTTP_V_BAD_REQUEST
+*							in case the parameter is invalid, otherwise unchanged.
+**/
+static void _getSortArgs( DATA *pGET, ARGS *pArgs, int *piResult )
+{
+	DATA	*ptSort,
+			*ptField;
+	int		i;
+
+	if( cgiGetArgument( "sort", pGET ) )
+	{
+		if( (ptSort = jsonDecode( cgiGetArgument("sort", pGET))) && isArray(ptSort) )
+		{
+			for( i = 0; (ptField = varGetByIndex( i, ptSort )); i++ )
+			{
+				_getSortField( ptField, pArgs, piResult );
+			}
+		}
+		else if( ptSort && isObject(ptSort) )
+		{
+			_getSortField( ptSort, pArgs, piResult );
+		}
+		else // Ill formatted JSON
+		{
+			cbtDebug( "sort parameter is not a valid JSON object or array." );
+			*piResult = HTTP_V_BAD_REQUEST;
+		}
+		destroy( ptSort );
+	}
+}
+
 /**
 *	_getOptionArgs
 *
@@ -51,8 +420,8 @@
 *
 *		Example:
 *
-*			queryOptions={"deep":true, "ignoreCase":false}
-*			options=["dirsOnly", "showHiddenFiles"]
+*			queryOptions={"deep":true, "ignoreCase":false, "depth":2}
+*			options=["dirsOnly", "showHiddenFiles", "aggregate"]
 *
 *	@note:	Strict JSON encoding rules are enforced when decoding parameters.
 *
@@ -66,16 +435,18 @@ static OPTIONS * _getOptionArgs( DATA *pGET, int *piResult )
 {
 	OPTIONS	*pOptions;
 	DATA	*ptQueryOptions,
-			*ptOptions;
+			*ptOptions,
+			*ptDepth;
 			
 	if( (pOptions = (OPTIONS *)calloc(1, sizeof(OPTIONS))) )
 	{
-		if( hasProperty( "options", pGET ) )
+		if( cgiGetArgument( "options", pGET ) )
 		{
-			if( (ptOptions = jsonDecode( varGetProperty("options", pGET))) )
+			if( (ptOptions = jsonDecode( cgiGetArgument("options", pGET))) )
 			{
 				pOptions->bShowHiddenFiles = varInArray("showHiddenFiles", ptOptions);
 				pOptions->bDebug		   = varInArray("debug", ptOptions);
+				pOptions->bAggregate	   = varInArray("aggregate", ptOptions);
 
 				destroy( ptOptions );
 			}
@@ -88,12 +459,24 @@ static OPTIONS * _getOptionArgs( DATA *pGET, int *piResult )
 			}
 		}
 
-		if( hasProperty( "queryOptions", pGET ) )
+		if( cgiGetArgument( "queryOptions", pGET ) )
 		{
-			if( (ptQueryOptions = jsonDecode( varGetProperty("queryOptions", pGET))) )
+			if( (ptQueryOptions = jsonDecode( cgiGetArgument("queryOptions", pGET))) )
 			{
 				pOptions->bIgnoreCase = (bool)varGet( varGetProperty("ignoreCase", ptQueryOptions) );
 				pOptions->bDeep		  = (bool)varGet( varGetProperty("deep", ptQueryOptions) );
+				if( (ptDepth = varGetProperty("depth", ptQueryOptions)) )
+				{
+					if( !isInteger(ptDepth) || (int)(size_t)varGet(ptDepth) < 0 )
+					{
+						cbtDebug( "queryOptions depth is not a positive integer." );
+						*piResult = HTTP_V_BAD_REQUEST;
+						destroy( ptQueryOptions );
+						destroy( pOptions );
+						return NULL;
+					}
+					pOptions->iMaxDepth = (int)(size_t)varGet( ptDepth );
+				}
 				destroy( ptQueryOptions );
 			}
 			else // Ill formatted JSON object
@@ -113,6 +496,207 @@ static OPTIONS * _getOptionArgs( DATA *pGET, int *piResult )
 	return pOptions;
 }
 
+/**
+*	_destroyQuery
+*
+*		Release all resources associated with a struct of type QUERY
+*
+*	@param	pQuery			Address of a struct of type QUERY
+**/
+static void _destroyQuery( QUERY *pQuery )
+{
+	if( pQuery )
+	{
+#ifndef WIN32
+		if( pQuery->pvRegex )
+		{
+			regfree( (regex_t *)pQuery->pvRegex );
+		}
+#endif
+		destroy( pQuery->pvRegex );
+		destroy( pQuery->pcName );
+		destroy( pQuery );
+	}
+}
+
+/**
+*	_getNameQuery
+*
+*		Decode the name property of a query. The name is either a wildcard pattern
+*		or an object with a POSIX extended regular expression.
+*
+*			name			:== '"name"' ':' (string | '{' '"regex"' ':' string '}')
+*
+*	@param	ptName			Address of a variable data type (the name property).
+*	@param	pQuery			Address of a struct of type QUERY
+*
+*	@return		True if the name property is valid otherwise false.
+**/
+static bool _getNameQuery( DATA *ptName, QUERY *pQuery )
+{
+	DATA	*ptRegex;
+
+	if( isString(ptName) )
+	{
+		return ((pQuery->pcName = mstrcpy( varGet(ptName) )) != NULL);
+	}
+	if( isObject(ptName) && (ptRegex = varGetProperty("regex", ptName)) && isString(ptRegex) )
+	{
+#ifndef WIN32
+		if( (pQuery->pvRegex = calloc(1, sizeof(regex_t))) )
+		{
+			if( !regcomp( (regex_t *)pQuery->pvRegex, varGet(ptRegex), 
+						  REG_EXTENDED | REG_NOSUB | (pQuery->bIgnoreCase ? REG_ICASE : 0)) )
+			{
+				return true;
+			}
+			destroy( pQuery->pvRegex );
+			pQuery->pvRegex = NULL;
+		}
+#else
+		cbtDebug( "regular expressions are not supported." );
+#endif	/* WIN32 */
+	}
+	return false;
+}
+
+/**
+*	_getRangeQuery
+*
+*		Decode a numeric range of a query. A range is either a single number or an
+*		object with an optional lower and upper bound, both bounds are inclusive.
+*
+*			range			:== number | '{' ('"min"' ':' number)? (',' '"max"' ':' number)? '}'
+*
+*	@param	ptRange			Address of a variable data type (the range property).
+*	@param	pllMin			Address long long receiving the lower bound.
+*	@param	pllMax			Address long long receiving the upper bound.
+*
+*	@return		True if the range is valid otherwise false.
+**/
+static bool _getRangeQuery( DATA *ptRange, long long *pllMin, long long *pllMax )
+{
+	DATA	*ptMin,
+			*ptMax;
+
+	if( isInteger(ptRange) )
+	{
+		*pllMin = *pllMax = varGetInteger( ptRange );
+		return true;
+	}
+	if( isObject(ptRange) )
+	{
+		ptMin = varGetProperty( "min", ptRange );
+		ptMax = varGetProperty( "max", ptRange );
+		if( (!ptMin || isInteger(ptMin)) && (!ptMax || isInteger(ptMax)) )
+		{
+			if( ptMin ) *pllMin = varGetInteger( ptMin );
+			if( ptMax ) *pllMax = varGetInteger( ptMax );
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+*	_getQueryArgs
+*
+*		Returns the address of a QUERY struct with the 'query' parameter compiled.
+*		A file matches the query if it matches all query properties. The 'ignoreCase'
+*		query option applies to the name property.
+*
+*			query			:== 'query' '=' '{' (query-prop (',' query-prop)*)? '}'
+*			query-prop		:== name | size | modified | directory
+*			name			:== '"name"' ':' (string | '{' '"regex"' ':' string '}')
+*			size			:== '"size"' ':' range
+*			modified		:== '"modified"' ':' range
+*			directory		:== '"directory"' ':' ('true' | 'false')
+*
+*		Example:
+*
+*			query={"name":"*.txt", "size":{"min":1024}}
+*			query={"name":{"regex":"^img[0-9]+\\.png$"}, "directory":false}
+*
+*	@param	pGET			Address of a variable data type. (php style $_GET variable)
+*	@param	pOptions		Address of the query options struct
+*	@param	piResult		Address integer receiving the result code HTTP_V_BAD_REQUEST
+*							in case the parameter is invalid, otherwise unchanged.
+*
+*	@return		Address of a QUERY struct or NULL if there is no valid query.
+**/
+static QUERY *_getQueryArgs( DATA *pGET, OPTIONS *pOptions, int *piResult )
+{
+	QUERY	*pQuery;
+	DATA	*ptQuery,
+			*ptKeys,
+			*ptKey,
+			*ptValue;
+	bool	bValid = true;
+	int		iProperty,
+			i;
+
+	if( !cgiGetArgument( "query", pGET ) )
+	{
+		return NULL;
+	}
+	if( !(ptQuery = jsonDecode( cgiGetArgument("query", pGET))) || !isObject(ptQuery) )
+	{
+		cbtDebug( "query parameter is not a valid JSON object." );
+		*piResult = HTTP_V_BAD_REQUEST;
+		destroy( ptQuery );
+		return NULL;
+	}
+	if( !(pQuery = (QUERY *)calloc(1, sizeof(QUERY))) )
+	{
+		*piResult = HTTP_V_SERVER_ERROR;
+		destroy( ptQuery );
+		return NULL;
+	}
+	pQuery->bIgnoreCase  = pOptions->bIgnoreCase;
+	pQuery->llMinSize	 = pQuery->llMinModified = LLONG_MIN;
+	pQuery->llMaxSize	 = pQuery->llMaxModified = LLONG_MAX;
+
+	ptKeys = varGetProperties( ptQuery );
+	for( i = 0; bValid && (ptKey = varGetByIndex( i, ptKeys )); i++ )
+	{
+		ptValue   = varGetProperty( varGet(ptKey), ptQuery );
+		iProperty = getPropertyMask( varGet(ptKey) );
+		switch( iProperty )
+		{
+			case PROP_M_NAME:
+				bValid = _getNameQuery( ptValue, pQuery );
+				break;
+			case PROP_M_SIZE:
+				bValid = _getRangeQuery( ptValue, &pQuery->llMinSize, &pQuery->llMaxSize );
+				break;
+			case PROP_M_MODIFIED:
+				bValid = _getRangeQuery( ptValue, &pQuery->llMinModified, &pQuery->llMaxModified );
+				break;
+			case PROP_M_DIRECTORY:
+				if( (bValid = isBool(ptValue)) )
+				{
+					pQuery->bDirectory = (bool)(size_t)varGet( ptValue );
+				}
+				break;
+			default:
+				bValid = false;
+				break;
+		}
+		pQuery->iPropMask |= iProperty;
+	}
+	destroy( ptKeys );
+	destroy( ptQuery );
+
+	if( !bValid )
+	{
+		cbtDebug( "query parameter contains an invalid property." );
+		*piResult = HTTP_V_BAD_REQUEST;
+		_destroyQuery( pQuery );
+		return NULL;
+	}
+	return pQuery;
+}
+
 /**
 *	destroyArguments
 *
@@ -124,8 +708,11 @@ void destroyArguments( ARGS **ppArgs )
 {
 	if( ppArgs && *ppArgs )
 	{
-		destroy( (*ppArgs)->pOptions );
-		destroy( *ppArgs );
+		_destroyQuery( (*ppArgs)->pQuery );
+		_destroyBatch( (*ppArgs)->pBatch, (*ppArgs)->iBatchCount );
+		free( (*ppArgs)->pSince );
+		free( (*ppArgs)->pOptions );
+		free( *ppArgs );
 		*ppArgs = NULL;
 	}
 }
@@ -137,16 +724,18 @@ void destroyArguments( ARGS **ppArgs )
 *		extracted and decoded. The query string parameters (args) supported are:
 *
 *			query-string  ::= (qs-param ('&' qs-param)*)?
-*			qs-param	  ::= authToken | basePath | path | query | queryOptions | options | 
-*							  start | count |sort
+*			qs-param	  ::= authToken | basePath | fields | path | query | queryOptions | 
+*							  options | start | count | since | sort
 *			authToken	  ::= 'authToken' '=' json-object
 *			basePath	  ::= 'basePath' '=' path-rfc3986
+*			fields		  ::= 'fields' '=' array
 *			path		  ::= 'path' '=' path-rfc3986
-*			query		  ::= 'query' '=' object
+*			query		  ::= 'query' '=' object			(see _getQueryArgs)
 *			query-options ::= 'queryOptions' '=' object
 *			options		  ::= 'options' '=' array
 *			start		  ::= 'start' '=' number
 *			count		  ::= 'count' '=' number
+*			since		  ::= 'since' '=' string		(see _getSinceArg)
 *			sort		  ::= 'sort' '=' array
 *
 *	@note:	All of the above parameters are optional.
@@ -162,17 +751,43 @@ ARGS *getArguments( int *piResult )
 	DATA	*pCBTREE = NULL;
 	DATA	*ptARGS = NULL,
 			*ptArg;
-	int		iResult = HTTP_V_OK;	// Assume success
+	int		iResult = HTTP_V_OK,	// Assume success
+			i;
 	
 	if( (pArgs = (ARGS *)calloc(1, sizeof(ARGS))) )
 	{
+		pArgs->iPropMask = PROP_M_FIELDS;
+		pArgs->iThreads	 = 1;
+		pArgs->iCount	 = -1;
 		pCBTREE = cgiGetProperty("_CBTREE");	// Get CBTREE environment variables.
+		if( (ptArg = varGetProperty("CBTREE_THREADS", pCBTREE)) && isInteger(ptArg) )
+		{
+			pArgs->iThreads = (int)(size_t)varGet( ptArg );
+		}
+		if( (ptArg = varGetProperty("CBTREE_CACHE_DIR", pCBTREE)) && isString(ptArg) )
+		{
+			pArgs->pcCacheDir = varGet( ptArg );
+		}
+		if( (ptArg = varGetProperty("CBTREE_SNAPSHOT", pCBTREE)) && isString(ptArg) )
+		{
+			pArgs->pcSnapshot = varGet( ptArg );
+		}
+		if( (ptArg = varGetProperty("CBTREE_JOURNAL", pCBTREE)) && isString(ptArg) )
+		{
+			pArgs->pcJournal = varGet( ptArg );
+		}
+		pArgs->iCacheSize = CACHE_V_DEFAULT_SIZE;
+		if( (ptArg = varGetProperty("CBTREE_CACHE_SIZE", pCBTREE)) && isInteger(ptArg) )
+		{
+			pArgs->iCacheSize = (int)(size_t)varGet( ptArg );
+		}
 		switch( cgiGetMethodId() ) 
 		{
 			case HTTP_V_DELETE:
+				pArgs->bLive = true;
 				if( (ptARGS = cgiGetProperty( "_GET" )) )
 				{
-					if( !hasProperty("path", ptARGS) )
+					if( !cgiGetArgument("path", ptARGS) )
 					{
 						iResult = HTTP_V_BAD_REQUEST;
 					}
@@ -181,14 +796,22 @@ ARGS *getArguments( int *piResult )
 				break;
 				
 			case HTTP_V_GET:
+			case HTTP_V_HEAD:
 				if( (ptARGS = cgiGetProperty( "_GET" )) )
 				{
 					// Parse the general options, if any..
 					if( !(pArgs->pOptions = _getOptionArgs( ptARGS, &iResult )) )
 					{
 						destroyArguments( &pArgs );
+						*piResult = iResult;
 						return NULL;
 					}
+					pArgs->pQuery	 = _getQueryArgs( ptARGS, pArgs->pOptions, &iResult );
+					pArgs->iPropMask = _getFieldArgs( ptARGS, &iResult );
+					pArgs->iStart	 = _getIndexArg( "start", ptARGS, 0, &iResult );
+					pArgs->iCount	 = _getIndexArg( "count", ptARGS, -1, &iResult );
+					pArgs->pSince	 = _getSinceArg( ptARGS, &iResult );
+					_getSortArgs( ptARGS, pArgs, &iResult );
 				}
 				else // No QUERY-STRING
 				{
@@ -198,12 +821,19 @@ ARGS *getArguments( int *piResult )
 				break;
 
 			case HTTP_V_POST:
+				pArgs->bLive = true;
+				// Get the options first, a successful _getOptionArgs() resets the result.
+				pArgs->pOptions = _getOptionArgs( NULL, &iResult ); 
 				if( (ptARGS = cgiGetProperty( "_POST" )) )
 				{
-					if( hasProperty("newValue", ptARGS) &&
-						hasProperty("path", ptARGS) )
+					if( cgiGetArgument("operations", ptARGS) )
 					{
-						ptArg = varGetProperty("newValue", ptARGS);
+						_getBatchArgs( ptARGS, pArgs, &iResult );
+					}
+					else if( cgiGetArgument("newValue", ptARGS) &&
+						cgiGetArgument("path", ptARGS) )
+					{
+						ptArg = cgiGetArgument("newValue", ptARGS);
 						if( isString(ptArg) )
 						{
 							pArgs->pcNewValue = varGet( ptArg );
@@ -222,17 +852,27 @@ ARGS *getArguments( int *piResult )
 				{
 					iResult = HTTP_V_BAD_REQUEST;
 				}
-				pArgs->pOptions = _getOptionArgs( NULL, &iResult ); 
 				break;
 		}
 
+		// File properties required, whether returned or not.
+		pArgs->iNeedMask = pArgs->iPropMask | (pArgs->pQuery ? pArgs->pQuery->iPropMask : 0);
+		for( i = 0; i < pArgs->iSortFields; i++ )
+		{
+			pArgs->iNeedMask |= pArgs->sSortFields[i].iProperty;
+		}
+		if( pArgs->pOptions && pArgs->pOptions->bAggregate )
+		{
+			pArgs->iNeedMask |= PROP_M_SIZE;
+		}
+
 		if( iResult == HTTP_V_OK )
 		{		
 			// Get and validate the basePath if any.
 			pArgs->pcBasePath = varGet(varGetProperty("CBTREE_BASEPATH", pCBTREE));
 			if( !pArgs->pcBasePath )
 			{
-				if((ptArg = varGetProperty("basePath", ptARGS)) )
+				if((ptArg = cgiGetArgument("basePath", ptARGS)) )
 				{
 					if( isString(ptArg) )
 					{
@@ -245,7 +885,7 @@ ARGS *getArguments( int *piResult )
 				}
 			}
 			// Validate the path if any.
-			if( (ptArg = varGetProperty("path", ptARGS)) )
+			if( (ptArg = cgiGetArgument("path", ptARGS)) )
 			{
 				if( isString(ptArg) )
 				{
@@ -256,9 +896,9 @@ ARGS *getArguments( int *piResult )
 					iResult = HTTP_V_BAD_REQUEST;
 				}
 			}
-			if( hasProperty( "authToken", ptARGS ) )
+			if( cgiGetArgument( "authToken", ptARGS ) )
 			{
-				if( (ptArg = jsonDecode(varGetProperty("authToken", ptARGS))) && isObject(ptArg) )
+				if( (ptArg = jsonDecode(cgiGetArgument("authToken", ptARGS))) && isObject(ptArg) )
 				{
 					pArgs->pAuthToken = ptArg;
 				}
@@ -2,6 +2,7 @@
 #define _CBTREE_ARGS_H_
 
 #include "cbtreeTypes.h"
+#include "cbtreeJournal.h"
 #include "cbtreeList.h"
 
 typedef struct options {
@@ -9,15 +10,60 @@ typedef struct options {
 	bool	bIgnoreCase;			// Match filename and path case insensitive.
 	bool	bShowHiddenFiles;		// Indicate if hidden files are to be included.
 	bool	bDebug;					// Indicate if debug information need to be generated.
+	int		iMaxDepth;				// Maximum number of levels of a deep search (0 = unlimited).
+	bool	bAggregate;				// Indicate if directory subtree totals are to be returned.
 } OPTIONS;
 
+#define MAX_SORT_FIELDS		8		// Maximum number of sort fields.
+
+typedef struct sortField {
+	int		iProperty;				// File property to sort on (PROP_M_xxx)
+	bool	bDescending;			// Sort in descending order.
+	bool	bIgnoreCase;			// Compare strings case insensitive.
+} SORT_FIELD;
+
+typedef struct query {
+	int		iPropMask;				// File properties tested by the query (PROP_M_xxx)
+	char	*pcName;				// Filename wildcard pattern
+	void	*pvRegex;				// Compiled filename regular expression (regex_t)
+	long long	llMinSize;			// Minimum file size
+	long long	llMaxSize;			// Maximum file size
+	long long	llMinModified;		// Minimum last modified time
+	long long	llMaxModified;		// Maximum last modified time
+	bool	bDirectory;				// Match directories only if true, files only if false.
+	bool	bIgnoreCase;			// Match filename case insensitive.
+} QUERY;
+
+// Single operation of a batch request.
+typedef struct batchOp {
+	int		iMethod;				// HTTP_V_DELETE or HTTP_V_POST (rename)
+	char	*pcPath;				// Path of the file relative to the root directory
+	char	*pcNewValue;			// New path of the file (rename only)
+} BATCH_OP;
+
 typedef struct arguments {
 	const char	*pcBasePath;		// Pointer to a C-string containing the base path
 	const char	*pcPath;			// Pointer to a C-string containing the path
 	char		*pcNewValue;		// Pointer to a C-string containing the new attribute value
 	DATA		*pAuthToken;		// Custom authentication token.
 	OPTIONS		*pOptions;			// Pointer to the query options struct
-	LIST		*pQueryList;		// Address query arguments list
+	int			iPropMask;			// File properties requested (PROP_M_xxx)
+	int			iThreads;			// Number of threads used for a deep search
+	const char	*pcCacheDir;		// Directory listing cache directory or NULL
+	int			iCacheSize;			// Directory listing cache size cap in kilobytes
+	const char	*pcSnapshot;		// File tree snapshot file or NULL
+	const char	*pcJournal;			// Mutation journal file or NULL
+	JOURNAL_TOKEN	*pSince;		// Change feed token or NULL
+	int			iStart;				// Index of the first directory child returned.
+	int			iCount;				// Maximum number of directory children returned (-1 = all)
+	int			iNeedMask;			// File properties required to search and sort (PROP_M_xxx)
+	int			iSortFields;		// Number of sort fields
+	SORT_FIELD	sSortFields[MAX_SORT_FIELDS];
+	QUERY		*pQuery;			// Compiled query or NULL if all files match
+	BATCH_OP	*pBatch;			// Batch operations or NULL
+	int			iBatchCount;		// Number of batch operations
+	bool		bLive;				// Search the live file system only, never the
+									// resident file tree or snapshot (mutations).
 } ARGS;
 
 #ifdef __cplusplus
@@ -20,6 +20,15 @@
 *			_SERVER		(php: $_SERVER)
 *			_GET		(php: $_GET) 
 *
+*		or, in case of a HTTP POST request, _SERVER and _POST (php: $_POST). The
+*		request content is read as specified by CONTENT_LENGTH. A JSON array of
+*		batch operations is stored as the _POST 'operations' property.
+*
+*		The _SERVER properties are loaded from the environment on first use. The
+*		query string or request content is split into parameters in a single pass
+*		and decoded in place, a parameter is only converted into a _GET or _POST
+*		property when it is requested using cgiGetArgument().
+*
 ****************************************************************************************/
 #ifdef _MSC_VER
 	#define _CRT_SECURE_NO_WARNINGS
@@ -28,6 +37,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "cbtreeCommon.h"
 #include "cbtreeDebug.h"
@@ -39,7 +49,7 @@
 static METHOD	httpMethods[] = {
 		{ HTTP_V_OPTIONS,	"OPTIONS",	false },
 		{ HTTP_V_GET,		"GET",		true },		// Allowed by default
-		{ HTTP_V_HEAD,		"HEAD",		false },
+		{ HTTP_V_HEAD,		"HEAD",		true },		// Allowed by default
 		{ HTTP_V_POST,		"POST",		false },
 		{ HTTP_V_PUT,		"PUT",		false },
 		{ HTTP_V_DELETE,	"DELETE",	false },
@@ -52,6 +62,7 @@ static METHOD	httpMethods[] = {
 static STATUS	httpStatus[] = {
 		{ HTTP_V_OK,					200, "OK" },
 		{ HTTP_V_NO_CONTENT,			204, "No Content" },
+		{ HTTP_V_NOT_MODIFIED,			304, "Not Modified" },
 		{ HTTP_V_BAD_REQUEST,			400, "Bad Request" },
 		{ HTTP_V_UNAUTHORIZED,			401, "Unauthorized" },
 		{ HTTP_V_FORBIDDEN,				403, "Forbidden" },
@@ -94,6 +105,8 @@ static const char *cgiVarNames[] = {
 	"HTTP_COOKIE",
 	"HTTP_FORWARDED",
 	"HTTP_HOST",
+	"HTTP_IF_MODIFIED_SINCE",
+	"HTTP_IF_NONE_MATCH",
 	"HTTP_PRAGMA",
 	"HTTP_REFERER",
 	"HTTP_USER_AGENT",
@@ -103,12 +116,32 @@ static const char *cgiVarNames[] = {
 // Declare CBTREE specific configuration variables
 static const char *cgiCbtreeNames[] = { 
 	"CBTREE_BASEPATH",
+	"CBTREE_CACHE_DIR",
+	"CBTREE_CACHE_SIZE",
+	"CBTREE_DAEMON_SOCKET",
+	"CBTREE_JOURNAL",
 	"CBTREE_METHODS",
+	"CBTREE_SNAPSHOT",
+	"CBTREE_THREADS",
 	NULL
 	};
 
 
+typedef struct cgiParam {
+	const char	*pcName;		// Decoded parameter name
+	char		*pcValue;		// Decoded parameter value
+	DATA		*ptValue;		// Parameter as a _GET or _POST property, if requested
+	bool		bString;		// Parameter value is always a string
+} CGI_PARAM;
+
 static DATA *cgiEnvironment = NULL;
+static DATA_KEY cgiServerKey = VAR_KEY( "_SERVER" );
+
+static CGI_PARAM	*cgiParams	   = NULL;		// Query string or request content parameters
+static char			*cgiParamBuf   = NULL;		// Buffer holding the parameter strings
+static DATA			*cgiArgs	   = NULL;		// The _GET or _POST variable
+static int			cgiParamCount  = 0,
+					cgiParamSize   = 0;
 
 FILE	*phResp = NULL;
 
@@ -184,6 +217,193 @@ static STATUS * _cgiGetStatus( int iStatus )
 	return NULL;
 }
 
+/**
+*	_cgiCopy
+*
+*		Returns a copy of the first iLength characters of a C-string. The copy is
+*		padded with zeros so isData() never probes beyond the end of the buffer.
+*
+*	@note	The caller is responsible to free the returned copy.
+*
+*	@param	pcSrc			Address C-string.
+*	@param	iLength			Number of characters to copy.
+*
+*	@return		Address zero terminated copy or NULL.
+**/
+static char *_cgiCopy( const char *pcSrc, size_t iLength )
+{
+	char	*pcCopy;
+
+	if( (pcCopy = (char *)calloc( 1, iLength + 1 + sizeof(DATA) )) )
+	{
+		memcpy( pcCopy, pcSrc, iLength );
+	}
+	return pcCopy;
+}
+
+/**
+*	_cgiLoadVar
+*
+*		Load a CGI variable from the environment and add it to the _SERVER variable.
+*		Only known CGI variables are loaded, a variable that isn't set is added with
+*		an empty value.
+*
+*	@param	pcName			Address C-string containing the variable name.
+*	@param	ptSERVER		Address of the _SERVER variable.
+*
+*	@return		Address of the new _SERVER property or NULL.
+**/
+static DATA *_cgiLoadVar( const char *pcName, DATA *ptSERVER )
+{
+	DATA	*ptProperty = NULL;
+	char	*pcValue,
+			*pcCopy = NULL;
+	int		i;
+
+	for( i=0; cgiVarNames[i]; i++ )
+	{
+		if( !strcmp( pcName, cgiVarNames[i] ) )
+		{
+			// Copy the value first, isData() must never probe beyond the end of the
+			// environment block.
+			if( !(pcValue = getenv(pcName)) || (pcCopy = _cgiCopy( pcValue, strlen(pcValue) )) )
+			{
+				ptProperty = varNewProperty( pcName, pcCopy, ptSERVER );
+				free( pcCopy );
+			}
+			break;
+		}
+	}
+	return ptProperty;
+}
+
+/**
+*	_cgiNewParam
+*
+*		Add a parameter to the parameter table.
+*
+*	@param	pcName			Address C-string containing the decoded parameter name.
+*	@param	pcValue			Address C-string containing the decoded parameter value.
+*	@param	bString			If true the value is always treated as a string.
+*
+*	@return		True on success otherwise false.
+**/
+static bool _cgiNewParam( const char *pcName, char *pcValue, bool bString )
+{
+	CGI_PARAM	*pParams;
+	int			iSize;
+
+	if( cgiParamCount == cgiParamSize )
+	{
+		iSize = cgiParamSize ? 2 * cgiParamSize : 16;
+		if( !(pParams = (CGI_PARAM *)realloc( cgiParams, iSize * sizeof(CGI_PARAM) )) )
+		{
+			return false;
+		}
+		cgiParams	 = pParams;
+		cgiParamSize = iSize;
+	}
+	cgiParams[cgiParamCount].pcName  = pcName;
+	cgiParams[cgiParamCount].pcValue = pcValue;
+	cgiParams[cgiParamCount].ptValue = NULL;
+	cgiParams[cgiParamCount].bString = bString;
+	cgiParamCount++;
+	return true;
+}
+
+/**
+*	_cgiParseParams
+*
+*		Split a URL encoded list of parameters into the parameter table in a single
+*		pass. Each parameter name and value is decoded in place, empty parameters
+*		are skipped. The 'operations' parameter value is always a string because
+*		batch operations may exceed MAX_BUF_SIZE.
+*
+*	@param	pcParams		Address C-string containing the URL encoded parameters.
+*	@param	pcSep			Address C-string containing the parameter separators.
+**/
+static void _cgiParseParams( char *pcParams, const char *pcSep )
+{
+	char	*pcArgm,
+			*pcValue;
+	size_t	iLength;
+
+	for( pcArgm = pcParams; *pcArgm; pcArgm += iLength )
+	{
+		if( (iLength = strcspn( pcArgm, pcSep )) )
+		{
+			if( pcArgm[iLength] )
+			{
+				pcArgm[iLength++] = '\0';
+			}
+			if( (pcValue = strchr( pcArgm, '=' )) )
+			{
+				*pcValue++ = '\0';
+			}
+			else
+			{
+				pcValue = pcArgm + strlen(pcArgm);
+			}
+			decodeURI( pcArgm, NULL, 0 );
+			decodeURI( pcValue, NULL, 0 );
+			if( !_cgiNewParam( pcArgm, pcValue, !strcmp( pcArgm, "operations" ) ) )
+			{
+				break;
+			}
+		}
+		else
+		{
+			iLength = 1;
+		}
+	}
+}
+
+/**
+*	_cgiReadContent
+*
+*		Read the content of a HTTP request from stdin. The content length is taken
+*		from the CONTENT_LENGTH variable, if absent the content is read until the
+*		end of input. Content exceeding MAX_CONTENT_SIZE is rejected.
+*
+*	@note	The caller is responsible to free the returned content.
+*
+*	@return		Address zero terminated content or NULL if there is no (valid) content.
+**/
+static char *_cgiReadContent( void )
+{
+	char	*pcContent,
+			*pcLength;
+	size_t	iLength = MAX_CONTENT_SIZE + 1,
+			iCount = 0,
+			iRead;
+
+	if( (pcLength = getenv("CONTENT_LENGTH")) && *pcLength )
+	{
+		iLength = (size_t)strtol( pcLength, NULL, 10 );
+		if( iLength > MAX_CONTENT_SIZE )
+		{
+			cbtDebug( "Content length %s exceeds maximum", pcLength );
+			return NULL;
+		}
+	}
+	if( (pcContent = (char *)malloc( iLength + 1 + sizeof(DATA) )) )
+	{
+		while( iCount < iLength && (iRead = fread( &pcContent[iCount], 1, iLength - iCount, stdin )) )
+		{
+			iCount += iRead;
+		}
+		// Zero pad the content, isData() must never probe beyond the end of the buffer.
+		memset( &pcContent[iCount], 0, iLength + 1 + sizeof(DATA) - iCount );
+		if( iCount > MAX_CONTENT_SIZE )
+		{
+			cbtDebug( "Content exceeds maximum length" );
+			free( pcContent );
+			return NULL;
+		}
+	}
+	return pcContent;
+}
+
 /**
 *	cgiCleanup
 *
@@ -192,48 +412,49 @@ static STATUS * _cgiGetStatus( int iStatus )
 void cgiCleanup()
 {
 	destroy( cgiEnvironment );
+	free( cgiParams );
+	free( cgiParamBuf );
 	cbtDebugEnd();
 	
 	cgiEnvironment = NULL;
+	cgiParams	   = NULL;
+	cgiParamBuf	   = NULL;
+	cgiArgs		   = NULL;
+	cgiParamCount  = 0;
+	cgiParamSize   = 0;
 }
 
 /**
 *	cgiInit
 *
-*		Load the available CGI variables and create the PHP style _SERVER and _GET
-*		dynamic variables. Both variables are created as associative arrays.
+*		Create the PHP style _SERVER and _GET or _POST dynamic variables. All are
+*		created as associative arrays. The _SERVER properties are loaded on first
+*		use, the _GET or _POST properties are added by cgiGetArgument().
 **/
 int cgiInit()
 {
 	METHOD	*pMethod;
-	DATA	*ptContent,
-			*ptQuery,
-			*ptArgs,
+	DATA	*ptQuery,
 			*ptSERVER,
 			*ptCBTREE,
 			*ptGET,
 			*ptPOST;
 	char	cProperty[MAX_BUF_SIZE],
 			cValue[MAX_BUF_SIZE],
-			cArgm[MAX_BUF_SIZE],
 			*pcAllowed,
+			*pcQuery,
 			*pcSrc,
 			*pcArgm;
-	int		iArgCount,
-			iSep,
-			i;
+	int		i;
 	
 	phResp = stdout;
 	
 	cgiEnvironment = newArray(NULL);
 
-	// Setup a PHP style '$_SERVER' variable.
+	// Setup a PHP style '$_SERVER' variable, the CGI variables are loaded from the
+	// environment on first use (see cgiGetProperty).
 	if( (ptSERVER = newArray( "_SERVER" )) )
 	{
-		for( i=0; cgiVarNames[i]; i++)
-		{
-			varNewProperty( cgiVarNames[i],  getenv(cgiVarNames[i]), ptSERVER );
-		}
 		varPush( cgiEnvironment, ptSERVER );
 	}
 
@@ -250,7 +471,8 @@ int cgiInit()
 	{
 		for( i=0; cgiCbtreeNames[i]; i++)
 		{
-			varNewProperty( cgiCbtreeNames[i],  getenv(cgiCbtreeNames[i]), ptCBTREE );
+			pcSrc = getenv(cgiCbtreeNames[i]);
+			varNewProperty( cgiCbtreeNames[i], (pcSrc ? strncpyz( cValue, pcSrc, sizeof(cValue)-1 ) : NULL), ptCBTREE );
 		}
 		varPush( cgiEnvironment, ptCBTREE );
 	}
@@ -263,64 +485,42 @@ int cgiInit()
 	{
 		case HTTP_V_DELETE:
 		case HTTP_V_GET:
+		case HTTP_V_HEAD:
 			if( (ptGET = newArray( "_GET" )) )
 			{
-				if( (ptQuery = cgiGetProperty("QUERY_STRING")) )
+				// Split and decode a copy of the query string, the copy holds the
+				// parameter names and values until cgiCleanup().
+				if( (ptQuery = cgiGetProperty("QUERY_STRING")) && isString(ptQuery) && 
+					(pcQuery = varGet(ptQuery)) )
 				{
-					// Get the list of HTTP query arguments as a new array.
-					ptArgs = varSplit( ptQuery, "&", false );
-					ptGET  = newArray( "_GET" );
-					if( (iArgCount = varCount( ptArgs )) )
+					if( (cgiParamBuf = _cgiCopy( pcQuery, strlen(pcQuery) )) )
 					{
-						for( i=0; i < iArgCount; i++ )
-						{
-							if( (pcArgm = varGet(varGetByIndex( i, ptArgs ))) )
-							{
-								// Decode special characters and treat each argument as a new property.
-								pcSrc  = decodeURI( pcArgm, cArgm, sizeof(cArgm)-1 );
-								iSep   = strcspn( pcSrc, "=" );
-								strncpyz( cProperty, pcSrc, iSep );
-								pcSrc += pcSrc[iSep] ? iSep + 1: iSep;
-								strcpy( cValue, pcSrc );
-								
-								varNewProperty( cProperty, cValue, ptGET );
-							}
-						}
+						_cgiParseParams( cgiParamBuf, "&" );
 					}
-					destroy( ptArgs );
 				}
 				varPush( cgiEnvironment, ptGET );
+				cgiArgs = ptGET;
 			}
 			break;
 			
 		case HTTP_V_POST:
 			if( (ptPOST = newArray( "_POST" )) )
 			{
-				// Read the content from stdin
-				if( fgets(cArgm, sizeof(cArgm)-1, stdin) )
+				// Read the content from stdin. A JSON array is a batch of operations,
+				// anything else is a URL encoded list of arguments.
+				if( (cgiParamBuf = _cgiReadContent()) )
 				{
-					ptContent = newString( "CONTENT", cArgm );
-					ptArgs	  = varSplit( ptContent, "&", false );
-					if( (iArgCount = varCount( ptArgs )) )
+					if( *(pcSrc = strfchr( cgiParamBuf )) == '[' )
 					{
-						for( i=0; i < iArgCount; i++ )
-						{
-							if( (pcArgm = varGet(varGetByIndex( i, ptArgs ))) )
-							{
-								// Decode special characters and treat each argument as a new property.
-								pcSrc  = decodeURI( pcArgm, cArgm, sizeof(cArgm)-1 );
-								iSep   = strcspn( pcSrc, "=" );
-								strncpyz( cProperty, pcSrc, iSep );
-								pcSrc += pcSrc[iSep] ? iSep + 1: iSep;
-								strcpy( cValue, pcSrc );
-								
-								varNewProperty( cProperty, cValue, ptPOST );
-							}
-						}
+						_cgiNewParam( "operations", pcSrc, true );
+					}
+					else
+					{
+						_cgiParseParams( cgiParamBuf, "&\r\n" );
 					}
-					destroy( ptArgs );
 				}
 				varPush( cgiEnvironment, ptPOST );
+				cgiArgs = ptPOST;
 			}
 			break;
 	}
@@ -351,7 +551,8 @@ int cgiInit()
 *
 *		Returns a pointer to a CGI variable/property. At first the 'global' CGI
 *		variable list is checked, if no match is found the _SERVER variable is
-*		checked for a matching property name.
+*		checked for a matching property name. A CGI variable not yet present in
+*		the _SERVER variable is loaded from the environment.
 *
 *	@param	pcProperty		Address C-string containing the variable name.
 *
@@ -360,21 +561,73 @@ int cgiInit()
 **/
 DATA *cgiGetProperty( char *pcProperty )
 {
-	char	cProperty[255];
-	DATA	*ptProperty;
+	DATA	*ptProperty,
+			*ptSERVER;
 		
 	if( cgiEnvironment && (pcProperty && *pcProperty) )
 	{
 		if( !(ptProperty = varGetProperty( pcProperty, cgiEnvironment )) )
 		{
-			snprintf( cProperty, sizeof(cProperty)-1, "_SERVER.%s", pcProperty );
-			return varGetProperty( cProperty, cgiEnvironment );
+			ptSERVER = varGetByKey( &cgiServerKey, cgiEnvironment );
+			if( !(ptProperty = varGetProperty( pcProperty, ptSERVER )) )
+			{
+				ptProperty = _cgiLoadVar( pcProperty, ptSERVER );
+			}
 		}
 		return ptProperty;
 	}
 	return NULL;
 }
 
+/**
+*	cgiGetArgument
+*
+*		Returns the query string or request content parameter identified by pcName.
+*		On first use the parameter value is converted into a dynamic variable and
+*		added as a property to ptArgs. If the parameter is specified more than once
+*		the first occurrence is returned.
+*
+*	@param	pcName			Address C-string containing the parameter name.
+*	@param	ptArgs			Address of the _GET or _POST variable.
+*
+*	@return		Pointer to the DATA struct associated with the parameter or NULL
+*				if no match was found.
+**/
+DATA *cgiGetArgument( const char *pcName, DATA *ptArgs )
+{
+	CGI_PARAM	*pParam;
+	int			i;
+
+	if( ptArgs != cgiArgs )
+	{
+		return varGetProperty( pcName, ptArgs );
+	}
+	if( ptArgs && (pcName && *pcName) )
+	{
+		for( i=0; i < cgiParamCount; i++ )
+		{
+			pParam = &cgiParams[i];
+			if( !strcmp( pParam->pcName, pcName ) )
+			{
+				if( !pParam->ptValue )
+				{
+					if( pParam->bString )
+					{
+						pParam->ptValue = newString( pcName, pParam->pcValue );
+					}
+					else
+					{
+						pParam->ptValue = newVar( pcName, pParam->pcValue );
+					}
+					varPush( ptArgs, pParam->ptValue );
+				}
+				return pParam->ptValue;
+			}
+		}
+	}
+	return NULL;
+}
+
 /**
 *	cgiGetMethodId
 *
@@ -417,6 +670,84 @@ bool cgiMethodAllowed( int iMethod )
 	return false;
 }
 
+/**
+*	cgiNotModified
+*
+*		Returns true if the resource identified by the entity tag pcETag and last
+*		modified time lModified has not been modified according to the conditional
+*		request headers If-None-Match and If-Modified-Since. If-Modified-Since is
+*		ignored if If-None-Match is present (rfc 7232). Entity tags are compared
+*		using the weak comparison function. An If-Modified-Since date later than
+*		the current time is invalid and ignored (rfc 7232, section 3.3).
+*
+*	@param	pcETag			Address C-string containing the entity tag.
+*	@param	lModified		Last modified (seconds since Jan 1, 1970) or -1.
+*
+*	@return		true or false
+**/
+bool cgiNotModified( const char *pcETag, long lModified )
+{
+	static const char	*pcMonths = "JanFebMarAprMayJunJulAugSepOctNovDec";
+	struct tm	sTime;
+	DATA		*ptHeader;
+	const char	*pcMatch,
+				*pcMonth;
+	char		cMonth[4];
+	size_t		iLen;
+	time_t		tNow = time(NULL),
+				tSince;
+
+	if( (ptHeader = cgiGetProperty( "HTTP_IF_NONE_MATCH" )) && isString( ptHeader ) &&
+		(pcMatch = varGet( ptHeader )) )
+	{
+		if( !strncmp( pcETag, "W/", 2 ) )
+		{
+			pcETag += 2;
+		}
+		iLen = strlen( pcETag );
+		while( *(pcMatch += strspn( pcMatch, ", \t" )) )
+		{
+			if( *pcMatch == '*' )
+			{
+				return true;
+			}
+			if( !strncmp( pcMatch, "W/", 2 ) )
+			{
+				pcMatch += 2;
+			}
+			if( !strncmp( pcMatch, pcETag, iLen ) && 
+				(!pcMatch[iLen] || strchr( ", \t", pcMatch[iLen] )) )
+			{
+				return true;
+			}
+			pcMatch += strcspn( pcMatch, "," );
+		}
+		return false;
+	}
+	// If-Modified-Since, only the preferred rfc 1123 date format is supported. A
+	// resource modified within the current second may still change.
+	if( lModified >= 0 && lModified < (long)tNow && 
+		(ptHeader = cgiGetProperty( "HTTP_IF_MODIFIED_SINCE" )) && isString( ptHeader ) &&
+		(pcMatch = varGet( ptHeader )) )
+	{
+		memset( &sTime, 0, sizeof(sTime) );
+		if( sscanf( pcMatch, "%*3s, %d %3s %d %d:%d:%d GMT", &sTime.tm_mday, cMonth, &sTime.tm_year,
+					&sTime.tm_hour, &sTime.tm_min, &sTime.tm_sec ) == 6 &&
+			(pcMonth = strstr( pcMonths, cMonth )) && strlen( cMonth ) == 3 )
+		{
+			sTime.tm_mon   = (int)(pcMonth - pcMonths) / 3;
+			sTime.tm_year -= 1900;
+#ifdef WIN32
+			tSince = _mkgmtime( &sTime );
+#else
+			tSince = timegm( &sTime );
+#endif /* WIN32 */
+			return (tSince <= tNow && lModified <= (long)tSince);
+		}
+	}
+	return false;
+}
+
 /**
 *	cgiResponse
 *
@@ -447,3 +778,119 @@ void cgiResponse( int iStatus, char *pcText )
 	}
 }
 
+
+/**
+*	cgiValidators
+*
+*		Write the ETag and Last-Modified response headers.
+*
+*	@param	pcETag			Address C-string containing the entity tag or NULL.
+*	@param	lModified		Last modified (seconds since Jan 1, 1970) or -1.
+**/
+void cgiValidators( const char *pcETag, long lModified )
+{
+	time_t	tModified = (time_t)lModified;
+	char	cDate[64];
+
+	if( pcETag )
+	{
+		fprintf( phResp, "ETag: %s\r\n", pcETag );
+	}
+	if( lModified >= 0 && strftime( cDate, sizeof(cDate), "%a, %d %b %Y %H:%M:%S GMT", gmtime( &tModified ) ) )
+	{
+		fprintf( phResp, "Last-Modified: %s\r\n", cDate );
+	}
+}
+
+/**
+*	cgiExport
+*
+*		Serialize the CGI variables of the current request. Each variable present
+*		in the environment is stored as a zero terminated "name=value" record, the
+*		last record is followed by an additional zero byte. The resulting block can
+*		be passed to cgiImport() in another process.
+*
+*	@param	pcBuf			Address character buffer receiving the records.
+*	@param	iSize			Size of the character buffer.
+*
+*	@return		Length of the block or 0 if the variables don't fit the buffer.
+**/
+size_t cgiExport( char *pcBuf, size_t iSize )
+{
+	size_t	iLen = 0,
+			iRecLen;
+	char	*pcValue;
+	int		i;
+
+	for( i=0; cgiVarNames[i]; i++ )
+	{
+		if( (pcValue = getenv(cgiVarNames[i])) )
+		{
+			iRecLen = strlen( cgiVarNames[i] ) + strlen( pcValue ) + 2;
+			if( iLen + iRecLen >= iSize )
+			{
+				return 0;
+			}
+			sprintf( &pcBuf[iLen], "%s=%s", cgiVarNames[i], pcValue );
+			iLen += iRecLen;
+		}
+	}
+	if( iLen >= iSize )
+	{
+		return 0;
+	}
+	pcBuf[iLen++] = '\0';
+	return iLen;
+}
+
+/**
+*	cgiImport
+*
+*		Replace the CGI variables in the environment with the variables serialized
+*		by cgiExport(). Only known CGI variables are imported, any other records are
+*		ignored. The CBTREE specific configuration variables are not affected.
+*
+*	@param	pcBuf			Address of the serialized variables.
+*	@param	iLen			Length of the serialized variables.
+*
+*	@return		True if successful otherwise false.
+**/
+bool cgiImport( const char *pcBuf, size_t iLen )
+{
+#ifdef WIN32
+	(void)pcBuf;
+	(void)iLen;
+	return false;
+#else
+	const char	*pcRecord,
+				*pcEnd = &pcBuf[iLen];
+	char		cName[MAX_BUF_SIZE];
+	size_t		iSep;
+	int			i;
+
+	if( !iLen || pcBuf[iLen-1] )
+	{
+		return false;
+	}
+	for( i=0; cgiVarNames[i]; i++ )
+	{
+		unsetenv( cgiVarNames[i] );
+	}
+	for( pcRecord = pcBuf; pcRecord < pcEnd && *pcRecord; pcRecord += strlen(pcRecord) + 1 )
+	{
+		if( (iSep = strcspn( pcRecord, "=" )) < sizeof(cName) && pcRecord[iSep] )
+		{
+			strncpyz( cName, pcRecord, iSep );
+			for( i=0; cgiVarNames[i]; i++ )
+			{
+				if( !strcmp( cName, cgiVarNames[i] ) )
+				{
+					setenv( cName, &pcRecord[iSep+1], 1 );
+					break;
+				}
+			}
+		}
+	}
+	return true;
+#endif /* WIN32 */
+}
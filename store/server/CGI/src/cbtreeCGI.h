@@ -30,11 +30,16 @@ typedef struct httpStatus {
 #endif
 		
 void  cgiCleanup();
+size_t cgiExport( char *pcBuf, size_t iSize );
+DATA *cgiGetArgument( const char *pcName, DATA *ptArgs );
 int   cgiGetMethodId();
 DATA *cgiGetProperty( char *pcVarName );
+bool  cgiImport( const char *pcBuf, size_t iLen );
 int   cgiInit();
 bool  cgiMethodAllowed( int iMethod );
+bool  cgiNotModified( const char *pcETag, long lModified );
 void  cgiResponse( int iStatus, char *pcText );
+void  cgiValidators( const char *pcETag, long lModified );
 
 #ifdef __cplusplus
 	}
@@ -0,0 +1,528 @@
+/****************************************************************************************
+*	Copyright (c) 2012, Peter Jekel
+*	All rights reserved.
+*
+*	The Checkbox Tree File Store CGI (cbtreeFileStore) is released under to following
+*	license:
+*
+*	    BSD 2-Clause		(http://thejekels.com/cbtree/LICENSE)
+*
+*	@author		Peter Jekel
+*
+****************************************************************************************
+*
+*	Description:
+*
+*		This module provides a persistent directory listing cache. Because every
+*		CGI invocation is a new process nothing survives a request in memory,
+*		instead the raw listing of a directory, that is, the names and entry types
+*		of all its entries, is stored in a cache file in a cache directory outside
+*		the document root.
+*
+*		A listing is keyed by the full directory path and validated against the
+*		device, inode, last modified and last status change time of the directory.
+*		Any entry created, removed or renamed in a directory updates both times
+*		thereby invalidating the cached listing. The status change time is part
+*		of the key because tools like tar, 'cp -p' or 'touch -r' can restore the
+*		modification time of a directory after its entries changed, the status
+*		change time however can not be set by programs. Directories modified or
+*		changed within the last second are never cached as a subsequent change
+*		may not change either time.
+*
+*		Only the directory entries are cached, the file status of the individual
+*		entries (size and last modified) is not covered by the modification time
+*		of the directory and is therefore always retrieved from the file system.
+*
+*		Cache files are written to a temporary file first and renamed, readers
+*		will therefore never see a partial cache file. If the total size of the
+*		cache exceeds the size cap the oldest cache files are removed. The cap is
+*		checked once every CACHE_TRIM_RATE writes, on average, therefore the cap
+*		is a soft limit.
+*
+*	NOTE:	The listing cache is currently only available on POSIX systems. On
+*			Microsoft Windows cacheInit() always fails.
+*
+****************************************************************************************/
+#ifdef _MSC_VER
+	#define _CRT_SECURE_NO_WARNINGS
+#endif	/* _MSC_VER */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#ifndef WIN32
+  #include <dirent.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+#endif /* WIN32 */
+
+#include "cbtreeCache.h"
+#include "cbtreeDebug.h"
+
+#define CACHE_V_MAGIC		0x4C544243		// "CBTL"
+#define CACHE_V_VERSION		2
+#define CACHE_TRIM_RATE		32				// Check the size cap every n-th write (power of 2)
+
+// Cache file header, followed by the directory path and the listing.
+typedef struct cacheHeader {
+	unsigned int	iMagic;				// Magic number (CACHE_V_MAGIC)
+	unsigned int	iVersion;			// Cache file format version.
+	size_t			iPathLen;			// Length of the directory path.
+	size_t			iDataLen;			// Length of the listing.
+	dev_t			device;				// Device of the directory
+	ino_t			inode;				// Inode of the directory
+	time_t			tModified;			// Last modified (seconds since Jan 1, 1970)
+	long			lModifiedNs;		// Last modified, nanoseconds.
+	time_t			tChanged;			// Last status change (seconds since Jan 1, 1970)
+	long			lChangedNs;			// Last status change, nanoseconds.
+} CACHE_HEADER;
+
+#ifndef WIN32
+typedef struct cacheFile {
+	char		cName[32];				// Cache filename
+	time_t		tModified;				// Last modified
+	long		lSize;					// File size in bytes
+} CACHE_FILE;
+
+static char			cCacheDir[PATH_MAX] = "";
+static bool			bCacheEnabled = false;
+static long			lCacheSize = 0;		// Size cap in bytes (0 = unlimited)
+static unsigned long	lCacheWrites = 0;	// Number of cache writes (random start).
+#endif /* WIN32 */
+
+static CACHE_COUNT	cacheCount = { 0, 0, 0, 0 };
+
+// The cache counters are updated by multiple threads during a deep search.
+#if defined(__GNUC__)
+  #define cacheCountAdd(c)	__sync_fetch_and_add( &cacheCount.c, 1 )
+  #define cacheWriteNext()	__sync_add_and_fetch( &lCacheWrites, 1 )
+#else
+  #define cacheCountAdd(c)	(cacheCount.c++)
+  #define cacheWriteNext()	(++lCacheWrites)
+#endif /* __GNUC__ */
+
+#ifndef WIN32
+/**
+*	_cacheFile
+*
+*		Compose the full path of the cache file associated with a cache key.
+*
+*	@param	pKey			Address CACHE_KEY struct.
+*	@param	pcFile			Address character buffer receiving the path.
+*	@param	iSize			Size of the character buffer.
+*
+*	@return		Address C-string containing the cache file path or NULL if the path
+*				does not fit the buffer.
+**/
+static char *_cacheFile( CACHE_KEY *pKey, char *pcFile, size_t iSize )
+{
+	int		iLen;
+
+	iLen = snprintf( pcFile, iSize, "%s/%0*lx.dir", cCacheDir, (int)(sizeof(long) * 2), pKey->lHash );
+	if( iLen < 0 || (size_t)iLen >= iSize )
+	{
+		return NULL;
+	}
+	return pcFile;
+}
+
+/**
+*	_readAll
+*
+*		Read exactly iSize bytes from a file.
+*
+*	@param	iFd				File descriptor.
+*	@param	pvBuf			Address buffer receiving the data.
+*	@param	iSize			Number of bytes to read.
+*
+*	@return		True if all bytes were read otherwise false.
+**/
+static bool _readAll( int iFd, void *pvBuf, size_t iSize )
+{
+	char	*pcBuf = (char *)pvBuf;
+	ssize_t	iRead;
+
+	while( iSize )
+	{
+		if( (iRead = read( iFd, pcBuf, iSize )) <= 0 )
+		{
+			return false;
+		}
+		pcBuf += iRead;
+		iSize -= iRead;
+	}
+	return true;
+}
+
+/**
+*	_writeAll
+*
+*		Write exactly iSize bytes to a file.
+*
+*	@param	iFd				File descriptor.
+*	@param	pvBuf			Address buffer containing the data.
+*	@param	iSize			Number of bytes to write.
+*
+*	@return		True if all bytes were written otherwise false.
+**/
+static bool _writeAll( int iFd, const void *pvBuf, size_t iSize )
+{
+	const char	*pcBuf = (const char *)pvBuf;
+	ssize_t		iWritten;
+
+	while( iSize )
+	{
+		if( (iWritten = write( iFd, pcBuf, iSize )) <= 0 )
+		{
+			return false;
+		}
+		pcBuf += iWritten;
+		iSize -= iWritten;
+	}
+	return true;
+}
+
+/**
+*	_cacheCompare
+*
+*		Compare the modification time of two cache files (qsort callback).
+**/
+static int _cacheCompare( const void *pvA, const void *pvB )
+{
+	const CACHE_FILE	*pFileA = (const CACHE_FILE *)pvA,
+						*pFileB = (const CACHE_FILE *)pvB;
+
+	return (pFileA->tModified == pFileB->tModified) ? 0 : (pFileA->tModified < pFileB->tModified ? -1 : 1);
+}
+
+/**
+*	_cacheTrim
+*
+*		Enforce the cache size cap. If the total size of all cache files exceeds
+*		the size cap the oldest cache files are removed until the total size is
+*		reduced to three quarters of the cap.
+**/
+static void _cacheTrim( void )
+{
+	struct dirent	*pDirEnt;
+	struct stat		sStat;
+	CACHE_FILE		*pFiles = NULL;
+	void			*pvNew;
+	DIR				*pDir;
+	size_t			iLen;
+	long			lTotal = 0;
+	int				iCount = 0,
+					iSize  = 0,
+					i;
+
+	if( !(pDir = opendir( cCacheDir )) )
+	{
+		return;
+	}
+	while( (pDirEnt = readdir( pDir )) )
+	{
+		iLen = strlen( pDirEnt->d_name );
+		if( iLen < 4 || iLen >= sizeof(pFiles->cName) || strcmp( &pDirEnt->d_name[iLen-4], ".dir" ) ||
+			fstatat( dirfd(pDir), pDirEnt->d_name, &sStat, AT_SYMLINK_NOFOLLOW ) )
+		{
+			continue;
+		}
+		if( iCount == iSize )
+		{
+			iSize = iSize ? iSize * 2 : 256;
+			if( !(pvNew = realloc( pFiles, iSize * sizeof(CACHE_FILE) )) )
+			{
+				break;
+			}
+			pFiles = (CACHE_FILE *)pvNew;
+		}
+		memcpy( pFiles[iCount].cName, pDirEnt->d_name, iLen + 1 );
+		pFiles[iCount].tModified = sStat.st_mtime;
+		pFiles[iCount].lSize	 = (long)sStat.st_size;
+		lTotal += pFiles[iCount++].lSize;
+	}
+	if( lTotal > lCacheSize )
+	{
+		qsort( pFiles, iCount, sizeof(CACHE_FILE), _cacheCompare );
+		for( i = 0; i < iCount && lTotal > lCacheSize / 4 * 3; i++ )
+		{
+			if( !unlinkat( dirfd(pDir), pFiles[i].cName, 0 ) )
+			{
+				lTotal -= pFiles[i].lSize;
+				cacheCountAdd( lTrim );
+			}
+		}
+	}
+	closedir( pDir );
+	free( pFiles );
+}
+#endif /* WIN32 */
+
+/**
+*	cacheEnabled
+*
+*		Returns true if the directory listing cache is enabled.
+*
+*	@return		True or false.
+**/
+bool cacheEnabled( void )
+{
+#ifndef WIN32
+	return bCacheEnabled;
+#else
+	return false;
+#endif /* WIN32 */
+}
+
+/**
+*	cacheInit
+*
+*		Enable the directory listing cache. The cache directory must exist and must
+*		not be located inside the document root, otherwise the cached listings would
+*		be served by the HTTP server.
+*
+*	@param	pcCacheDir		Address C-string containing the cache directory.
+*	@param	pcDocRoot		Address C-string containing the document root.
+*	@param	lMaxSize		Size cap of the cache in kilobytes (0 = unlimited).
+*
+*	@return		True if the cache is enabled otherwise false.
+**/
+bool cacheInit( const char *pcCacheDir, const char *pcDocRoot, long lMaxSize )
+{
+#ifndef WIN32
+	struct stat	sStat;
+	char		cDocRoot[PATH_MAX];
+	size_t		iLen;
+
+	if( !pcCacheDir || !*pcCacheDir )
+	{
+		return false;
+	}
+	if( !realpath( pcCacheDir, cCacheDir ) || stat( cCacheDir, &sStat ) || !S_ISDIR(sStat.st_mode) )
+	{
+		cbtDebug( "Listing cache directory [%s] is not available.", pcCacheDir );
+		return false;
+	}
+	if( !realpath( pcDocRoot, cDocRoot ) )
+	{
+		return false;
+	}
+	iLen = strlen( cDocRoot );
+	if( !strncmp( cCacheDir, cDocRoot, iLen ) &&
+		(cCacheDir[iLen] == '/' || cCacheDir[iLen] == '\0' || cDocRoot[iLen-1] == '/') )
+	{
+		cbtDebug( "Listing cache directory [%s] is inside the document root.", pcCacheDir );
+		return false;
+	}
+	lCacheSize	  = (lMaxSize > 0 && lMaxSize < LONG_MAX / 1024) ? lMaxSize * 1024 : 0;
+	// Every CGI process starts counting at a different write, otherwise processes
+	// that write fewer than CACHE_TRIM_RATE listings would never check the cap.
+	lCacheWrites  = (unsigned long)time(NULL) ^ (unsigned long)getpid();
+	bCacheEnabled = true;
+	return true;
+#else
+	(void)pcCacheDir;
+	(void)pcDocRoot;
+	(void)lMaxSize;
+
+	return false;
+#endif /* WIN32 */
+}
+
+/**
+*	cacheKey
+*
+*		Compose the cache key of a directory. No key is returned if the cache is
+*		disabled or if the directory was modified or changed within the last second.
+*
+*	@param	pKey			Address CACHE_KEY struct receiving the key.
+*	@param	pcPath			Address C-string containing the full directory path.
+*	@param	pStat			Address stat struct of the directory.
+*
+*	@return		True if the directory can be cached otherwise false.
+**/
+bool cacheKey( CACHE_KEY *pKey, const char *pcPath, const struct stat *pStat )
+{
+#ifndef WIN32
+	const unsigned char	*pcChar;
+	unsigned long		lHash = 2166136261UL;	// FNV-1a
+
+	if( !bCacheEnabled || pStat->st_mtime >= time(NULL) - 1 || pStat->st_ctime >= time(NULL) - 1 )
+	{
+		return false;
+	}
+	for( pcChar = (const unsigned char *)pcPath; *pcChar; pcChar++ )
+	{
+		lHash = (lHash ^ *pcChar) * 16777619UL;
+	}
+	pKey->pcPath	  = pcPath;
+	pKey->iPathLen	  = strlen( pcPath );
+	pKey->lHash		  = lHash;
+	pKey->device	  = pStat->st_dev;
+	pKey->inode		  = pStat->st_ino;
+	pKey->tModified	  = pStat->st_mtime;
+	pKey->tChanged	  = pStat->st_ctime;
+  #ifdef __linux__
+	pKey->lModifiedNs = pStat->st_mtim.tv_nsec;
+	pKey->lChangedNs  = pStat->st_ctim.tv_nsec;
+  #else
+	pKey->lModifiedNs = 0;
+	pKey->lChangedNs  = 0;
+  #endif /* __linux__ */
+	return true;
+#else
+	(void)pKey;
+	(void)pcPath;
+	(void)pStat;
+
+	return false;
+#endif /* WIN32 */
+}
+
+/**
+*	cacheRead
+*
+*		Returns the cached listing of a directory. The listing is only returned if
+*		the cache file was written for the same directory path, device, inode,
+*		modification and status change time.
+*
+*	@param	pKey			Address CACHE_KEY struct.
+*	@param	piSize			Address size_t receiving the length of the listing.
+*
+*	@return		Address of the listing, followed by a terminating zero, (allocated, the
+*				caller must free it) or NULL in case of a cache miss.
+**/
+char *cacheRead( CACHE_KEY *pKey, size_t *piSize )
+{
+#ifndef WIN32
+	CACHE_HEADER	sHeader;
+	char			cFile[PATH_MAX],
+					*pcFile,
+					*pcData = NULL;
+	int				iFd;
+
+	if( (pcFile = _cacheFile( pKey, cFile, sizeof(cFile) )) &&
+		(iFd = open( pcFile, O_RDONLY | O_CLOEXEC )) != -1 )
+	{
+		if( _readAll( iFd, &sHeader, sizeof(sHeader) ) &&
+			sHeader.iMagic	 == CACHE_V_MAGIC && sHeader.iVersion == CACHE_V_VERSION &&
+			sHeader.iPathLen == pKey->iPathLen && sHeader.device == pKey->device &&
+			sHeader.inode	 == pKey->inode && sHeader.tModified == pKey->tModified &&
+			sHeader.lModifiedNs == pKey->lModifiedNs &&
+			sHeader.tChanged == pKey->tChanged && sHeader.lChangedNs == pKey->lChangedNs &&
+			(pcData = (char *)malloc( sHeader.iPathLen + sHeader.iDataLen + 1 )) )
+		{
+			if( _readAll( iFd, pcData, sHeader.iPathLen + sHeader.iDataLen ) &&
+				!memcmp( pcData, pKey->pcPath, sHeader.iPathLen ) )
+			{
+				memmove( pcData, &pcData[sHeader.iPathLen], sHeader.iDataLen );
+				pcData[sHeader.iDataLen] = '\0';	// Terminate a truncated last record.
+				*piSize = sHeader.iDataLen;
+			}
+			else // Hash collision or truncated cache file.
+			{
+				free( pcData );
+				pcData = NULL;
+			}
+		}
+		close( iFd );
+	}
+	if( pcData )
+	{
+		cacheCountAdd( lHit );
+	}
+	else
+	{
+		cacheCountAdd( lMiss );
+	}
+	return pcData;
+#else
+	(void)pKey;
+	(void)piSize;
+
+	return NULL;
+#endif /* WIN32 */
+}
+
+/**
+*	cacheWrite
+*
+*		Store the listing of a directory in the cache. Any existing listing for
+*		the same directory path is replaced. Listings that exceed the size cap by
+*		themselves are not cached.
+*
+*	@param	pKey			Address CACHE_KEY struct.
+*	@param	pcData			Address of the listing.
+*	@param	iSize			Length of the listing.
+**/
+void cacheWrite( CACHE_KEY *pKey, const char *pcData, size_t iSize )
+{
+#ifndef WIN32
+	CACHE_HEADER	sHeader;
+	char			cFile[PATH_MAX],
+					cTemp[PATH_MAX],
+					*pcFile;
+	bool			bWritten;
+	int				iFd,
+					iLen;
+
+	if( lCacheSize && (long)(sizeof(sHeader) + pKey->iPathLen + iSize) > lCacheSize )
+	{
+		return;
+	}
+	// Skip the cache if either path does not fit, a truncated name could hit
+	// another listing or a template mkstemp() rejects.
+	iLen = snprintf( cTemp, sizeof(cTemp), "%s/.cbtXXXXXX", cCacheDir );
+	if( iLen < 0 || (size_t)iLen >= sizeof(cTemp) ||
+		!(pcFile = _cacheFile( pKey, cFile, sizeof(cFile) )) )
+	{
+		return;
+	}
+	if( (iFd = mkstemp( cTemp )) == -1 )
+	{
+		return;
+	}
+	memset( &sHeader, 0, sizeof(sHeader) );
+	sHeader.iMagic		= CACHE_V_MAGIC;
+	sHeader.iVersion	= CACHE_V_VERSION;
+	sHeader.iPathLen	= pKey->iPathLen;
+	sHeader.iDataLen	= iSize;
+	sHeader.device		= pKey->device;
+	sHeader.inode		= pKey->inode;
+	sHeader.tModified	= pKey->tModified;
+	sHeader.lModifiedNs = pKey->lModifiedNs;
+	sHeader.tChanged	= pKey->tChanged;
+	sHeader.lChangedNs	= pKey->lChangedNs;
+
+	bWritten = _writeAll( iFd, &sHeader, sizeof(sHeader) ) &&
+			   _writeAll( iFd, pKey->pcPath, pKey->iPathLen ) &&
+			   _writeAll( iFd, pcData, iSize );
+	if( close( iFd ) || !bWritten || rename( cTemp, pcFile ) )
+	{
+		unlink( cTemp );
+		return;
+	}
+	cacheCountAdd( lWrite );
+	if( lCacheSize && !(cacheWriteNext() & (CACHE_TRIM_RATE - 1)) )
+	{
+		_cacheTrim();
+	}
+#else
+	(void)pKey;
+	(void)pcData;
+	(void)iSize;
+#endif /* WIN32 */
+}
+
+/**
+*	getCacheCount
+*
+*		Returns the address of the listing cache counters.
+*
+*	@return		Address CACHE_COUNT struct.
+**/
+CACHE_COUNT *getCacheCount( void )
+{
+	return &cacheCount;
+}
@@ -0,0 +1,48 @@
+#ifndef _CBTREE_CACHE_H_
+#define _CBTREE_CACHE_H_
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "cbtreeCommon.h"
+
+#define CACHE_V_DEFAULT_SIZE	65536		// Default cache size cap in kilobytes.
+
+// Directory listing cache key.
+typedef struct cacheKey {
+	const char		*pcPath;			// Full directory path
+	size_t			iPathLen;			// Length of the directory path
+	unsigned long	lHash;				// Hash of the directory path
+	dev_t			device;				// Device of the directory
+	ino_t			inode;				// Inode of the directory
+	time_t			tModified;			// Last modified (seconds since Jan 1, 1970)
+	long			lModifiedNs;		// Last modified, nanoseconds.
+	time_t			tChanged;			// Last status change (seconds since Jan 1, 1970)
+	long			lChangedNs;			// Last status change, nanoseconds.
+} CACHE_KEY;
+
+// Listing cache counters (per request).
+typedef struct cacheCount {
+	long		lHit;					// Number of listings read from the cache.
+	long		lMiss;					// Number of listings not found in the cache.
+	long		lWrite;					// Number of listings written to the cache.
+	long		lTrim;					// Number of listings removed to honour the size cap.
+} CACHE_COUNT;
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+bool  cacheEnabled( void );
+bool  cacheInit( const char *pcCacheDir, const char *pcDocRoot, long lMaxSize );
+bool  cacheKey( CACHE_KEY *pKey, const char *pcPath, const struct stat *pStat );
+char *cacheRead( CACHE_KEY *pKey, size_t *piSize );
+void  cacheWrite( CACHE_KEY *pKey, const char *pcData, size_t iSize );
+CACHE_COUNT *getCacheCount( void );
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif /* _CBTREE_CACHE_H_ */
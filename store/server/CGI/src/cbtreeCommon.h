@@ -10,6 +10,8 @@
   #define	stricmp				_stricmp
   #define	chmod				_chmod
   #define	rmdir				_rmdir
+#else
+  #define	stricmp				strcasecmp
 #endif	/* WIN32 */
 
 #ifndef __cplusplus
@@ -21,6 +23,7 @@
 // HTTP response codes.
 #define	HTTP_V_OK					200
 #define HTTP_V_NO_CONTENT			204
+#define HTTP_V_NOT_MODIFIED			304
 #define HTTP_V_BAD_REQUEST			400
 #define HTTP_V_UNAUTHORIZED			401
 #define	HTTP_V_FORBIDDEN			403
@@ -31,7 +34,8 @@
 #define HTTP_V_SERVER_ERROR			500
 
 #define	MAX_BUF_SIZE	4096		// Maximum buffer size
-#define	MAX_RSP_SEGM	256000		// Default JSON response buffer segment.
+#define	MAX_RSP_SEGM	16384		// JSON response output buffer size.
 #define MAX_PATH_SIZE	256			// Maximum path size in bytes
+#define MAX_CONTENT_SIZE	1048576	// Maximum HTTP request content size in bytes
 
 #endif /* __CBTREE_COMMON_H__ */
@@ -0,0 +1,412 @@
+/****************************************************************************************
+*	Copyright (c) 2012, Peter Jekel
+*	All rights reserved.
+*
+*	The Checkbox Tree File Store CGI (cbtreeFileStore) is released under to following
+*	license:
+*
+*	    BSD 2-Clause		(http://thejekels.com/cbtree/LICENSE)
+*
+*	@author		Peter Jekel
+*
+****************************************************************************************
+*
+*	Description:
+*
+*		This module implements the daemon mode of the file store. In daemon mode
+*		the application is started once, loads the file tree rooted at:
+*
+*			root-dir ::= DOCUMENT_ROOT '/' CBTREE_BASEPATH?
+*
+*		into memory (see cbtreeTree.c) and answers requests forwarded by the CGI
+*		application over a Unix domain socket. The CGI application is invoked by
+*		the HTTP server as usual, if the environment variable CBTREE_DAEMON_SOCKET
+*		is set it serializes the CGI variables of the request, passes them to the
+*		daemon and relays the daemon's response to the HTTP server. If the daemon
+*		is not running the request is processed by the CGI application itself.
+*
+*		The daemon processes one request at a time. Any pending change notifications
+*		of the resident file tree are applied before a request is processed, so the
+*		response always reflects the current state of the file system.
+*
+*		Only HTTP GET and HEAD requests are forwarded. The CBTREE specific configuration
+*		variables are taken from the environment of the daemon, not from the
+*		forwarded request.
+*
+*	NOTE:	The daemon mode is not available on Microsoft Windows.
+*
+****************************************************************************************/
+#ifdef _MSC_VER
+	#define _CRT_SECURE_NO_WARNINGS
+#endif	/* _MSC_VER */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef WIN32
+  #include <errno.h>
+  #include <poll.h>
+  #include <signal.h>
+  #include <unistd.h>
+  #include <sys/socket.h>
+  #include <sys/time.h>
+  #include <sys/un.h>
+#endif /* WIN32 */
+
+#include "cbtreeCache.h"
+#include "cbtreeCGI.h"
+#include "cbtreeDaemon.h"
+#include "cbtreeDebug.h"
+#include "cbtreeString.h"
+#include "cbtreeTree.h"
+#include "cbtreeURI.h"
+#include "cbtree_NP.h"
+
+#ifndef WIN32
+static volatile sig_atomic_t	bStop = 0;
+
+/**
+*	_daemonSignal
+*
+*		Signal handler, request the daemon to terminate.
+**/
+static void _daemonSignal( int iSignal )
+{
+	(void)iSignal;
+	bStop = 1;
+}
+
+/**
+*	_daemonRoot
+*
+*		Compose the root directory of the resident file tree the same way the CGI
+*		application composes the root directory of a request.
+*
+*	@param	pcRootDir		Address character buffer receiving the root directory.
+*	@param	iSize			Size of the character buffer.
+*
+*	@return		True if successful otherwise false.
+**/
+static bool _daemonRoot( char *pcRootDir, size_t iSize )
+{
+	char	cDocRoot[MAX_PATH_SIZE] = "",
+			*pcDocRoot  = getenv( "DOCUMENT_ROOT" ),
+			*pcBasePath = getenv( "CBTREE_BASEPATH" );
+
+	if( !pcDocRoot )
+	{
+		fprintf( stderr, "cbtreeFileStore: DOCUMENT_ROOT is not set.\n" );
+		return false;
+	}
+	snprintf( cDocRoot, sizeof(cDocRoot)-1, "%s", pcDocRoot );
+	strtrim( normalizePath( cDocRoot ), (TRIM_M_WSP | TRIM_M_SLASH) );
+	snprintf( pcRootDir, iSize-1, "%s/%s", cDocRoot, (pcBasePath ? pcBasePath : "") );
+	strtrim( normalizePath( pcRootDir ), (TRIM_M_WSP | TRIM_M_SLASH) );
+
+	if( strncmp( cDocRoot, pcRootDir, strlen(cDocRoot)) )
+	{
+		fprintf( stderr, "cbtreeFileStore: invalid CBTREE_BASEPATH.\n" );
+		return false;
+	}
+	return true;
+}
+
+/**
+*	_daemonAddress
+*
+*		Compose the socket address from the environment variable CBTREE_DAEMON_SOCKET.
+*
+*	@param	pAddr			Address sockaddr_un struct receiving the socket address.
+*
+*	@return		True if successful otherwise false.
+**/
+static bool _daemonAddress( struct sockaddr_un *pAddr )
+{
+	char	*pcSocket = getenv( "CBTREE_DAEMON_SOCKET" );
+
+	if( !pcSocket || !*pcSocket || strlen( pcSocket ) >= sizeof(pAddr->sun_path) )
+	{
+		return false;
+	}
+	memset( pAddr, 0, sizeof(struct sockaddr_un) );
+	pAddr->sun_family = AF_UNIX;
+	strcpy( pAddr->sun_path, pcSocket );
+	return true;
+}
+
+/**
+*	_daemonRequest
+*
+*		Process a single forwarded request. The serialized CGI variables are read
+*		until the client shuts down its side of the connection, next the variables
+*		are imported and the request handler is invoked with its standard output
+*		redirected to the connection.
+*
+*	@param	iConn			Connection file descriptor.
+*	@param	iStdout			Duplicate of the original standard output.
+*	@param	pfRequest		Address of the request handler.
+*	@param	pcBuf			Address of a DAEMON_BUF_SIZE character buffer.
+**/
+static void _daemonRequest( int iConn, int iStdout, REQUEST_FUNC pfRequest, char *pcBuf )
+{
+	struct timeval	sTimeout = { DAEMON_TIMEOUT, 0 };
+	ssize_t	iCount;
+	size_t	iLen = 0;
+
+	setsockopt( iConn, SOL_SOCKET, SO_RCVTIMEO, &sTimeout, sizeof(sTimeout) );
+	while( iLen < DAEMON_BUF_SIZE &&
+		   (iCount = read( iConn, &pcBuf[iLen], DAEMON_BUF_SIZE - iLen )) != 0 )
+	{
+		if( iCount < 0 )
+		{
+			if( errno == EINTR )
+			{
+				continue;
+			}
+			return;
+		}
+		iLen += iCount;
+	}
+	// Catch up with the file system before the request is processed.
+	treeUpdate();
+
+	if( !cgiImport( pcBuf, iLen ) )
+	{
+		return;
+	}
+	fflush( stdout );
+	if( dup2( iConn, STDOUT_FILENO ) != -1 )
+	{
+		if( cgiGetMethodId() == HTTP_V_GET || cgiGetMethodId() == HTTP_V_HEAD )
+		{
+			memset( getSysCount_NP(), 0, sizeof(SYS_COUNT) );
+			memset( getCacheCount(), 0, sizeof(CACHE_COUNT) );
+			pfRequest();
+		}
+		else
+		{
+			fprintf( stdout, "Content-Type: text/html\r\nStatus: 405 Method Not Allowed\r\n\r\n" );
+		}
+		fflush( stdout );
+		dup2( iStdout, STDOUT_FILENO );
+	}
+}
+#endif /* WIN32 */
+
+/**
+*	daemonForward
+*
+*		Forward the current request to the file store daemon, if any, and relay
+*		the daemon's response. Only HTTP GET and HEAD requests are forwarded and only if
+*		the environment variable CBTREE_DAEMON_SOCKET is set.
+*
+*	@return		True if the request was answered by the daemon. If false the
+*				request must be processed locally.
+**/
+bool daemonForward( void )
+{
+#ifndef WIN32
+	struct timeval		sTimeout = { DAEMON_TIMEOUT, 0 };
+	struct sockaddr_un	sAddr;
+	char	cBuf[DAEMON_BUF_SIZE],
+			*pcMethod = getenv( "REQUEST_METHOD" );
+	size_t	iLen,
+			iSent = 0,
+			iRecv = 0;
+	ssize_t	iCount;
+	int		iSock;
+
+	if( !pcMethod || (strcmp( pcMethod, "GET" ) && strcmp( pcMethod, "HEAD" )) || !_daemonAddress( &sAddr ) ||
+		!(iLen = cgiExport( cBuf, sizeof(cBuf) )) )
+	{
+		return false;
+	}
+	if( (iSock = socket( AF_UNIX, SOCK_STREAM, 0 )) == -1 )
+	{
+		return false;
+	}
+	setsockopt( iSock, SOL_SOCKET, SO_RCVTIMEO, &sTimeout, sizeof(sTimeout) );
+	if( connect( iSock, (struct sockaddr *)&sAddr, sizeof(sAddr) ) )
+	{
+		close( iSock );
+		return false;
+	}
+	while( iSent < iLen && (iCount = write( iSock, &cBuf[iSent], iLen - iSent )) > 0 )
+	{
+		iSent += iCount;
+	}
+	shutdown( iSock, SHUT_WR );
+
+	// Relay the response, if nothing was received the request is processed locally.
+	while( iSent == iLen && (iCount = read( iSock, cBuf, sizeof(cBuf) )) > 0 )
+	{
+		fwrite( cBuf, 1, iCount, stdout );
+		iRecv += iCount;
+	}
+	fflush( stdout );
+	close( iSock );
+	return (iRecv > 0);
+#else
+	return false;
+#endif /* WIN32 */
+}
+
+/**
+*	daemonRun
+*
+*		Main loop of the file store daemon. The resident file tree is loaded and
+*		the daemon listens on the Unix domain socket identified by the environment
+*		variable CBTREE_DAEMON_SOCKET until it receives a SIGTERM or SIGINT signal.
+*
+*	@param	pfRequest		Address of the request handler.
+*
+*	@return		Process exit code.
+**/
+int daemonRun( REQUEST_FUNC pfRequest )
+{
+#ifndef WIN32
+	struct sockaddr_un	sAddr;
+	struct sigaction	sAction;
+	struct pollfd		sPoll[2];
+	TREE_STATS	*pStats;
+	char		cRootDir[MAX_PATH_SIZE],
+				*pcBuf;
+	int			iListen,
+				iStdout,
+				iConn;
+
+	if( !_daemonAddress( &sAddr ) )
+	{
+		fprintf( stderr, "cbtreeFileStore: CBTREE_DAEMON_SOCKET is not set or too long.\n" );
+		return 1;
+	}
+	if( !_daemonRoot( cRootDir, sizeof(cRootDir) ) )
+	{
+		return 1;
+	}
+	if( treeInit( cRootDir ) )
+	{
+		pStats = treeStats();
+		cbtDebug( "Resident tree [%s]: entries: %ld, directories: %ld, bytes: %ld",
+				  cRootDir, pStats->lEntries, pStats->lDirectories, pStats->lBytes );
+	}
+	else
+	{
+		fprintf( stderr, "cbtreeFileStore: no resident tree for [%s].\n", cRootDir );
+	}
+
+	memset( &sAction, 0, sizeof(sAction) );
+	sAction.sa_handler = _daemonSignal;
+	sigaction( SIGTERM, &sAction, NULL );
+	sigaction( SIGINT, &sAction, NULL );
+	signal( SIGPIPE, SIG_IGN );
+
+	unlink( sAddr.sun_path );
+	if( (iListen = socket( AF_UNIX, SOCK_STREAM, 0 )) == -1 ||
+		bind( iListen, (struct sockaddr *)&sAddr, sizeof(sAddr) ) ||
+		listen( iListen, SOMAXCONN ) )
+	{
+		fprintf( stderr, "cbtreeFileStore: unable to listen on [%s]: %s\n", sAddr.sun_path, strerror(errno) );
+		treeDestroy();
+		return 1;
+	}
+	if( (iStdout = dup( STDOUT_FILENO )) == -1 || !(pcBuf = (char *)malloc( DAEMON_BUF_SIZE )) )
+	{
+		close( iListen );
+		unlink( sAddr.sun_path );
+		treeDestroy();
+		return 1;
+	}
+
+	sPoll[0].fd		= iListen;
+	sPoll[0].events = POLLIN;
+	sPoll[1].fd		= treeEventFd();
+	sPoll[1].events = POLLIN;
+
+	while( !bStop )
+	{
+		if( poll( sPoll, (sPoll[1].fd != -1 ? 2 : 1), -1 ) == -1 )
+		{
+			continue;		// Interrupted.
+		}
+		if( sPoll[1].fd != -1 && (sPoll[1].revents & POLLIN) )
+		{
+			treeUpdate();
+		}
+		if( (sPoll[0].revents & POLLIN) && (iConn = accept( iListen, NULL, NULL )) != -1 )
+		{
+			_daemonRequest( iConn, iStdout, pfRequest, pcBuf );
+			close( iConn );
+		}
+	}
+	close( iListen );
+	close( iStdout );
+	unlink( sAddr.sun_path );
+	free( pcBuf );
+	treeDestroy();
+	return 0;
+#else
+	(void)pfRequest;
+	fprintf( stderr, "cbtreeFileStore: daemon mode is not supported.\n" );
+	return 1;
+#endif /* WIN32 */
+}
+
+/**
+*	daemonStats
+*
+*		Load the resident file tree, print its memory footprint to the standard
+*		output and exit. Both the bytes allocated for the tree and the growth of
+*		the resident set size are reported, the latter includes the overhead of
+*		the memory allocator.
+*
+*	@return		Process exit code.
+**/
+int daemonStats( void )
+{
+#ifndef WIN32
+	TREE_STATS	*pStats;
+	FILE		*pFile;
+	char		cRootDir[MAX_PATH_SIZE];
+	long		lBefore = 0,
+				lAfter  = 0,
+				lPage   = sysconf( _SC_PAGESIZE );
+
+	if( !_daemonRoot( cRootDir, sizeof(cRootDir) ) )
+	{
+		return 1;
+	}
+	if( (pFile = fopen( "/proc/self/statm", "r" )) )
+	{
+		fscanf( pFile, "%*d %ld", &lBefore );
+		fclose( pFile );
+	}
+	if( !treeInit( cRootDir ) )
+	{
+		fprintf( stderr, "cbtreeFileStore: no resident tree for [%s].\n", cRootDir );
+		treeDestroy();
+		return 1;
+	}
+	if( (pFile = fopen( "/proc/self/statm", "r" )) )
+	{
+		fscanf( pFile, "%*d %ld", &lAfter );
+		fclose( pFile );
+	}
+	pStats = treeStats();
+	printf( "root:        %s\n", cRootDir );
+	printf( "entries:     %ld\n", pStats->lEntries );
+	printf( "directories: %ld\n", pStats->lDirectories );
+	printf( "bytes:       %ld\n", pStats->lBytes );
+	printf( "rss bytes:   %ld\n", (lAfter - lBefore) * lPage );
+	if( pStats->lEntries )
+	{
+		printf( "bytes per million entries:     %.0f\n", (double)pStats->lBytes * 1000000.0 / pStats->lEntries );
+		printf( "rss bytes per million entries: %.0f\n", (double)(lAfter - lBefore) * lPage * 1000000.0 / pStats->lEntries );
+	}
+	treeDestroy();
+	return 0;
+#else
+	fprintf( stderr, "cbtreeFileStore: daemon mode is not supported.\n" );
+	return 1;
+#endif /* WIN32 */
+}
@@ -0,0 +1,24 @@
+#ifndef _CBTREE_DAEMON_H_
+#define _CBTREE_DAEMON_H_
+
+#include "cbtreeCommon.h"
+
+#define DAEMON_BUF_SIZE		16384		// Maximum size of the serialized CGI variables.
+#define DAEMON_TIMEOUT		30			// Socket receive timeout in seconds.
+
+// Request handler invoked by the daemon for each forwarded request.
+typedef int (*REQUEST_FUNC)( void );
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+bool daemonForward( void );
+int  daemonRun( REQUEST_FUNC pfRequest );
+int  daemonStats( void );
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif /* _CBTREE_DAEMON_H_ */
@@ -28,15 +28,24 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <limits.h>
-#include <direct.h>
 #include <errno.h>
-#include <io.h>
+#ifdef WIN32
+  #include <direct.h>
+  #include <io.h>
+#else
+  #include <unistd.h>
+  #include <regex.h>
+  #include <sys/stat.h>
+#endif /* WIN32 */
 
 #include "cbtree_NP.h"
+#include "cbtreeArena.h"
 #include "cbtreeDebug.h"
 #include "cbtreeFiles.h"
+#include "cbtreeJournal.h"
 #include "cbtreeURI.h"
 #include "cbtreeString.h"
+#include "cbtreeThreads.h"
 
 #define compareStr(a,b,c) ((c) ? stricmp((a),(b)) : strcmp((a),(b)))
 #define compareInt(a,b) ((a) == (b) ? 0 : ( (a)<(b) ? -1 : 1))
@@ -46,272 +55,1196 @@ typedef struct fileList {
 	FILE_INFO	*pLast;		// Last file list entry
 } FILE_LIST;
 
+typedef struct dirScan {
+	char		*pcRootDir;	// Root directory
+	ARGS		*pArgs;		// Arguments struct
+} DIR_SCAN;
+
+typedef struct fileLink {
+	unsigned long	lDevice;	// Device of the file
+	unsigned long	lInode;		// Inode of the file
+	long			lSize;		// File size
+} FILE_LINK;
+
+typedef struct linkSet {
+	FILE_LINK	*pLinks;	// Files with multiple hard links, sorted by device and inode.
+	int			iCount;		// Number of files in the set
+	int			iSize;		// Number of files allocated
+} LINK_SET;
+
 static const char *pcFileProp[] = { "name", "path", "directory", "size", "modified", NULL };
+static const int	iFileProp[]	 = { PROP_M_NAME, PROP_M_PATH, PROP_M_DIRECTORY, PROP_M_SIZE, PROP_M_MODIFIED };
 
-static int _removeFile( LIST *pFileList, FILE_INFO *pFileInfo, char *pcRootDir, ARGS *pArgs, int *piResult );
+static void _expandDirectory( TASK_POOL *pPool, int iWorker, void *pvScan, void *pvDirectory );
 
 /**
 *	_destroyFileInfo
 *
 *		Release all resources associated with a FILE_INFO struct. If the file has
-*		child elements linked to it all of them are release as well.
+*		child elements linked to it all of them are release as well. This function
+*		is also the DESTROY_DATA callback of file lists.
+*
+*	@param	pvFileInfo		Address FILE_INFO struct.
+**/
+static void _destroyFileInfo( void *pvFileInfo )
+{
+	FILE_INFO	*pFileInfo = (FILE_INFO *)pvFileInfo;
+
+	if( pFileInfo )
+	{
+		arenaFree( pFileInfo->pcOldPath );
+		if( pFileInfo->pChildren )
+		{
+			destroyVector( &pFileInfo->pChildren, _destroyFileInfo );
+		}
+		arenaFree( pFileInfo );
+	}
+}
+
+/**
+*	_fileFilter
+*
+*		Returns true if a file is to be exlcuded (filtered) based on the HTTP query
+*		string parameters, otherwise false.
+*
+*	@param	pFileInfo		Address FILE_INFO struct.
+*	@param	pArgs			Address query string arguments struct
+* 
+*	@return	true or false
+**/
+static bool _fileFilter( FILE_INFO *pFileInfo, ARGS *pArgs )
+{
+	OPTIONS	*pOptions = pArgs->pOptions;
+
+	if( (!pOptions->bShowHiddenFiles && (pFileInfo->pcName[0] == '.' || pFileInfo->bIsHidden)) ||
+		(!strcmp(pFileInfo->pcName, ".") || !strcmp(pFileInfo->pcName, "..")) )
+	{
+		return true;
+	}
+	return false;
+}
+
+/**
+*	_comparePath
+*
+*		Compare the paths of two files. Files in the same directory share the path
+*		of the directory therefore only their names need to be compared.
+*
+*	@param	pFileA			Address FILE_INFO struct.
+*	@param	pFileB			Address FILE_INFO struct.
+*	@param	bIgnoreCase		If true the comparison is case insensitive.
+*
+*	@return		An integer less than, equal to, or greater than zero.
+**/
+static int _comparePath( FILE_INFO *pFileA, FILE_INFO *pFileB, bool bIgnoreCase )
+{
+	char	cPathA[MAX_PATH_SIZE],
+			cPathB[MAX_PATH_SIZE];
+
+	if( pFileA->pcDir == pFileB->pcDir )
+	{
+		return compareStr( pFileA->pcName, pFileB->pcName, bIgnoreCase );
+	}
+	getFilePath( pFileA, cPathA, sizeof(cPathA) );
+	getFilePath( pFileB, cPathB, sizeof(cPathB) );
+	return compareStr( cPathA, cPathB, bIgnoreCase );
+}
+
+/**
+*	_fileCompare
+*
+*		Compare two files using the sort fields of the arguments struct. The sort
+*		fields are applied in order until the files compare unequal.
+*
+*	@param	pvFileA			Address FILE_INFO struct.
+*	@param	pvFileB			Address FILE_INFO struct.
+*	@param	pvArgs			Address arguments struct
+*
+*	@return		An integer less than, equal to, or greater than zero if pvFileA is
+*				found, respectively, to be less than, to match, or be greater than
+*				pvFileB.
+**/
+static int _fileCompare( const void *pvFileA, const void *pvFileB, void *pvArgs )
+{
+	const FILE_INFO	*pFileA = (const FILE_INFO *)pvFileA,
+					*pFileB = (const FILE_INFO *)pvFileB;
+	ARGS			*pArgs	= (ARGS *)pvArgs;
+	SORT_FIELD		*pSortField;
+	int				iResult = 0,
+					i;
+
+	for( i = 0; i < pArgs->iSortFields && !iResult; i++ )
+	{
+		pSortField = &pArgs->sSortFields[i];
+		switch( pSortField->iProperty )
+		{
+			case PROP_M_NAME:
+				iResult = compareStr( pFileA->pcName, pFileB->pcName, pSortField->bIgnoreCase );
+				break;
+			case PROP_M_PATH:
+				iResult = _comparePath( (FILE_INFO *)pFileA, (FILE_INFO *)pFileB, pSortField->bIgnoreCase );
+				break;
+			case PROP_M_DIRECTORY:
+				iResult = compareInt( pFileA->directory, pFileB->directory );
+				break;
+			case PROP_M_SIZE:
+				iResult = compareInt( pFileA->lSize, pFileB->lSize );
+				break;
+			case PROP_M_MODIFIED:
+				iResult = compareInt( pFileA->lModified, pFileB->lModified );
+				break;
+		}
+		if( pSortField->bDescending )
+		{
+			iResult = -iResult;
+		}
+	}
+	return iResult;
+}
+
+/**
+*	_sortFileList
+*
+*		Sort a file list in place using the sort fields of the arguments struct.
+*		The sort is stable, files that compare equal retain their natural order,
+*		that is, the order in which they were found. After sorting only the files
+*		iStart through iStart+iCount-1 are retained, the files outside that range
+*		are released.
+*
+*	@param	pFileList		Address VECTOR struct.
+*	@param	pArgs			Address arguments struct
+*	@param	iStart			Index of the first file to return.
+*	@param	iCount			Maximum number of files to return (-1 = all).
+*
+*	@return		Address of the sorted VECTOR struct. If the list could not be sorted
+*				the original list is returned unchanged.
+**/
+static VECTOR *_sortFileList( VECTOR *pFileList, ARGS *pArgs, int iStart, int iCount )
+{
+	if( !vectorSort( pFileList, _fileCompare, pArgs ) )
+	{
+		cbtDebug( "Unable to sort %d files, out of memory.", vectorCount( pFileList ) );
+		return pFileList;
+	}
+	vectorSlice( pFileList, iStart, iCount, _destroyFileInfo );
+	return pFileList;
+}
+
+/**
+*	_pruneFileList
+*
+*		Remove all files from a deep search result that do not match the query. A
+*		directory that does not match the query itself is retained if any of its
+*		descendants match. The file list is pruned bottom up and in place.
+*
+*	@param	pFileList		Address VECTOR struct.
+*	@param	pArgs			Address arguments struct
+*
+*	@return		Address of the pruned VECTOR struct.
+**/
+static VECTOR *_pruneFileList( VECTOR *pFileList, ARGS *pArgs )
+{
+	FILE_INFO	*pFileInfo;
+	int			iCount,
+				i;
+
+	for( i = 0, iCount = 0; i < pFileList->iCount; i++ )
+	{
+		pFileInfo = (FILE_INFO *)pFileList->ppvData[i];
+		if( pFileInfo->pChildren )
+		{
+			pFileInfo->pChildren = _pruneFileList( pFileInfo->pChildren, pArgs );
+		}
+		if( queryMatch( pArgs->pQuery, pFileInfo->pcName, pFileInfo->directory,
+						pFileInfo->lSize, pFileInfo->lModified ) ||
+			!vectorIsEmpty( pFileInfo->pChildren ) )
+		{
+			pFileList->ppvData[iCount++] = pFileInfo;
+		}
+		else // No match
+		{
+			_destroyFileInfo( pFileInfo );
+		}
+	}
+	pFileList->iCount = iCount;
+	return pFileList;
+}
+
+/**
+*	_copyFileInfo
+*
+*		Returns a copy of a FILE_INFO struct. The children, if any, are not copied.
 *
 *	@param	pFileInfo		Address FILE_INFO struct.
+*
+*	@return		Address of the new FILE_INFO struct or NULL.
 **/
-static void _destroyFileInfo( FILE_INFO *pFileInfo )
+static FILE_INFO *_copyFileInfo( FILE_INFO *pFileInfo )
 {
+	FILE_INFO	*pCopy;
+	const char	*pcDir;
+	char		*pcName;
+
+	// While the request arena is active the directory path can be shared.
+	if( (pCopy = newFileInfo( pFileInfo->pcDir, strlen(pFileInfo->pcDir), pFileInfo->pcName,
+							   strlen(pFileInfo->pcName), arenaActive() )) )
+	{
+		pcName = pCopy->pcName;
+		pcDir  = pCopy->pcDir;
+		*pCopy = *pFileInfo;
+		pCopy->pcName	  = pcName;
+		pCopy->pcDir	  = pcDir;
+		pCopy->pcOldPath  = NULL;
+		pCopy->pChildren  = NULL;
+		pCopy->iPropMask &= ~(PROP_M_CHILDREN | PROP_M_OLDPATH);
+	}
+	return pCopy;
+}
+
+/**
+*	_changePath
+*
+*		Convert the full path of a journal record to a relative path. Only paths
+*		of files at or below the search path are converted.
+*
+*	@param	pcJournalPath	Address C-string containing the full path of the record.
+*	@param	pcFullPath		Address C-string containing the full search path.
+*	@param	pcRootDir		Address C-string containing the root directory.
+*	@param	pcPath			Address character buffer receiving the relative path.
+*	@param	iSize			Size of the character buffer.
+*
+*	@return		True if the file is located at or below the search path otherwise
+*				false.
+**/
+static bool _changePath( const char *pcJournalPath, char *pcFullPath, char *pcRootDir, char *pcPath, size_t iSize )
+{
+	size_t	iLen = strlen( pcFullPath );
+
+	if( strncmp( pcJournalPath, pcFullPath, iLen ) || (pcJournalPath[iLen] != '/' && pcJournalPath[iLen] != '\0') )
+	{
+		return false;
+	}
+	snprintf( pcPath, iSize, ".%s", &pcJournalPath[strlen(pcRootDir)] );
+	return true;
+}
+
+/**
+*	_isRenamed
+*
+*		Returns true if a file is the target of a rename operation.
+*
+*	@param	pcPath			Address C-string containing the relative file path.
+*	@param	pRenamed		Address LIST of relative paths of all renamed files.
+*
+*	@return		True or false.
+**/
+static bool _isRenamed( const char *pcPath, LIST *pRenamed )
+{
+	ENTRY	*pEntry;
+
+	for( pEntry = pRenamed->pNext; pEntry != pRenamed; pEntry = pEntry->pNext )
+	{
+		if( !strcmp( pcPath, (char *)pEntry->pvData ) )
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+*	_collectChanges
+*
+*		Add a copy of every file in a deep search result that was modified since
+*		the change feed token was issued, or renamed, to the list of changes. A
+*		directory that was modified is returned with its current children which
+*		allows the client to detect files added or removed by other means than
+*		this application.
+*
+*	@param	pChanges		Address VECTOR struct receiving the changes.
+*	@param	pFileList		Address VECTOR struct.
+*	@param	pArgs			Address arguments struct
+*	@param	pRenamed		Address LIST of relative paths of all renamed files.
+*	@param	bRenamed		True if the parent directory was renamed.
+**/
+static void _collectChanges( VECTOR *pChanges, VECTOR *pFileList, ARGS *pArgs, LIST *pRenamed, bool bRenamed )
+{
+	FILE_INFO	*pFileInfo,
+				*pCopy,
+				*pChild;
+	char		cPath[MAX_PATH_SIZE];
+	bool		bModified,
+				bMoved;
+	int			i, j;
+
+	for( i = 0; i < pFileList->iCount; i++ )
+	{
+		pFileInfo = (FILE_INFO *)pFileList->ppvData[i];
+		bModified = (pFileInfo->lModified >= pArgs->pSince->lTime);
+		bMoved	  = bRenamed || _isRenamed( getFilePath( pFileInfo, cPath, sizeof(cPath) ), pRenamed );
+		if( (bModified || bMoved) && (pCopy = _copyFileInfo( pFileInfo )) )
+		{
+			// A token of zero returns all files, no need to include the children.
+			if( bModified && pArgs->pSince->lTime && pFileInfo->pChildren &&
+				(pCopy->pChildren = newVector( pFileInfo->pChildren->iCount )) )
+			{
+				pCopy->iPropMask |= PROP_M_CHILDREN;
+				for( j = 0; j < pFileInfo->pChildren->iCount; j++ )
+				{
+					// Skip any child that could not be copied (out of memory).
+					if( (pChild = _copyFileInfo( (FILE_INFO *)pFileInfo->pChildren->ppvData[j] )) )
+					{
+						vectorAppend( pChild, pCopy->pChildren );
+					}
+				}
+			}
+			vectorAppend( pCopy, pChanges );
+		}
+		if( pFileInfo->pChildren )
+		{
+			_collectChanges( pChanges, pFileInfo->pChildren, pArgs, pRenamed, bMoved );
+		}
+	}
+}
+
+/**
+*	_removeContent
+*
+*		Delete all files in a directory and attach them, together with all its
+*		subdirectories, as the children of the directory. The files are deleted
+*		relative to the open directory while it is being read. This function is
+*		the task function of the delete task pool, each task is the FILE_INFO
+*		struct of a directory and each subdirectory is queued as a new task. The
+*		subdirectories themselves are deleted by _removeTree() once all tasks
+*		are completed. A symbolic link is deleted itself, it is never followed
+*		even if it refers to a directory.
+*
+*	@param	pPool			Address TASK_POOL struct or NULL.
+*	@param	iWorker			Index of the worker calling this function.
+*	@param	pvScan			Address DIR_SCAN struct.
+*	@param	pvDirectory		Address FILE_INFO struct of the directory.
+**/
+static void _removeContent( TASK_POOL *pPool, int iWorker, void *pvScan, void *pvDirectory )
+{
+	FILE_INFO	*pDirectory = (FILE_INFO *)pvDirectory,
+				*pFileInfo;
+	DIR_SCAN	*pScan = (DIR_SCAN *)pvScan;
+	OS_ARG		OSArg;
+	char		cFullPath[MAX_PATH_SIZE];
+	int			iResult;
+
+	snprintf( cFullPath, sizeof(cFullPath)-1, "%s/%s%s", pScan->pcRootDir, pDirectory->pcDir, pDirectory->pcName );
+	normalizePath( cFullPath );
+	strcat( cFullPath, "/*" );
+
+	pDirectory->pChildren  = newVector( 0 );
+	pDirectory->iPropMask |= PROP_M_CHILDREN;
+
+	pFileInfo = findFile_NP( cFullPath, pScan->pcRootDir, &OSArg, pScan->pArgs, &iResult );
+	if( iResult == HTTP_V_OK )
+	{
+		while( pFileInfo )
+		{
+			if( _fileFilter( pFileInfo, pScan->pArgs ) )
+			{
+				_destroyFileInfo( pFileInfo );
+			}
+			else if( pFileInfo->directory && !pFileInfo->bIsLink )
+			{
+				vectorAppend( pFileInfo, pDirectory->pChildren );
+				if( !pPool || !taskPush( pPool, iWorker, pFileInfo ) )
+				{
+					_removeContent( pPool, iWorker, pvScan, pFileInfo );
+				}
+			}
+			else if( !removeFile_NP( pFileInfo, pScan->pcRootDir, &OSArg ) )
+			{
+				vectorAppend( pFileInfo, pDirectory->pChildren );
+			}
+			else // File not deleted.
+			{
+				cbtDebug( "DELETE [%s%s] errno: %d", pFileInfo->pcDir, pFileInfo->pcName, errno );
+				_destroyFileInfo( pFileInfo );
+			}
+			pFileInfo = findNextFile_NP( cFullPath, pScan->pcRootDir, &OSArg, pScan->pArgs );
+		}
+		findEnd_NP( &OSArg );
+	}
+}
+
+/**
+*	_removeTree
+*
+*		Delete the subdirectories of a directory emptied by _removeContent(), bottom
+*		up, followed by the directory itself. All files and directories deleted are
+*		moved to the list of deleted files 'pFileList', a directory is added after
+*		its content.
+*
+*	@param	pFileList		Address VECTOR struct containing all deleted files.
+*	@param	pDirectory		Address FILE_INFO struct of the directory.
+*	@param	pcRootDir		Address C-string containing the root directory.
+*
+*	@return		0 if the directory was deleted otherwise -1 (errno holds the error code).
+**/
+static int _removeTree( VECTOR *pFileList, FILE_INFO *pDirectory, char *pcRootDir )
+{
+	FILE_INFO	*pFileInfo;
+	int			i;
+
+	if( pDirectory->pChildren )
+	{
+		for( i = 0; i < pDirectory->pChildren->iCount; i++ )
+		{
+			pFileInfo = (FILE_INFO *)pDirectory->pChildren->ppvData[i];
+			if( !pFileInfo->directory || pFileInfo->bIsLink || !_removeTree( pFileList, pFileInfo, pcRootDir ) )
+			{
+				vectorAppend( pFileInfo, pFileList );
+			}
+			else // Directory not deleted.
+			{
+				_destroyFileInfo( pFileInfo );
+			}
+		}
+		// All children have been moved or released.
+		destroyVector( &pDirectory->pChildren, NULL );
+		pDirectory->iPropMask &= ~PROP_M_CHILDREN;
+	}
+	return removeFile_NP( pDirectory, pcRootDir, NULL );
+}
+
+/**
+*	_removeDirectory
+*
+*		Delete a directory. The content of the directory is deleted after which
+*		the directory itself is delete. If pArgs->iThreads is greater than one
+*		independent subdirectories are emptied in parallel.
+*
+*	@param	pFileList		Address VECTOR struct containing all deleted files.
+*	@param	pcFullPath		Address C-string containing the full directory path.
+*	@param	pcRootDir		Address C-string containing the root directory.
+*	@param	pArgs			Address arguments struct
+*	@param	piResult		Address integer receiving the final result code:
+*							HTTP_V_OK, HTTP_V_NOT_FOUND, HTTP_V_UNAUTHORIZED or
+*							HTTP_V_SERVER_ERROR
+*
+*	@return		0 if successful otherwise -1 (errno holds the error code).
+**/
+static int _removeDirectory( VECTOR *pFileList, char *pcFullPath, char *pcRootDir, ARGS *pArgs, int *piResult )
+{
+	TASK_POOL	*pPool = NULL;
+	FILE_INFO	sDirectory;
+	DIR_SCAN	sScan;
+	char		cRelPath[MAX_PATH_SIZE];
+
+	snprintf( cRelPath, sizeof(cRelPath)-1, ".%s", &pcFullPath[strlen(pcRootDir)] );
+
+	memset( &sDirectory, 0, sizeof(FILE_INFO) );
+	sDirectory.pcName	 = "";
+	sDirectory.pcDir	 = cRelPath;
+	sDirectory.directory = true;
+
+	sScan.pcRootDir = pcRootDir;
+	sScan.pArgs		= pArgs;
+	if( pArgs->iThreads > 1 )
+	{
+		pPool = newTaskPool( pArgs->iThreads, _removeContent, &sScan );
+	}
+	_removeContent( pPool, 0, &sScan, &sDirectory );
+	if( pPool )
+	{
+		taskRun( pPool );
+		destroyTaskPool( &pPool );
+	}
+	*piResult = HTTP_V_OK;
+
+	return _removeTree( pFileList, &sDirectory, pcRootDir );
+}
+
+/**
+*	removeFile
+*
+*		Delete a file or directory. If the file is a directory the directory and
+*		its content is deleted. Deleted files are added to the list of deleted
+*		files 'pFileList'.
+*
+*	@param	pFileList		Address VECTOR struct containing all deleted files.
+*	@param	pcFullPath		Address C-string containing the full directory path.
+*	@param	pcRootDir		Address C-string containing the root directory.
+*	@param	pArgs			Address arguments struct
+*	@param	piResult		Address integer receiving the final result code:
+*							HTTP_V_OK, HTTP_V_NOT_FOUND, HTTP_V_UNAUTHORIZED or
+*							HTTP_V_SERVER_ERROR
+*
+*	@return		1 if successful otherwise 0.
+**/
+static int _removeFile( VECTOR *pFileList, FILE_INFO *pFileInfo, char *pcRootDir, ARGS *pArgs, int *piResult )
+{
+	char	cFilePath[MAX_PATH_SIZE];
+	int		iResult;
+
 	if( pFileInfo )
 	{
-		free( pFileInfo->pcName );
-		free( pFileInfo->pcPath );
-		if( pFileInfo->pChildren )
+		*piResult = HTTP_V_OK;
+		snprintf( cFilePath, sizeof(cFilePath)-1, "%s/%s%s", pcRootDir, pFileInfo->pcDir, pFileInfo->pcName );
+		normalizePath( cFilePath );
+		if( pFileInfo->directory && !pFileInfo->bIsLink )
+		{
+			iResult = _removeDirectory( pFileList, cFilePath, pcRootDir, pArgs, piResult );
+		}
+		else
+		{
+			iResult = removeFile_NP( pFileInfo, pcRootDir, NULL );
+		}
+		// If success, add to the list of deleted files.
+		if( iResult == 0 ) 
+		{
+			vectorAppend( pFileInfo, pFileList );
+		}
+		else
+		{
+			switch( errno )
+			{
+				case ENOTEMPTY:	// Directory not empty
+				case EACCES:	// Access denied
+				case EPERM:		// No permission
+				case EBUSY:		// System file
+				case EROFS:		// Read-only File System
+					*piResult = HTTP_V_UNAUTHORIZED;
+					break;				
+				case ENOENT:
+					*piResult = HTTP_V_NOT_FOUND;
+					break;
+				default:
+					*piResult = HTTP_V_SERVER_ERROR;
+					break;
+			}
+			cbtDebug( "DELETE [%s] errno: %d", cFilePath, errno );
+		}
+		return (iResult ? 0 : 1);
+	}
+	*piResult = HTTP_V_NO_CONTENT;
+	return 0;
+}
+
+/**
+*	destroyFileList
+*
+*		Release all resources associated with a file list. Not only is the list deleted
+*		but also ALL FILIE_INFO structs the list referencing. While the request arena
+*		is active the list and FILE_INFO structs are all part of the arena and there
+*		is no need to walk the list, the arena releases them in one step.
+*
+*	@param	ppFileList		Address of a pointer of type VECTOR.
+**/
+void destroyFileList( VECTOR **ppFileList )
+{
+	if( !arenaActive() )
+	{
+		destroyVector( ppFileList, _destroyFileInfo );
+	}
+	else if( ppFileList )
+	{
+		*ppFileList = NULL;
+	}
+}
+
+/**
+*	getChanges
+*
+*		Returns the changes to the file tree at pcFullPath since the change feed
+*		token was issued. The list of changes starts with the files deleted, or
+*		renamed, as recorded in the journal followed by all files modified or
+*		renamed. Deleted files have the property "deleted" set. The changes are
+*		returned as a flat list, that is, only modified directories have children.
+*
+*	@param	pcFullPath		Address C-string containing the full path.
+*	@param	pcRootDir		Address C-string containing the root directory.
+*	@param	pArgs			Address arguments struct
+*	@param	lEnd			Journal position when the request was received.
+*	@param	piResult		Address integer receiving the final result code:
+*							HTTP_V_OK, HTTP_V_NOT_FOUND or HTTP_V_NO_CONTENT
+*
+*	@return		Address VECTOR struct or NULL in case no match was found.
+**/
+VECTOR *getChanges( char *pcFullPath, char *pcRootDir, ARGS *pArgs, long lEnd, int *piResult )
+{
+	JOURNAL_ENTRY	*pRecord;
+	FILE_INFO		*pFileInfo;
+	VECTOR			*pFileList,
+					*pChanges = NULL;
+	LIST			*pJournal,
+					*pRenamed;
+	ENTRY			*pEntry;
+	char			cPath[MAX_PATH_SIZE],
+					*pcName;
+
+	// The change feed always covers the entire subtree.
+	pArgs->pOptions->bDeep = true;
+	pArgs->iStart	  = 0;
+	pArgs->iCount	  = -1;
+	pArgs->iNeedMask |= PROP_M_MODIFIED;
+
+	if( (pFileList = getFile( pcFullPath, pcRootDir, pArgs, piResult )) )
+	{
+		pChanges = newVector( 0 );
+		pRenamed = newList();
+		if( pArgs->pSince->lTime && (pJournal = journalRead( pArgs->pSince->lOffset, lEnd )) )
+		{
+			for( pEntry = pJournal->pNext; pEntry != pJournal; pEntry = pEntry->pNext )
+			{
+				pRecord = (JOURNAL_ENTRY *)pEntry->pvData;
+				if( _changePath( pRecord->pcPath, pcFullPath, pcRootDir, cPath, sizeof(cPath) ) )
+				{
+					pcName = (pcName = strrchr( cPath, '/' )) ? pcName + 1 : cPath;
+					if( (pFileInfo = newFileInfo( cPath, pcName - cPath, pcName, strlen(pcName), false )) )
+					{
+						pFileInfo->lModified = pRecord->lTime;
+						pFileInfo->iPropMask = PROP_M_NAME | PROP_M_PATH | PROP_M_MODIFIED | PROP_M_DELETED;
+						vectorAppend( pFileInfo, pChanges );
+					}
+				}
+				if( pRecord->pcNewPath &&
+					_changePath( pRecord->pcNewPath, pcFullPath, pcRootDir, cPath, sizeof(cPath) ) )
+				{
+					insertTail( mstrcpy( cPath ), pRenamed );
+				}
+			}
+			journalDestroy( &pJournal );
+		}
+		_collectChanges( pChanges, pFileList, pArgs, pRenamed, false );
+		destroyList( &pRenamed, free );
+		destroyFileList( &pFileList );
+
+		*piResult = vectorIsEmpty( pChanges ) ? HTTP_V_NO_CONTENT : HTTP_V_OK;
+	}
+	return pChanges;
+}
+
+/**
+*	_getDirectory
+*
+*		Returns the content of a single directory level as a vector of FILE_INFO
+*		structs. No subdirectories are searched. Only the files iStart through
+*		iStart+iCount-1 are returned, all other files are counted but no FILE_INFO
+*		struct is allocated for them (except possibly for the first file). If the
+*		files are to be sorted, all files are loaded and the range is selected
+*		after sorting.
+*
+*	@param	pcFullPath		Address C-string containing the full directory path.
+*	@param	pcRootDir		Address C-string containing the root directory.
+*	@param	pArgs			Address arguments struct
+*	@param	iStart			Index of the first file to return.
+*	@param	iCount			Maximum number of files to return (-1 = all).
+*	@param	piTotal			Address integer receiving the total number of files
+*							in the directory, or NULL.
+*	@param	piResult		Address integer receiving the final result code:
+*							HTTP_V_OK, HTTP_V_NOT_FOUND or HTTP_V_NO_CONTENT
+*
+*	@return		Address VECTOR struct or NULL in case no match was found.
+**/
+static VECTOR *_getDirectory( char *pcFullPath, char *pcRootDir, ARGS *pArgs, int iStart, int iCount, 
+							int *piTotal, int *piResult )
+{
+	FILE_INFO	*pFileInfo;
+	OS_ARG		OSArg;
+	VECTOR		*pFileList = NULL;
+	char		cFullPath[MAX_PATH_SIZE];
+	int			iIndex = 0,
+				iFirst = iStart,		// Range of files to load.
+				iLimit = iCount;
+	
+	// If sorted, the range can only be selected after all files are loaded.
+	if( pArgs->iSortFields )
+	{
+		iFirst = 0;
+		iLimit = -1;
+	}
+	snprintf( cFullPath, sizeof(cFullPath)-1,"%s/*", pcFullPath );
+	pFileInfo = findFile_NP( cFullPath, pcRootDir, &OSArg, pArgs, piResult );
+	if( *piResult == HTTP_V_OK )	// Directory found, it may be empty though.
+	{
+		pFileList = newVector( 0 );		// Allocate a new vector.
+		while( pFileInfo ) 
+		{
+			if( !_fileFilter( pFileInfo, pArgs ) )
+			{
+				if( iIndex >= iFirst && (iLimit < 0 || iIndex < iFirst + iLimit) )
+				{
+					vectorAppend( pFileInfo, pFileList );
+				}
+				else // Outside the requested range.
+				{
+					_destroyFileInfo( pFileInfo );
+				}
+				iIndex++;
+			}
+			else // File was filtered out
+			{
+				_destroyFileInfo( pFileInfo );
+			}
+			// Skip any files before the requested range and count those after it.
+			while( (iIndex < iFirst || (iLimit >= 0 && iIndex >= iFirst + iLimit)) &&
+				   findSkipFile_NP( cFullPath, pcRootDir, &OSArg, pArgs ) )
+			{
+				iIndex++;
+			}
+			pFileInfo = findNextFile_NP( cFullPath, pcRootDir, &OSArg, pArgs );
+		}
+		if( pArgs->iSortFields )
+		{
+			pFileList = _sortFileList( pFileList, pArgs, iStart, iCount );
+		}
+		if( piTotal )
+		{
+			*piTotal = iIndex;
+		}
+
+		if( vectorIsEmpty( pFileList ) )
+		{
+			*piResult = HTTP_V_NO_CONTENT;
+		}
+		findEnd_NP( &OSArg );		
+	}
+	return pFileList;
+}
+
+/**
+*	_expandList
+*
+*		Expand all directories in a file list. If a task pool is specified each
+*		directory is queued as a separate task, otherwise the directories are
+*		expanded recursively by the calling thread. Directories at the maximum
+*		search depth, if any, are not expanded.
+*
+*	@param	pPool			Address TASK_POOL struct or NULL.
+*	@param	iWorker			Index of the worker calling this function.
+*	@param	pScan			Address DIR_SCAN struct.
+*	@param	pFileList		Address VECTOR struct.
+*	@param	iDepth			Directory level of the files in the list.
+**/
+static void _expandList( TASK_POOL *pPool, int iWorker, DIR_SCAN *pScan, VECTOR *pFileList, int iDepth )
+{
+	FILE_INFO	*pFileInfo;
+	int			iMaxDepth = pScan->pArgs->pOptions->iMaxDepth,
+				i;
+
+	if( iMaxDepth && iDepth >= iMaxDepth )
+	{
+		return;
+	}
+	for( i = 0; i < pFileList->iCount; i++ )
+	{
+		pFileInfo = (FILE_INFO *)pFileList->ppvData[i];
+		if( pFileInfo->directory )
+		{
+			pFileInfo->iDepth = iDepth;
+			if( !pPool || !taskPush( pPool, iWorker, pFileInfo ) )
+			{
+				_expandDirectory( pPool, iWorker, pScan, pFileInfo );
+			}
+		}
+	}
+}
+
+/**
+*	_expandDirectory
+*
+*		Load the content of a directory and attach it as the children of the
+*		directory. This function is the task function of the directory task pool,
+*		each task is the FILE_INFO struct of a directory. Because every task only
+*		modifies the FILE_INFO struct it was given, the order of the resulting
+*		tree is the same regardless of the number of threads used.
+*
+*	@param	pPool			Address TASK_POOL struct or NULL.
+*	@param	iWorker			Index of the worker calling this function.
+*	@param	pvScan			Address DIR_SCAN struct.
+*	@param	pvDirectory		Address FILE_INFO struct of the directory.
+**/
+static void _expandDirectory( TASK_POOL *pPool, int iWorker, void *pvScan, void *pvDirectory )
+{
+	FILE_INFO	*pDirectory = (FILE_INFO *)pvDirectory;
+	DIR_SCAN	*pScan = (DIR_SCAN *)pvScan;
+	char		cFullPath[MAX_PATH_SIZE];
+	int			iResult;
+
+	snprintf( cFullPath, sizeof(cFullPath)-1, "%s/%s%s", pScan->pcRootDir, pDirectory->pcDir, pDirectory->pcName );
+	normalizePath( cFullPath );
+
+	pDirectory->pChildren  = _getDirectory( cFullPath, pScan->pcRootDir, pScan->pArgs, 0, -1, NULL, &iResult );
+	pDirectory->iPropMask |= PROP_M_CHILDREN;
+	if( pDirectory->pChildren )
+	{
+		_expandList( pPool, iWorker, pScan, pDirectory->pChildren, pDirectory->iDepth + 1 );
+	}
+}
+
+/**
+*	getDirectory
+*
+*		Returns the content of a directory as a vector of FILE_INFO structs.
+*		If a deep search is requested all subdirectories, up to the maximum search
+*		depth, are loaded as well. The subdirectories are loaded by a pool of
+*		pArgs->iThreads worker threads. If a range of files is requested (query
+*		string parameters 'start' and 'count') only the files in that range are
+*		returned and expanded. If a deep search has a query, all directories are
+*		expanded after which the tree is pruned and the range is selected from
+*		the files remaining.
+*
+*	@param	pcFullPath		Address C-string containing the full directory path.
+*	@param	pcRootDir		Address C-string containing the root directory.
+*	@param	pArgs			Address arguments struct
+*	@param	piTotal			Address integer receiving the total number of files
+*							in the directory, or NULL.
+*	@param	piResult		Address integer receiving the final result code:
+*							HTTP_V_OK, HTTP_V_NOT_FOUND or HTTP_V_NO_CONTENT
+*
+*	@return		Address VECTOR struct or NULL in case no match was found.
+**/
+VECTOR *getDirectory( char *pcFullPath, char *pcRootDir, ARGS *pArgs, int *piTotal, int *piResult )
+{
+	TASK_POOL	*pPool = NULL;
+	DIR_SCAN	sScan;
+	VECTOR		*pFileList;
+	bool		bPrune = (pArgs->pQuery && pArgs->pOptions->bDeep);
+
+	// If the deep search result is to be pruned the range can only be selected
+	// after pruning.
+	if( bPrune )
+	{
+		pFileList = _getDirectory( pcFullPath, pcRootDir, pArgs, 0, -1, NULL, piResult );
+	}
+	else
+	{
+		pFileList = _getDirectory( pcFullPath, pcRootDir, pArgs, pArgs->iStart, pArgs->iCount, piTotal, piResult );
+	}
+	if( pFileList && pArgs->pOptions->bDeep )
+	{
+		sScan.pcRootDir = pcRootDir;
+		sScan.pArgs		= pArgs;
+
+		if( pArgs->iThreads > 1 )
+		{
+			pPool = newTaskPool( pArgs->iThreads, _expandDirectory, &sScan );
+		}
+		_expandList( pPool, 0, &sScan, pFileList, 1 );
+		if( pPool )
+		{
+			taskRun( pPool );
+			destroyTaskPool( &pPool );
+		}
+		if( bPrune )
 		{
-			destroyList( &pFileInfo->pChildren, _destroyFileInfo );
+			pFileList = _pruneFileList( pFileList, pArgs );
+			if( piTotal )
+			{
+				*piTotal = vectorCount( pFileList );
+			}
+			vectorSlice( pFileList, pArgs->iStart, pArgs->iCount, _destroyFileInfo );
+			*piResult = vectorIsEmpty( pFileList ) ? HTTP_V_NO_CONTENT : HTTP_V_OK;
 		}
-		free( pFileInfo );
 	}
+	return pFileList;
 }
 
 /**
-*	_fileFilter
+*	_linkCompare
 *
-*		Returns true if a file is to be exlcuded (filtered) based on the HTTP query
-*		string parameters, otherwise false.
+*		Compare two hard linked files by device and inode (qsort() callback).
 *
-*	@param	pFileInfo		Address FILE_INFO struct.
-*	@param	pArgs			Address query string arguments struct
-* 
-*	@return	true or false
+*	@param	pvLinkA			Address FILE_LINK struct.
+*	@param	pvLinkB			Address FILE_LINK struct.
+*
+*	@return		An integer less than, equal to, or greater than zero.
 **/
-static bool _fileFilter( FILE_INFO *pFileInfo, ARGS *pArgs )
+static int _linkCompare( const void *pvLinkA, const void *pvLinkB )
 {
-	OPTIONS	*pOptions = pArgs->pOptions;
+	const FILE_LINK	*pLinkA = (const FILE_LINK *)pvLinkA,
+					*pLinkB = (const FILE_LINK *)pvLinkB;
 
-	if( (!pOptions->bShowHiddenFiles && (pFileInfo->pcName[0] == '.' || pFileInfo->bIsHidden)) ||
-		(!strcmp(pFileInfo->pcName, ".") || !strcmp(pFileInfo->pcName, "..")) )
+	if( pLinkA->lDevice != pLinkB->lDevice )
 	{
-		return true;
+		return compareInt( pLinkA->lDevice, pLinkB->lDevice );
 	}
-	return false;
+	return compareInt( pLinkA->lInode, pLinkB->lInode );
 }
 
 /**
-*	_removeDirectory
-*
-*		Delete a directory. The content of the directory is deleted after which
-*		the directory itself is delete.
+*	_mergeLinks
 *
-*	@param	pFileList		Address LIST struct containing all deleted files.
-*	@param	pcFullPath		Address C-string containing the full directory path.
-*	@param	pcRootDir		Address C-string containing the root directory.
-*	@param	pArgs			Address arguments struct
-*	@param	piResult		Address integer receiving the final result code:
-*							HTTP_V_OK, HTTP_V_NOT_FOUND, HTTP_V_UNAUTHORIZED or
-*							HTTP_V_SERVER_ERROR
+*		Merge two sorted sets of hard linked files. Files present in both sets are
+*		included only once. The source set is released and the destination set is
+*		replaced by the merged set.
 *
-*	@return		1 if successful otherwise 0.
+*	@param	pDest			Address LINK_SET struct receiving the merged set.
+*	@param	pSource			Address LINK_SET struct.
 **/
-static int _removeDirectory( LIST *pFileList, char *pcFullPath, char *pcRootDir, ARGS *pArgs, int *piResult )
+static void _mergeLinks( LINK_SET *pDest, LINK_SET *pSource )
 {
-	FILE_INFO	*pDirectory;
-	LIST	*pDirList, 
-			*pChildList;
-	ENTRY	*pEntry;
-	int		iResult,
-			iMode = 0777;
-	
-	if( (pDirList = getFile( pcFullPath, pcRootDir, pArgs, piResult )) )
+	FILE_LINK	*pMerge,
+				*pNext;
+	int			iDest = 0,
+				iSource = 0,
+				iCount = 0;
+
+	if( !pSource->iCount )
+	{
+		free( pSource->pLinks );
+		return;
+	}
+	if( (pMerge = (FILE_LINK *)malloc( (pDest->iCount + pSource->iCount) * sizeof(FILE_LINK) )) )
 	{
-		pDirectory = pDirList->pNext->pvData;
-		if( pDirectory )
+		while( iDest < pDest->iCount || iSource < pSource->iCount )
 		{
-			pChildList = pDirectory->pChildren;
-
-			chmod( pcFullPath, iMode );
-			// Delete directory content		
-			for( pEntry = pChildList->pNext; pEntry != pChildList; pEntry = pEntry->pNext )
+			if( iSource == pSource->iCount || 
+				(iDest < pDest->iCount && _linkCompare( &pDest->pLinks[iDest], &pSource->pLinks[iSource] ) <= 0) )
 			{
-				iResult = _removeFile( pFileList, pEntry->pvData, pcRootDir, pArgs, piResult );
-				if( iResult )
-				{
-					// Detach child from list so it won't be destroyed.
-					pEntry->pvData = NULL;
-				}
+				pNext = &pDest->pLinks[iDest++];
+			}
+			else
+			{
+				pNext = &pSource->pLinks[iSource++];
+			}
+			if( !iCount || _linkCompare( &pMerge[iCount-1], pNext ) )
+			{
+				pMerge[iCount++] = *pNext;
 			}
-			destroyFileList( &pDirList );
-
-			*piResult = HTTP_V_OK;
 		}
-		// Now delete the directory itself.
-		return rmdir( pcFullPath );
+		free( pDest->pLinks );
+		pDest->pLinks = pMerge;
+		pDest->iCount = pDest->iSize = iCount;
 	}
-	return ENOENT;
+	free( pSource->pLinks );
 }
 
 /**
-*	removeFile
-*
-*		Delete a file or directory. If the file is a directory the directory and
-*		its content is deleted. Deleted files are added to the list of deleted
-*		files 'pFileList'.
+*	_aggregateList
 *
-*	@param	pFileList		Address LIST struct containing all deleted files.
-*	@param	pcFullPath		Address C-string containing the full directory path.
-*	@param	pcRootDir		Address C-string containing the root directory.
-*	@param	pArgs			Address arguments struct
-*	@param	piResult		Address integer receiving the final result code:
-*							HTTP_V_OK, HTTP_V_NOT_FOUND, HTTP_V_UNAUTHORIZED or
-*							HTTP_V_SERVER_ERROR
+*		Compute the number of files and the total size of the files in each of the
+*		directories of a file list, including all descendants, and store them in
+*		the FILE_INFO struct of the directory. Files with multiple hard links are
+*		counted only once per directory, files whose number of links is unknown
+*		are always counted. The totals of the files not in pLinks are added to
+*		plFiles and plBytes, the hard linked files are added to pLinks.
 *
-*	@return		1 if successful otherwise 0.
+*	@param	pFileList		Address VECTOR struct.
+*	@param	pLinks			Address LINK_SET struct receiving the hard linked files.
+*	@param	plFiles			Address long receiving the number of files.
+*	@param	plBytes			Address long receiving the total file size.
 **/
-static int _removeFile( LIST *pFileList, FILE_INFO *pFileInfo, char *pcRootDir, ARGS *pArgs, int *piResult )
+static void _aggregateList( VECTOR *pFileList, LINK_SET *pLinks, long *plFiles, long *plBytes )
 {
-	char	cFilePath[MAX_PATH_SIZE];
-	int		iResult,
-			iMode = 0666;
+	FILE_INFO	*pFileInfo;
+	LINK_SET	sLinks,
+				sLevel = { NULL, 0, 0 };
+	void		*pvNew;
+	long		lFiles,
+				lBytes;
+	int			i, j;
 
-	if( pFileInfo )
+	for( j = 0; j < pFileList->iCount; j++ )
 	{
-		*piResult = HTTP_V_OK;
-		snprintf( cFilePath, sizeof(cFilePath)-1, "%s/%s", pcRootDir, pFileInfo->pcPath );
-		normalizePath( cFilePath );
+		pFileInfo = (FILE_INFO *)pFileList->ppvData[j];
 		if( pFileInfo->directory )
 		{
-			iResult = _removeDirectory( pFileList, cFilePath, pcRootDir, pArgs, piResult );
-		}
-		else
-		{
-			chmod( cFilePath, iMode );
-			iResult = remove( cFilePath );
+			memset( &sLinks, 0, sizeof(LINK_SET) );
+			lFiles = lBytes = 0;
+			if( pFileInfo->pChildren )
+			{
+				_aggregateList( pFileInfo->pChildren, &sLinks, &lFiles, &lBytes );
+			}
+			pFileInfo->lFiles	  = lFiles + sLinks.iCount;
+			pFileInfo->lBytes	  = lBytes;
+			pFileInfo->iPropMask |= PROP_M_AGGREGATE;
+			for( i = 0; i < sLinks.iCount; i++ )
+			{
+				pFileInfo->lBytes += sLinks.pLinks[i].lSize;
+			}
+			*plFiles += lFiles;
+			*plBytes += lBytes;
+			_mergeLinks( pLinks, &sLinks );
 		}
-		// If success, add to the list of deleted files.
-		if( iResult == 0 ) 
+		else if( pFileInfo->iLinks > 1 )
 		{
-			insertTail( pFileInfo, pFileList );
+			if( sLevel.iCount == sLevel.iSize )
+			{
+				sLevel.iSize = sLevel.iSize ? sLevel.iSize * 2 : 16;
+				if( !(pvNew = realloc( sLevel.pLinks, sLevel.iSize * sizeof(FILE_LINK) )) )
+				{
+					continue;
+				}
+				sLevel.pLinks = (FILE_LINK *)pvNew;
+			}
+			sLevel.pLinks[sLevel.iCount].lDevice = pFileInfo->lDevice;
+			sLevel.pLinks[sLevel.iCount].lInode	 = pFileInfo->lInode;
+			sLevel.pLinks[sLevel.iCount].lSize	 = pFileInfo->lSize;
+			sLevel.iCount++;
 		}
 		else
 		{
-			switch( errno )
-			{
-				case ENOTEMPTY:	// Directory not empty
-				case EACCES:	// Access denied
-				case EPERM:		// No permission
-				case EBUSY:		// System file
-				case EROFS:		// Read-only File System
-					*piResult = HTTP_V_UNAUTHORIZED;
-					break;				
-				case ENOENT:
-					*piResult = HTTP_V_NOT_FOUND;
-					break;
-				default:
-					*piResult = HTTP_V_SERVER_ERROR;
-					break;
-			}
-			cbtDebug( "DELETE [%s] errno: %d", cFilePath, errno );
+			*plFiles += 1;
+			*plBytes += pFileInfo->lSize;
 		}
-		return (iResult ? 0 : 1);
 	}
-	*piResult = HTTP_V_NO_CONTENT;
-	return 0;
+	qsort( sLevel.pLinks, sLevel.iCount, sizeof(FILE_LINK), _linkCompare );
+	_mergeLinks( pLinks, &sLevel );
 }
 
 /**
-*	destroyFileList
+*	_pathCompare
 *
-*		Release all resources associated with a file list. Not only is the list deleted
-*		but also ALL FILIE_INFO structs the list referencing.
+*		Compare the paths of two FILE_INFO structs (qsort() and bsearch() callback).
 *
-*	@param	ppFileList		Address of a pointer of type LIST.
+*	@param	pvFileA			Address of a pointer to a FILE_INFO struct.
+*	@param	pvFileB			Address of a pointer to a FILE_INFO struct.
+*
+*	@return		An integer less than, equal to, or greater than zero.
 **/
-void destroyFileList( LIST **ppFileList )
+static int _pathCompare( const void *pvFileA, const void *pvFileB )
 {
-	destroyList( ppFileList, _destroyFileInfo );
+	return _comparePath( *(FILE_INFO **)pvFileA, *(FILE_INFO **)pvFileB, false );
 }
 
 /**
-*	fileCount
-*
-*		Returns the number of files in a linked list. If parameter iDeep equals true a
-*		recursive count is performed, that is, all children in directories are included
-*		in the total count. By default only siblings of pFileInfo are counted.
+*	_listDirectories
 *
-*	@param	pFileInfo		Address FILE_INFO struct.
-*	@param	iDeep			Boolean, if true a recursive count is performed counting
-*							all files and their children, if any.
+*		Collect the FILE_INFO structs of all directories in a file list, including
+*		all descendants.
 *
-*	@return		The number of files counted.
+*	@param	pFileList		Address VECTOR struct.
+*	@param	pppDirs			Address of the array of directories.
+*	@param	piCount			Address integer holding the number of directories.
+*	@param	piSize			Address integer holding the size of the array.
 **/
-int fileCount( LIST *pFileList, bool iDeep )
+static void _listDirectories( VECTOR *pFileList, FILE_INFO ***pppDirs, int *piCount, int *piSize )
 {
 	FILE_INFO	*pFileInfo;
-	ENTRY		*pEntry;
-	int			iCount = 0;
+	void		*pvNew;
+	int			i;
 
-	for( pEntry = pFileList->pNext; pEntry != pFileList; pEntry = pEntry->pNext )
+	for( i = 0; i < pFileList->iCount; i++ )
 	{
-		pFileInfo = (FILE_INFO *)pEntry->pvData;
-		
-		if( pFileInfo->pChildren && iDeep)
+		pFileInfo = (FILE_INFO *)pFileList->ppvData[i];
+		if( pFileInfo->directory )
 		{
-			iCount += fileCount( pFileInfo->pChildren, iDeep );
+			if( *piCount == *piSize )
+			{
+				*piSize = *piSize ? *piSize * 2 : 64;
+				if( !(pvNew = realloc( *pppDirs, *piSize * sizeof(FILE_INFO *) )) )
+				{
+					return;
+				}
+				*pppDirs = (FILE_INFO **)pvNew;
+			}
+			(*pppDirs)[(*piCount)++] = pFileInfo;
+			if( pFileInfo->pChildren )
+			{
+				_listDirectories( pFileInfo->pChildren, pppDirs, piCount, piSize );
+			}
 		}
-		iCount++;
 	}
-	return iCount;
 }
 
 /**
-*	getDirectory
+*	_copyTotals
 *
-*		Returns the content of a directory as a linked list of FILE_INFO structs.
-*
-*	@param	pcFullPath		Address C-string containing the full directory path.
-*	@param	pcRootDir		Address C-string containing the root directory.
-*	@param	pArgs			Address arguments struct
-*	@param	piResult		Address integer receiving the final result code:
-*							HTTP_V_OK, HTTP_V_NOT_FOUND or HTTP_V_NO_CONTENT
+*		Copy the subtree totals of the directories in a file list, including all
+*		descendants, from a sorted array of directories with the same paths.
 *
-*	@return		Address LIST struct or NULL in case no match was found.
+*	@param	pFileList		Address VECTOR struct.
+*	@param	ppDirs			Address array of directories sorted by path.
+*	@param	iCount			Number of directories in the array.
 **/
-LIST *getDirectory( char *pcFullPath, char *pcRootDir, ARGS *pArgs, int *piResult )
+static void _copyTotals( VECTOR *pFileList, FILE_INFO **ppDirs, int iCount )
 {
-	FILE_INFO	*pFileInfo;
-	OPTIONS		*pOptions = pArgs->pOptions;
-	OS_ARG		OSArg;
-	LIST		*pFileList = NULL;
-	char		cFullPath[MAX_PATH_SIZE];
-	int			iResult;
-	
-	snprintf( cFullPath, sizeof(cFullPath)-1,"%s/*", pcFullPath );
-	if( (pFileInfo = findFile_NP( cFullPath, pcRootDir, &OSArg, pArgs, piResult )) )
+	FILE_INFO	*pFileInfo,
+				**ppMatch;
+	int			i;
+
+	for( i = 0; i < pFileList->iCount; i++ )
 	{
-		pFileList = newList();		// Allocate a new list header.
-		do {
-			if( !_fileFilter( pFileInfo, pArgs ) )
+		pFileInfo = (FILE_INFO *)pFileList->ppvData[i];
+		if( pFileInfo->directory )
+		{
+			if( (ppMatch = (FILE_INFO **)bsearch( &pFileInfo, ppDirs, iCount, sizeof(FILE_INFO *), _pathCompare )) )
 			{
-				if( pFileInfo->directory && pOptions->bDeep )
-				{
-					snprintf( cFullPath, sizeof(cFullPath)-1, "%s/%s", pcFullPath, pFileInfo->pcName );
-					pFileInfo->pChildren  = getDirectory( cFullPath, pcRootDir, pArgs, &iResult );
-					pFileInfo->iPropMask |= PROP_M_CHILDREN;
-				}
-				insertTail( pFileInfo, pFileList );
-				*piResult = HTTP_V_OK;
+				pFileInfo->lFiles	  = (*ppMatch)->lFiles;
+				pFileInfo->lBytes	  = (*ppMatch)->lBytes;
+				pFileInfo->iPropMask |= PROP_M_AGGREGATE;
 			}
-			else // File was filtered out
+			if( pFileInfo->pChildren )
 			{
-				_destroyFileInfo( pFileInfo );
+				_copyTotals( pFileInfo->pChildren, ppDirs, iCount );
 			}
-		} while ( (pFileInfo = findNextFile_NP( cFullPath, pcRootDir, &OSArg, pArgs )) );
+		}
+	}
+}
+
+/**
+*	_aggregateDirectory
+*
+*		Compute the subtree totals of a directory and all directories returned as
+*		its descendants. Unless the children of the directory already hold the
+*		entire subtree the subtree is loaded separately, using pArgs->iThreads
+*		worker threads, and the totals are copied to the directories returned.
+*
+*	@param	pDirectory		Address FILE_INFO struct of the directory.
+*	@param	pcFullPath		Address C-string containing the full directory path.
+*	@param	pcRootDir		Address C-string containing the root directory.
+*	@param	pArgs			Address arguments struct
+**/
+static void _aggregateDirectory( FILE_INFO *pDirectory, char *pcFullPath, char *pcRootDir, ARGS *pArgs )
+{
+	FILE_INFO	sDirectory,
+				**ppDirs = NULL;
+	LINK_SET	sLinks = { NULL, 0, 0 };
+	OPTIONS		sOptions = *pArgs->pOptions;
+	ARGS		sArgs	 = *pArgs;
+	VECTOR		*pTree	 = pDirectory->pChildren,
+				*pList;
+	long		lFiles = 0,
+				lBytes = 0;
+	int			iResult,
+				iCount = 0,
+				iSize = 0;
+
+	// Load the entire subtree unless a complete, unfiltered, deep search was performed.
+	if( !sOptions.bDeep || sOptions.iMaxDepth || pArgs->pQuery || pArgs->iStart > 0 || pArgs->iCount >= 0 )
+	{
+		sOptions.bDeep	   = true;
+		sOptions.iMaxDepth = 0;
+		sArgs.pOptions	   = &sOptions;
+		sArgs.pQuery	   = NULL;
+		sArgs.iSortFields  = 0;
+		sArgs.iStart	   = 0;
+		sArgs.iCount	   = -1;
+		sArgs.iNeedMask	   = PROP_M_NAME | PROP_M_PATH | PROP_M_DIRECTORY | PROP_M_SIZE;
+		pTree = getDirectory( pcFullPath, pcRootDir, &sArgs, NULL, &iResult );
+	}
+	memset( &sDirectory, 0, sizeof(FILE_INFO) );
+	sDirectory.directory = true;
+	sDirectory.pChildren = pTree;
+	if( (pList = newVector( 1 )) )
+	{
+		vectorAppend( &sDirectory, pList );
+		_aggregateList( pList, &sLinks, &lFiles, &lBytes );
+		destroyVector( &pList, NULL );
+		free( sLinks.pLinks );
+	}
+	pDirectory->lFiles	   = sDirectory.lFiles;
+	pDirectory->lBytes	   = sDirectory.lBytes;
+	pDirectory->iPropMask |= PROP_M_AGGREGATE;
 
-		if( listIsEmpty( pFileList ) )
+	if( pTree && pTree != pDirectory->pChildren )
+	{
+		if( pDirectory->pChildren )
 		{
-			*piResult = HTTP_V_NO_CONTENT;
+			_listDirectories( pTree, &ppDirs, &iCount, &iSize );
+			qsort( ppDirs, iCount, sizeof(FILE_INFO *), _pathCompare );
+			_copyTotals( pDirectory->pChildren, ppDirs, iCount );
+			free( ppDirs );
 		}
-		findEnd_NP( &OSArg );		
+		destroyFileList( &pTree );
 	}
-	return pFileList;
 }
 
 /**
@@ -327,13 +1260,13 @@ LIST *getDirectory( char *pcFullPath, char *pcRootDir, ARGS *pArgs, int *piResul
 *	@param	piResult		Address integer receiving the final result code:
 *							HTTP_V_OK, HTTP_V_NOT_FOUND or HTTP_V_NO_CONTENT
 *
-*	@return		Address LIST struct or NULL in case no match was found.
+*	@return		Address VECTOR struct or NULL in case no match was found.
 **/
-LIST *getFile( char *pcFullPath, char *pcRootDir, ARGS *pArgs, int *piResult )
+VECTOR *getFile( char *pcFullPath, char *pcRootDir, ARGS *pArgs, int *piResult )
 {
 	FILE_INFO	*pFileInfo;
 	OS_ARG		OSArg;
-	LIST		*pFileList = NULL;
+	VECTOR		*pFileList = NULL;
 	
 	if( (pFileInfo = findFile_NP( pcFullPath, pcRootDir, &OSArg, pArgs, piResult )) )
 	{
@@ -341,18 +1274,20 @@ LIST *getFile( char *pcFullPath, char *pcRootDir, ARGS *pArgs, int *piResult )
 		{
 			if( pFileInfo->directory )
 			{
-				pFileInfo->pChildren  = getDirectory( pcFullPath, pcRootDir, pArgs, piResult );
+				pFileInfo->pChildren  = getDirectory( pcFullPath, pcRootDir, pArgs, &pFileInfo->iTotal, piResult );
 				pFileInfo->iPropMask |= PROP_M_CHILDREN;
+				if( pArgs->pOptions->bAggregate )
+				{
+					_aggregateDirectory( pFileInfo, pcFullPath, pcRootDir, pArgs );
+				}
 			}
 			// Don't give away any part of the root directory.
 			if( !strcmp( pcFullPath, pcRootDir)) {
-				free( pFileInfo->pcName );
-				free( pFileInfo->pcPath );
-				pFileInfo->pcName = mstrcpy(".");
-				pFileInfo->pcPath = mstrcpy(".");
+				strcpy( pFileInfo->pcName, "." );
+				pFileInfo->pcDir = "";
 			}
-			pFileList = newList();
-			insertTail( pFileInfo, pFileList );
+			pFileList = newVector( 1 );
+			vectorAppend( pFileInfo, pFileList );
 			*piResult = HTTP_V_OK;
 		}
 		else // File was excluded
@@ -365,6 +1300,24 @@ LIST *getFile( char *pcFullPath, char *pcRootDir, ARGS *pArgs, int *piResult )
 	return pFileList;
 }
 
+/**
+*	getFilePath
+*
+*		Compose the relative path of a file from the path of its parent directory
+*		and the filename.
+*
+*	@param	pFileInfo		Address FILE_INFO struct.
+*	@param	pcPath			Address character buffer receiving the relative path.
+*	@param	iSize			Size of the character buffer.
+*
+*	@return		Address C-string containing the relative path (pcPath).
+**/
+char *getFilePath( FILE_INFO *pFileInfo, char *pcPath, size_t iSize )
+{
+	snprintf( pcPath, iSize, "%s%s", pFileInfo->pcDir, pFileInfo->pcName );
+	return pcPath;
+}
+
 /**
 *	getPropertyId
 *
@@ -388,6 +1341,29 @@ int getPropertyId( const char *pcProperty )
 	return PROP_M_UNKNOWN;
 }
 
+/**
+*	getPropertyMask
+*
+*		Return the property mask (PROP_M_xxx) of a file property.
+*
+*	@param	pcProperty			Address C-string containing the property name.
+*
+*	@return		Integer property mask or PROP_M_UNKNOWN.
+**/
+int getPropertyMask( const char *pcProperty )
+{
+	int	i;
+
+	for( i=0; pcFileProp[i]; i++ )
+	{
+		if( !strcmp( pcProperty, pcFileProp[i] ) )
+		{
+			return iFileProp[i];
+		}
+	}
+	return PROP_M_UNKNOWN;
+}
+
 /**
 *	getRelativePath
 *
@@ -440,6 +1416,110 @@ char *getRelativePath( char *pcFullPath, char *pcRootDir, char *pcFilename, char
 	return strcpy( *ppcPath, cPath );
 }
 
+/**
+*	newFileInfo
+*
+*		Allocate a new FILE_INFO struct for the file pcName in directory pcDir. The
+*		filename is stored together with the FILE_INFO struct. If bShared is true
+*		the directory path is shared by all files in the directory, in which case
+*		pcDir must remain valid for the lifetime of the FILE_INFO struct, otherwise
+*		a copy of the directory path is stored with the struct as well.
+*
+*	@param	pcDir			Address C-string containing the relative directory path.
+*	@param	iDirLen			Length of the relative directory path.
+*	@param	pcName			Address C-string containing the filename.
+*	@param	iNameLen		Length of the filename.
+*	@param	bShared			True if pcDir is shared.
+*
+*	@return		On success, pointer to a FILE_INFO struct otherwise NULL
+**/
+FILE_INFO *newFileInfo( const char *pcDir, size_t iDirLen, const char *pcName, size_t iNameLen, bool bShared )
+{
+	FILE_INFO	*pFileInfo;
+	char		*pcData;
+
+	if( (pFileInfo = (FILE_INFO *)arenaAlloc( sizeof(FILE_INFO) + iNameLen + 1 + (bShared ? 0 : iDirLen + 1) )) )
+	{
+		memset( pFileInfo, 0, sizeof(FILE_INFO) );
+		pcData = (char *)(pFileInfo + 1);
+
+		pFileInfo->pcName = pcData;
+		memcpy( pcData, pcName, iNameLen );
+		pcData[iNameLen] = '\0';
+		if( !bShared )
+		{
+			pcData += iNameLen + 1;
+			memcpy( pcData, pcDir, iDirLen );
+			pcData[iDirLen] = '\0';
+			pcDir = pcData;
+		}
+		pFileInfo->pcDir = pcDir;
+	}
+	return pFileInfo;
+}
+
+/**
+*	queryMatch
+*
+*		Returns true if a file matches the query of the HTTP query string arguments.
+*		The file is described by its raw properties, this allows the query to be
+*		evaluated before a FILE_INFO struct is allocated. Only the properties tested
+*		by the query need to be valid.
+*
+*	@param	pQuery			Address QUERY struct or NULL.
+*	@param	pcName			Address C-string containing the filename.
+*	@param	directory		True if the file is a directory.
+*	@param	lSize			File size
+*	@param	lModified		Last modified (seconds since Jan 1, 1970)
+*
+*	@return		True if the file matches the query or there is no query, otherwise false.
+**/
+bool queryMatch( QUERY *pQuery, const char *pcName, bool directory, long lSize, long lModified )
+{
+	if( pQuery )
+	{
+		if( ((pQuery->iPropMask & PROP_M_DIRECTORY) && pQuery->bDirectory != directory) ||
+			((pQuery->iPropMask & PROP_M_SIZE) && (lSize < pQuery->llMinSize || lSize > pQuery->llMaxSize)) ||
+			((pQuery->iPropMask & PROP_M_MODIFIED) && 
+			 (lModified < pQuery->llMinModified || lModified > pQuery->llMaxModified)) )
+		{
+			return false;
+		}
+		return queryMatchName( pQuery, pcName );
+	}
+	return true;
+}
+
+/**
+*	queryMatchName
+*
+*		Returns true if a filename matches the name property of a query. The name
+*		is matched against either a wildcard pattern or a regular expression.
+*
+*	@param	pQuery			Address QUERY struct or NULL.
+*	@param	pcName			Address C-string containing the filename.
+*
+*	@return		True if the name matches or the query has no name property, otherwise
+*				false.
+**/
+bool queryMatchName( QUERY *pQuery, const char *pcName )
+{
+	if( pQuery && (pQuery->iPropMask & PROP_M_NAME) )
+	{
+		if( pQuery->pcName )
+		{
+			return strmatch( pQuery->pcName, pcName, pQuery->bIgnoreCase );
+		}
+#ifndef WIN32
+		if( pQuery->pvRegex )
+		{
+			return !regexec( (regex_t *)pQuery->pvRegex, pcName, 0, NULL, 0 );
+		}
+#endif	/* WIN32 */
+	}
+	return true;
+}
+
 /**
 *	removeFile
 *
@@ -453,11 +1533,12 @@ char *getRelativePath( char *pcFullPath, char *pcRootDir, char *pcFilename, char
 *							HTTP_V_OK, HTTP_V_NOT_FOUND, HTTP_V_UNAUTHORIZED or
 *							HTTP_V_SERVER_ERROR
 *
-*	@return		Address LIST struct containing all files deleted.
+*	@return		Address VECTOR struct containing all files deleted.
 **/
-LIST *removeFile( FILE_INFO *pFileInfo, char *pcRootDir, ARGS *pArgs, int *piResult )
+VECTOR *removeFile( FILE_INFO *pFileInfo, char *pcRootDir, ARGS *pArgs, int *piResult )
 {
-	LIST	*pFileList = newList();
+	VECTOR	*pFileList = newVector( 0 );
+	char	cFilePath[MAX_PATH_SIZE];
 
 	*piResult = HTTP_V_NO_CONTENT;
 
@@ -468,7 +1549,56 @@ LIST *removeFile( FILE_INFO *pFileInfo, char *pcRootDir, ARGS *pArgs, int *piRes
 
 	if( pFileInfo )
 	{
-		_removeFile( pFileList, pFileInfo, pcRootDir, pArgs, piResult );
+		snprintf( cFilePath, sizeof(cFilePath)-1, "%s/%s%s", pcRootDir, pFileInfo->pcDir, pFileInfo->pcName );
+		normalizePath( cFilePath );
+		if( _removeFile( pFileList, pFileInfo, pcRootDir, pArgs, piResult ) )
+		{
+			journalAppend( JOURNAL_V_DELETE, cFilePath, NULL );
+		}
+	}
+	return pFileList;
+}
+
+/**
+*	removePath
+*
+*		Delete the file or directory specified by parameter pcFullPath. Unlike a
+*		call to getFile() followed by removeFile() the content of a directory is
+*		not listed before it is deleted, the directory is returned without its
+*		children. The search options of pArgs are preserved.
+*
+*	@param	pcFullPath		Address C-string containing the full file path.
+*	@param	pcRootDir		Address C-string containing the root directory.
+*	@param	pArgs			Address arguments struct
+*	@param	piResult		Address integer receiving the final result code:
+*							HTTP_V_OK, HTTP_V_NO_CONTENT, HTTP_V_NOT_FOUND,
+*							HTTP_V_UNAUTHORIZED or HTTP_V_SERVER_ERROR
+*
+*	@return		Address VECTOR struct containing all files deleted or NULL in case
+*				no match was found.
+**/
+VECTOR *removePath( char *pcFullPath, char *pcRootDir, ARGS *pArgs, int *piResult )
+{
+	FILE_INFO	*pFileInfo;
+	OPTIONS		sOptions = *pArgs->pOptions;
+	VECTOR		*pFileList = NULL;
+
+	if( (pFileInfo = findFile_NP( pcFullPath, pcRootDir, NULL, pArgs, piResult )) )
+	{
+		if( !_fileFilter( pFileInfo, pArgs ) )
+		{
+			pFileList = removeFile( pFileInfo, pcRootDir, pArgs, piResult );
+			*pArgs->pOptions = sOptions;
+			if( *piResult != HTTP_V_OK )
+			{
+				_destroyFileInfo( pFileInfo );
+			}
+		}
+		else // File was excluded
+		{
+			_destroyFileInfo( pFileInfo );
+			*piResult = HTTP_V_NO_CONTENT;
+		}
 	}
 	return pFileList;
 }
@@ -484,12 +1614,12 @@ LIST *removeFile( FILE_INFO *pFileInfo, char *pcRootDir, ARGS *pArgs, int *piRes
 *	@param	piResult		Address integer receiving the final result code:
 *							HTTP_V_OK, HTTP_V_NOT_FOUND or HTTP_V_NO_CONTENT
 *
-*	@return		Address LIST struct or NULL in case no match was found.
+*	@return		Address VECTOR struct or NULL in case no match was found.
 **/
-LIST *renameFile( char *pcFullPath, char *pcRootDir, ARGS *pArgs, int *piResult )
+VECTOR *renameFile( char *pcFullPath, char *pcRootDir, ARGS *pArgs, int *piResult )
 {
 	FILE_INFO	*pFileInfo;
-	LIST		*pFileList = NULL;
+	VECTOR		*pFileList = NULL;
 	OS_ARG		OSArg;
 	char		cNewPath[MAX_PATH_SIZE],
 				cRelPath[MAX_PATH_SIZE];
@@ -497,7 +1627,7 @@ LIST *renameFile( char *pcFullPath, char *pcRootDir, ARGS *pArgs, int *piResult
 	if( (pFileInfo = findFile_NP( pcFullPath, pcRootDir, &OSArg, pArgs, piResult )) )
 	{
 		// Save the current relative file path.
-		strcpy( cRelPath, pFileInfo->pcPath );
+		getFilePath( pFileInfo, cRelPath, sizeof(cRelPath) );
 		_destroyFileInfo( pFileInfo );
 
 		snprintf( cNewPath, sizeof(cNewPath)-1, "%s/%s", pcRootDir, pArgs->pcNewValue );
@@ -531,13 +1661,14 @@ LIST *renameFile( char *pcFullPath, char *pcRootDir, ARGS *pArgs, int *piResult
 			}
 			else
 			{
+				journalAppend( JOURNAL_V_RENAME, pcFullPath, cNewPath );
 				if( (pFileInfo = findFile_NP( cNewPath, pcRootDir, NULL, pArgs, piResult )) )
 				{
-					pFileInfo->pcOldPath  = mstrcpy( cRelPath );
+					pFileInfo->pcOldPath  = astrcpy( cRelPath );
 					pFileInfo->iPropMask |= PROP_M_OLDPATH;
 
-					pFileList = newList();
-					insertTail( pFileInfo, pFileList );
+					pFileList = newVector( 1 );
+					vectorAppend( pFileInfo, pFileList );
 				}
 			}
 		}
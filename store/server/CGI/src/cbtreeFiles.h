@@ -2,7 +2,7 @@
 #define _CBTREE_FILES_H_
 
 #include "cbtreeArgs.h"
-#include "cbtreeList.h"
+#include "cbtreeVector.h"
 
 // Define symbolic file properties
 #define PROP_M_UNKNOWN		0X00
@@ -13,35 +13,54 @@
 #define PROP_M_MODIFIED		0x10
 #define PROP_M_CHILDREN		0X20
 #define PROP_M_OLDPATH		0X40
+#define PROP_M_DELETED		0X80
+#define PROP_M_AGGREGATE	0X100
 
-#define PROP_M_DEFAULT		PROP_M_NAME | PROP_M_PATH | PROP_M_SIZE | PROP_M_MODIFIED
+#define PROP_M_DEFAULT		(PROP_M_NAME | PROP_M_PATH | PROP_M_SIZE | PROP_M_MODIFIED)
+#define PROP_M_FIELDS		(PROP_M_DEFAULT | PROP_M_DIRECTORY)		// Properties selectable by 'fields'
 
 typedef struct fileInfo {
 	int		iPropMask;			// Properties mask (indicates which of the following properties are set).
 	char	*pcName;			// Pointer to C-string containing the filename
-	char	*pcPath;
+	const char	*pcDir;			// Pointer to C-string containing the relative path of the parent
+								// directory ("./dir/"), the file path is pcDir followed by pcName.
 	char	*pcOldPath;			// Pointer to C-string containing the old path (rename only).
 	long	lSize;				// File size
 	long	lModified;			// Last modified (seconds since Jan 1, 1970)
 	bool	directory;			// True if file is a directory
 	bool	bIsHidden;			// True if file is marked as hidden.
-	LIST	*pChildren;			// List of children (directory only).
+	bool	bIsLink;			// True if file is a symbolic link, directory is the link target type.
+	VECTOR	*pChildren;			// Children (directory only).
+	int		iDepth;				// Directory level relative to the search path (deep search only).
+	int		iTotal;				// Total number of children, including those not returned.
+	unsigned long	lDevice;	// Device of the file (iLinks > 0 only)
+	unsigned long	lInode;		// Inode of the file (iLinks > 0 only)
+	int		iLinks;				// Number of hard links (0 = unknown)
+	long	lFiles;				// Number of files in the subtree (directory, aggregate only)
+	long	lBytes;				// Total size of the files in the subtree (directory, aggregate only)
 } FILE_INFO;
 
 #ifdef __cplusplus
 	extern "C" {
 #endif
 
-void  destroyFileList( LIST **ppList );
-int	  fileCount( LIST *pFileList, bool iDeep );
-int   getPropertyId( const char *pcProperty );
-LIST *getDirectory( char *pcFullPath, char *pcRootDir, ARGS *pArgs, int *piResult );
-LIST *getFile( char *pcFullPath, char *pcRootDir, ARGS *pArgs, int *piResult );
+void       destroyFileList( VECTOR **ppFileList );
+VECTOR    *getChanges( char *pcFullPath, char *pcRootDir, ARGS *pArgs, long lEnd, int *piResult );
+int        getPropertyId( const char *pcProperty );
+int        getPropertyMask( const char *pcProperty );
+VECTOR    *getDirectory( char *pcFullPath, char *pcRootDir, ARGS *pArgs, int *piTotal, int *piResult );
+VECTOR    *getFile( char *pcFullPath, char *pcRootDir, ARGS *pArgs, int *piResult );
+char      *getFilePath( FILE_INFO *pFileInfo, char *pcPath, size_t iSize );
 
-char *getRelativePath( char *pcFullPath, char *pcRootDir, char *pcFilename, char **ppcPath );
+char      *getRelativePath( char *pcFullPath, char *pcRootDir, char *pcFilename, char **ppcPath );
+FILE_INFO *newFileInfo( const char *pcDir, size_t iDirLen, const char *pcName, size_t iNameLen, bool bShared );
 
-LIST *removeFile( FILE_INFO *pFileInfo, char *pcRootDir, ARGS *pArgs, int *piResult );
-LIST *renameFile( char *pcFullPath, char *pcRootDir, ARGS *pArgs, int *piResult );
+bool       queryMatch( QUERY *pQuery, const char *pcName, bool directory, long lSize, long lModified );
+bool       queryMatchName( QUERY *pQuery, const char *pcName );
+
+VECTOR    *removeFile( FILE_INFO *pFileInfo, char *pcRootDir, ARGS *pArgs, int *piResult );
+VECTOR    *removePath( char *pcFullPath, char *pcRootDir, ARGS *pArgs, int *piResult );
+VECTOR    *renameFile( char *pcFullPath, char *pcRootDir, ARGS *pArgs, int *piResult );
 
 #ifdef __cplusplus
 	}
@@ -0,0 +1,673 @@
+/****************************************************************************************
+*	Copyright (c) 2012, Peter Jekel
+*	All rights reserved.
+*
+*	The Checkbox Tree File Store CGI (cbtreeFileStore) is released under to following
+*	license:
+*
+*	    BSD 2-Clause		(http://thejekels.com/cbtree/LICENSE)
+*
+*	@author		Peter Jekel
+*
+****************************************************************************************
+*
+*	Description:
+*
+*		This module creates and reads file tree snapshots. A snapshot is a compact,
+*		read-only image of a file tree which is memory mapped by the CGI application
+*		and used as is, that is, without any parsing. Snapshots are intended for
+*		archival file trees that rarely change, the snapshot must be rebuilt after
+*		the file tree changed.
+*
+*		A snapshot file is made up of a header, the root directory path, a table of
+*		fixed size nodes and a name pool. Node 0 is the root directory, all children
+*		of a directory are stored as consecutive nodes sorted by name (strcmp order)
+*		therefore a file is located using a binary search per directory level.
+*
+*		The names of the children of a directory are front coded, each name record
+*		holds the number of leading bytes shared with the previous name followed by
+*		the length and the bytes of the remaining suffix. Every INDEX_V_RESTART-th
+*		record is a restart point which stores the full name. Both numbers are
+*		stored as unsigned LEB128 values:
+*
+*			name-record ::= shared suffix-length suffix-byte*
+*
+*		All numbers in the header and node table are stored in the native byte
+*		order, a snapshot can only be used on the architecture that created it.
+*
+*	NOTE:	Snapshots are not supported on Microsoft Windows.
+*
+****************************************************************************************/
+#ifdef _MSC_VER
+	#define _CRT_SECURE_NO_WARNINGS
+#endif	/* _MSC_VER */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifndef WIN32
+  #include <errno.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+#endif /* WIN32 */
+
+#include "cbtreeDebug.h"
+#include "cbtreeFiles.h"
+#include "cbtreeIndex.h"
+#include "cbtreeString.h"
+#include "cbtreeThreads.h"
+#include "cbtreeURI.h"
+
+#ifndef WIN32
+static const INDEX_HEADER	*pIndexHeader = NULL;	// Memory mapped snapshot
+static const INDEX_NODE		*pIndexNodes  = NULL;
+static const uint8_t		*pcIndexNames = NULL;
+static const uint8_t		*pcIndexEnd   = NULL;	// End of the name pool
+static char					cIndexRoot[MAX_PATH_SIZE];
+static size_t				iIndexRootLen = 0;
+
+/**
+*	_indexVarint
+*
+*		Decode an unsigned LEB128 value.
+*
+*	@param	pcData			Address of the encoded value.
+*	@param	piValue			Address size_t receiving the decoded value.
+*
+*	@return		Address of the first byte after the value or NULL if the value
+*				is malformed or exceeds the name pool.
+**/
+static const uint8_t *_indexVarint( const uint8_t *pcData, size_t *piValue )
+{
+	size_t	iValue = 0;
+	int		iShift;
+
+	for( iShift = 0; pcData < pcIndexEnd && iShift < 32; iShift += 7 )
+	{
+		iValue |= (size_t)(*pcData & 0x7F) << iShift;
+		if( !(*pcData++ & 0x80) )
+		{
+			*piValue = iValue;
+			return pcData;
+		}
+	}
+	return NULL;
+}
+
+/**
+*	_indexDecode
+*
+*		Decode a name record. The shared prefix of the name is taken from the name
+*		currently stored in pcName, the suffix of the record is appended.
+*
+*	@param	pcRecord		Address of the name record.
+*	@param	pcName			Address character buffer of size MAX_PATH_SIZE holding
+*							the previous name and receiving the new name.
+*
+*	@return		Address of the next name record or NULL if the record is invalid.
+**/
+static const uint8_t *_indexDecode( const uint8_t *pcRecord, char *pcName )
+{
+	size_t	iShared,
+			iLen;
+
+	if( !pcRecord || !(pcRecord = _indexVarint( pcRecord, &iShared )) ||
+		!(pcRecord = _indexVarint( pcRecord, &iLen )) ||
+		iShared + iLen >= MAX_PATH_SIZE || iLen > (size_t)(pcIndexEnd - pcRecord) )
+	{
+		return NULL;
+	}
+	memcpy( &pcName[iShared], pcRecord, iLen );
+	pcName[iShared + iLen] = '\0';
+	return pcRecord + iLen;
+}
+
+/**
+*	_indexCompare
+*
+*		Compare a path segment with a filename (strcmp order).
+*
+*	@param	pcSegm			Address of the path segment (not zero terminated).
+*	@param	iLen			Length of the path segment.
+*	@param	pcName			Address C-string containing the filename.
+*
+*	@return		An integer less than, equal to or greater than zero.
+**/
+static int _indexCompare( const char *pcSegm, size_t iLen, const char *pcName )
+{
+	int		iResult;
+
+	if( (iResult = strncmp( pcSegm, pcName, iLen )) )
+	{
+		return iResult;
+	}
+	return pcName[iLen] ? -1 : 0;
+}
+
+/**
+*	_indexChild
+*
+*		Locate the child of a directory node by name. The restart points of the
+*		directory are searched using a binary search, the remaining records are
+*		searched sequentially.
+*
+*	@param	pDir			Address INDEX_NODE struct of the directory.
+*	@param	pcSegm			Address of the filename (not zero terminated).
+*	@param	iLen			Length of the filename.
+*
+*	@return		Address INDEX_NODE struct or NULL if there is no such child.
+**/
+static const INDEX_NODE *_indexChild( const INDEX_NODE *pDir, const char *pcSegm, size_t iLen )
+{
+	const uint8_t	*pcRecord;
+	uint32_t	iLow  = 0,
+				iHigh,
+				iMid,
+				i;
+	char		cName[MAX_PATH_SIZE];
+	int			iResult;
+
+	if( !pDir->iCount || pDir->iFirst > pIndexHeader->iNodes - pDir->iCount )
+	{
+		return NULL;
+	}
+	// Find the last restart point not greater than the segment.
+	iHigh = (pDir->iCount - 1) / INDEX_V_RESTART;
+	while( iLow < iHigh )
+	{
+		iMid = (iLow + iHigh + 1) / 2;
+		if( !_indexDecode( &pcIndexNames[pIndexNodes[pDir->iFirst + iMid * INDEX_V_RESTART].iName], cName ) )
+		{
+			return NULL;
+		}
+		if( _indexCompare( pcSegm, iLen, cName ) < 0 )
+		{
+			iHigh = iMid - 1;
+		}
+		else
+		{
+			iLow = iMid;
+		}
+	}
+	i		 = iLow * INDEX_V_RESTART;
+	pcRecord = &pcIndexNames[pIndexNodes[pDir->iFirst + i].iName];
+	for( ; i < pDir->iCount && i < (iLow + 1) * INDEX_V_RESTART; i++ )
+	{
+		if( !(pcRecord = _indexDecode( pcRecord, cName )) ||
+			(iResult = _indexCompare( pcSegm, iLen, cName )) < 0 )
+		{
+			break;
+		}
+		if( !iResult )
+		{
+			return &pIndexNodes[pDir->iFirst + i];
+		}
+	}
+	return NULL;
+}
+
+/**
+*	_indexVarintPut
+*
+*		Encode an unsigned LEB128 value.
+*
+*	@param	pcData			Address of the output buffer (at least 5 bytes).
+*	@param	iValue			Value to encode.
+*
+*	@return		Number of bytes written.
+**/
+static size_t _indexVarintPut( uint8_t *pcData, size_t iValue )
+{
+	size_t	iLen = 0;
+
+	do {
+		pcData[iLen++] = (uint8_t)((iValue & 0x7F) | (iValue > 0x7F ? 0x80 : 0));
+		iValue >>= 7;
+	} while( iValue );
+	return iLen;
+}
+
+/**
+*	_indexLayout
+*
+*		Lay out the snapshot nodes and name pool of a file tree. The nodes are laid
+*		out breadth first so the children of each directory are consecutive nodes.
+*		On return the caller must release the node table and name pool.
+*
+*	@param	pFileList		Address VECTOR struct of the root directory children.
+*	@param	pStat			Address stat struct of the root directory.
+*	@param	ppNodes			Address receiving the node table.
+*	@param	piNodes			Address receiving the number of nodes.
+*	@param	ppcNames		Address receiving the name pool.
+*	@param	piNameLen		Address receiving the length of the name pool.
+*
+*	@return		True if successful otherwise false.
+**/
+static bool _indexLayout( VECTOR *pFileList, struct stat *pStat, INDEX_NODE **ppNodes, uint32_t *piNodes,
+						  uint8_t **ppcNames, size_t *piNameLen )
+{
+	FILE_INFO	*pFileInfo;
+	INDEX_NODE	*pNode;
+	VECTOR		**ppLists;
+	void		*pvNew;
+	char		cPrev[MAX_PATH_SIZE] = "";
+	size_t		iNameSize = 65536,
+				iShared,
+				iLen;
+	uint32_t	iSize = 1024,
+				iChild,
+				i;
+	bool		bSuccess = true;
+
+	*piNodes   = 1;
+	*piNameLen = 0;
+	*ppNodes   = (INDEX_NODE *)calloc( iSize, sizeof(INDEX_NODE) );
+	*ppcNames  = (uint8_t *)malloc( iNameSize );
+	// ppLists holds, per node, the directory children still to be added.
+	if( !(ppLists = (VECTOR **)calloc( iSize, sizeof(VECTOR *) )) || !*ppNodes || !*ppcNames )
+	{
+		free( ppLists );
+		return false;
+	}
+	(*ppNodes)[0].iFlags	= INDEX_M_DIRECTORY;
+	(*ppNodes)[0].lSize		= (int64_t)pStat->st_size;
+	(*ppNodes)[0].lModified = (int64_t)pStat->st_mtime;
+	(*ppcNames)[(*piNameLen)++] = 0;	// Root: no shared prefix, empty name.
+	(*ppcNames)[(*piNameLen)++] = 0;
+	ppLists[0] = pFileList;
+
+	for( i = 0; i < *piNodes && bSuccess; i++ )
+	{
+		if( !ppLists[i] )
+		{
+			continue;
+		}
+		(*ppNodes)[i].iFirst  = *piNodes;
+		(*ppNodes)[i].iFlags |= INDEX_M_LISTED;
+		for( iChild = 0; iChild < (uint32_t)ppLists[i]->iCount && bSuccess; iChild++ )
+		{
+			pFileInfo = (FILE_INFO *)ppLists[i]->ppvData[iChild];
+			iLen	  = strlen( pFileInfo->pcName );
+			if( *piNodes == iSize )
+			{
+				if( iSize > UINT32_MAX / 2 || !(pvNew = realloc( *ppNodes, 2 * iSize * sizeof(INDEX_NODE) )) )
+				{
+					bSuccess = false;
+					break;
+				}
+				*ppNodes = (INDEX_NODE *)pvNew;
+				if( !(pvNew = realloc( ppLists, 2 * iSize * sizeof(VECTOR *) )) )
+				{
+					bSuccess = false;
+					break;
+				}
+				ppLists = (VECTOR **)pvNew;
+				iSize  *= 2;
+			}
+			if( *piNameLen + iLen + 10 > iNameSize )
+			{
+				iNameSize = 2 * iNameSize + iLen + 10;
+				if( iNameSize > UINT32_MAX || !(pvNew = realloc( *ppcNames, iNameSize )) )
+				{
+					bSuccess = false;
+					break;
+				}
+				*ppcNames = (uint8_t *)pvNew;
+			}
+			// Front code the name, every INDEX_V_RESTART-th name is stored in full.
+			iShared = 0;
+			if( iChild % INDEX_V_RESTART )
+			{
+				while( cPrev[iShared] && cPrev[iShared] == pFileInfo->pcName[iShared] )
+				{
+					iShared++;
+				}
+			}
+			pNode = &(*ppNodes)[*piNodes];
+			memset( pNode, 0, sizeof(INDEX_NODE) );
+			pNode->iName	 = (uint32_t)*piNameLen;
+			pNode->iFlags	 = pFileInfo->directory ? INDEX_M_DIRECTORY : 0;
+			pNode->lSize	 = pFileInfo->lSize;
+			pNode->lModified = pFileInfo->lModified;
+
+			*piNameLen += _indexVarintPut( &(*ppcNames)[*piNameLen], iShared );
+			*piNameLen += _indexVarintPut( &(*ppcNames)[*piNameLen], iLen - iShared );
+			memcpy( &(*ppcNames)[*piNameLen], &pFileInfo->pcName[iShared], iLen - iShared );
+			*piNameLen += iLen - iShared;
+			strncpyz( cPrev, pFileInfo->pcName, sizeof(cPrev)-1 );
+
+			ppLists[(*piNodes)++] = (pFileInfo->directory && pFileInfo->pChildren) ? pFileInfo->pChildren : NULL;
+		}
+		(*ppNodes)[i].iCount = iChild;
+	}
+	free( ppLists );
+	return bSuccess;
+}
+
+/**
+*	_indexWrite
+*
+*		Write a snapshot file. The snapshot is first written to a temporary file
+*		which then replaces pcIndexFile, any process still using the previous
+*		snapshot is not affected.
+*
+*	@param	pcIndexFile		Address C-string containing the snapshot file name.
+*	@param	pHeader			Address INDEX_HEADER struct.
+*	@param	pcRootDir		Address C-string containing the root directory.
+*	@param	pNodes			Address of the node table.
+*	@param	pcNames			Address of the name pool.
+*	@param	iNameLen		Length of the name pool.
+*
+*	@return		True if successful otherwise false.
+**/
+static bool _indexWrite( const char *pcIndexFile, INDEX_HEADER *pHeader, const char *pcRootDir,
+						 INDEX_NODE *pNodes, uint8_t *pcNames, size_t iNameLen )
+{
+	FILE	*pFile;
+	char	cTempFile[MAX_PATH_SIZE + 8];
+	bool	bSuccess = false;
+	int		iFd;
+
+	snprintf( cTempFile, sizeof(cTempFile), "%s.XXXXXX", pcIndexFile );
+	if( (iFd = mkstemp( cTempFile )) == -1 )
+	{
+		return false;
+	}
+	if( (pFile = fdopen( iFd, "wb" )) )
+	{
+		fchmod( iFd, 0644 );
+		bSuccess = fwrite( pHeader, sizeof(INDEX_HEADER), 1, pFile ) == 1 &&
+				   fwrite( pcRootDir, pHeader->iRootLen + 1, 1, pFile ) == 1 &&
+				   !fseek( pFile, pHeader->iNodeOffset, SEEK_SET ) &&
+				   fwrite( pNodes, sizeof(INDEX_NODE), pHeader->iNodes, pFile ) == pHeader->iNodes &&
+				   fwrite( pcNames, 1, iNameLen, pFile ) == iNameLen;
+		bSuccess = !fclose( pFile ) && bSuccess;
+	}
+	else
+	{
+		close( iFd );
+	}
+	if( !bSuccess || rename( cTempFile, pcIndexFile ) )
+	{
+		unlink( cTempFile );
+		return false;
+	}
+	return true;
+}
+#endif /* WIN32 */
+
+/**
+*	indexBuild
+*
+*		Create a snapshot of the file tree rooted at pcRootDir. The file tree is
+*		loaded using a deep directory search, including hidden files, with the
+*		children of each directory sorted by name. The directories are loaded by
+*		a pool of CBTREE_THREADS worker threads.
+*
+*	@param	pcRootDir		Address C-string containing the root directory.
+*	@param	pcIndexFile		Address C-string containing the snapshot file name.
+*
+*	@return		Process exit code.
+**/
+int indexBuild( const char *pcRootDir, const char *pcIndexFile )
+{
+#ifndef WIN32
+	INDEX_HEADER	sHeader;
+	INDEX_NODE		*pNodes  = NULL;
+	OPTIONS			sOptions;
+	struct stat		sStat;
+	ARGS			sArgs;
+	VECTOR			*pFileList;
+	uint8_t			*pcNames = NULL;
+	char			cRootDir[MAX_PATH_SIZE],
+					*pcThreads = getenv( "CBTREE_THREADS" );
+	size_t			iNameLen;
+	uint32_t		iNodes;
+	int				iResult;
+	bool			bSuccess;
+
+	snprintf( cRootDir, sizeof(cRootDir)-1, "%s", pcRootDir );
+	strtrim( normalizePath( cRootDir ), (TRIM_M_WSP | TRIM_M_SLASH) );
+	if( stat( cRootDir, &sStat ) || !S_ISDIR( sStat.st_mode ) )
+	{
+		fprintf( stderr, "cbtreeFileStore: [%s] is not a directory.\n", cRootDir );
+		return 1;
+	}
+
+	memset( &sOptions, 0, sizeof(sOptions) );
+	memset( &sArgs, 0, sizeof(sArgs) );
+	sOptions.bDeep			  = true;
+	sOptions.bShowHiddenFiles = true;
+	sArgs.pOptions	  = &sOptions;
+	sArgs.iPropMask	  = PROP_M_FIELDS;
+	sArgs.iNeedMask	  = PROP_M_FIELDS;
+	sArgs.iThreads	  = pcThreads ? atoi( pcThreads ) : 1;
+	sArgs.iThreads	  = sArgs.iThreads < 1 ? 1 : (sArgs.iThreads > MAX_THREADS ? MAX_THREADS : sArgs.iThreads);
+	sArgs.iCount	  = -1;
+	sArgs.iSortFields = 1;
+	sArgs.sSortFields[0].iProperty = PROP_M_NAME;
+
+	if( !(pFileList = getDirectory( cRootDir, cRootDir, &sArgs, NULL, &iResult )) )
+	{
+		fprintf( stderr, "cbtreeFileStore: unable to read [%s].\n", cRootDir );
+		return 1;
+	}
+	if( (bSuccess = _indexLayout( pFileList, &sStat, &pNodes, &iNodes, &pcNames, &iNameLen )) )
+	{
+		memset( &sHeader, 0, sizeof(sHeader) );
+		memcpy( sHeader.cMagic, INDEX_C_MAGIC, sizeof(sHeader.cMagic) );
+		sHeader.iByteOrder	= INDEX_V_BYTE_ORDER;
+		sHeader.iNodes		= iNodes;
+		sHeader.iRootLen	= (uint32_t)strlen( cRootDir );
+		sHeader.iNodeOffset	= (uint32_t)((sizeof(sHeader) + sHeader.iRootLen + 1 + 7) & ~(size_t)7);
+		sHeader.iNameOffset	= sHeader.iNodeOffset + (uint64_t)iNodes * sizeof(INDEX_NODE);
+		sHeader.iFileSize	= sHeader.iNameOffset + iNameLen;
+		sHeader.lCreated	= (int64_t)time(NULL);
+
+		bSuccess = _indexWrite( pcIndexFile, &sHeader, cRootDir, pNodes, pcNames, iNameLen );
+	}
+	if( bSuccess )
+	{
+		printf( "root:    %s\n", cRootDir );
+		printf( "entries: %lu\n", (unsigned long)iNodes );
+		printf( "bytes:   %lu\n", (unsigned long)sHeader.iFileSize );
+	}
+	else
+	{
+		fprintf( stderr, "cbtreeFileStore: unable to write [%s].\n", pcIndexFile );
+	}
+	free( pNodes );
+	free( pcNames );
+	destroyFileList( &pFileList );
+	return bSuccess ? 0 : 1;
+#else
+	(void)pcRootDir;
+	(void)pcIndexFile;
+	fprintf( stderr, "cbtreeFileStore: snapshots are not supported.\n" );
+	return 1;
+#endif /* WIN32 */
+}
+
+/**
+*	indexCreated
+*
+*		Returns the time the snapshot in use was created.
+*
+*	@return		Snapshot time (seconds since Jan 1, 1970) or -1 if no snapshot is used.
+**/
+int64_t indexCreated( void )
+{
+#ifndef WIN32
+	return pIndexHeader ? pIndexHeader->lCreated : -1;
+#else
+	return -1;
+#endif /* WIN32 */
+}
+
+/**
+*	indexEnabled
+*
+*		Returns true if a snapshot is in use.
+*
+*	@return		True or false.
+**/
+bool indexEnabled( void )
+{
+#ifndef WIN32
+	return (pIndexHeader != NULL);
+#else
+	return false;
+#endif /* WIN32 */
+}
+
+/**
+*	indexFirst
+*
+*		Start iterating the children of a directory node.
+*
+*	@param	pIter			Address INDEX_ITER struct.
+*	@param	pDir			Address INDEX_NODE struct of the directory.
+**/
+void indexFirst( INDEX_ITER *pIter, const INDEX_NODE *pDir )
+{
+	pIter->pDir		= pDir;
+	pIter->iNext	= 0;
+	pIter->pcRecord	= NULL;
+	pIter->cName[0]	= '\0';
+#ifndef WIN32
+	if( pDir->iCount && pDir->iFirst <= pIndexHeader->iNodes - pDir->iCount )
+	{
+		pIter->pcRecord = &pcIndexNames[pIndexNodes[pDir->iFirst].iName];
+	}
+#endif /* WIN32 */
+}
+
+/**
+*	indexLookup
+*
+*		Returns the snapshot node of a file. The full path must be located in the
+*		file tree of the snapshot.
+*
+*	@param	pcFullPath		Address C-string containing the full path.
+*
+*	@return		Address INDEX_NODE struct or NULL if the file is not part of the
+*				snapshot.
+**/
+const INDEX_NODE *indexLookup( const char *pcFullPath )
+{
+#ifndef WIN32
+	const INDEX_NODE	*pNode = pIndexNodes;
+	const char			*pcSegm = &pcFullPath[iIndexRootLen];
+	size_t				iLen;
+
+	if( !pNode || strncmp( pcFullPath, cIndexRoot, iIndexRootLen ) || (*pcSegm && *pcSegm != '/') )
+	{
+		return NULL;
+	}
+	while( *pcSegm )
+	{
+		pcSegm += strspn( pcSegm, "/" );
+		if( !(iLen = strcspn( pcSegm, "/" )) )
+		{
+			break;
+		}
+		if( !(pNode->iFlags & INDEX_M_LISTED) ||
+			!(pNode = _indexChild( pNode, pcSegm, iLen )) )
+		{
+			return NULL;
+		}
+		pcSegm += iLen;
+	}
+	return pNode;
+#else
+	(void)pcFullPath;
+	return NULL;
+#endif /* WIN32 */
+}
+
+/**
+*	indexNext
+*
+*		Returns the next child of the directory being iterated, the name of the
+*		child is available as pIter->cName.
+*
+*	@param	pIter			Address INDEX_ITER struct.
+*
+*	@return		Address INDEX_NODE struct or NULL if there are no more children.
+**/
+const INDEX_NODE *indexNext( INDEX_ITER *pIter )
+{
+#ifndef WIN32
+	if( pIter->pcRecord && pIter->iNext < pIter->pDir->iCount &&
+		(pIter->pcRecord = _indexDecode( pIter->pcRecord, pIter->cName )) )
+	{
+		return &pIndexNodes[pIter->pDir->iFirst + pIter->iNext++];
+	}
+#endif /* WIN32 */
+	return NULL;
+}
+
+/**
+*	indexOpen
+*
+*		Map a snapshot file into memory. The snapshot is used for all subsequent
+*		file searches within its file tree.
+*
+*	@param	pcIndexFile		Address C-string containing the snapshot file name.
+*
+*	@return		True if successful otherwise false.
+**/
+bool indexOpen( const char *pcIndexFile )
+{
+#ifndef WIN32
+	const INDEX_HEADER	*pHeader;
+	struct stat	sStat;
+	void		*pvMap;
+	int			iFd;
+
+	if( pIndexHeader || !pcIndexFile || !*pcIndexFile )
+	{
+		return (pIndexHeader != NULL);
+	}
+	if( (iFd = open( pcIndexFile, O_RDONLY | O_CLOEXEC )) == -1 )
+	{
+		cbtDebug( "Snapshot [%s] is not available.", pcIndexFile );
+		return false;
+	}
+	if( fstat( iFd, &sStat ) || (size_t)sStat.st_size < sizeof(INDEX_HEADER) ||
+		(pvMap = mmap( NULL, sStat.st_size, PROT_READ, MAP_SHARED, iFd, 0 )) == MAP_FAILED )
+	{
+		close( iFd );
+		return false;
+	}
+	close( iFd );
+
+	pHeader = (const INDEX_HEADER *)pvMap;
+	if( memcmp( pHeader->cMagic, INDEX_C_MAGIC, sizeof(pHeader->cMagic) ) ||
+		pHeader->iByteOrder != INDEX_V_BYTE_ORDER || pHeader->iFileSize != (uint64_t)sStat.st_size ||
+		!pHeader->iNodes || pHeader->iRootLen >= sizeof(cIndexRoot) ||
+		pHeader->iNodeOffset < sizeof(INDEX_HEADER) + pHeader->iRootLen + 1 ||
+		pHeader->iNameOffset != pHeader->iNodeOffset + (uint64_t)pHeader->iNodes * sizeof(INDEX_NODE) ||
+		pHeader->iNameOffset > pHeader->iFileSize )
+	{
+		cbtDebug( "Snapshot [%s] is invalid.", pcIndexFile );
+		munmap( pvMap, sStat.st_size );
+		return false;
+	}
+	memcpy( cIndexRoot, (const char *)pvMap + sizeof(INDEX_HEADER), pHeader->iRootLen );
+	cIndexRoot[pHeader->iRootLen] = '\0';
+	iIndexRootLen = pHeader->iRootLen;
+
+	pIndexNodes  = (const INDEX_NODE *)((const char *)pvMap + pHeader->iNodeOffset);
+	pcIndexNames = (const uint8_t *)pvMap + pHeader->iNameOffset;
+	pcIndexEnd	 = (const uint8_t *)pvMap + pHeader->iFileSize;
+	pIndexHeader = pHeader;
+	return true;
+#else
+	(void)pcIndexFile;
+	return false;
+#endif /* WIN32 */
+}
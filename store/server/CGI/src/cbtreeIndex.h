@@ -0,0 +1,63 @@
+#ifndef _CBTREE_INDEX_H_
+#define _CBTREE_INDEX_H_
+
+#include <stdint.h>
+
+#include "cbtreeCommon.h"
+
+#define INDEX_C_MAGIC		"CBTIDX01"	// Snapshot file signature and version.
+#define INDEX_V_BYTE_ORDER	0x01020304	// Byte order marker.
+#define INDEX_V_RESTART		16			// Front coding restart interval.
+
+#define INDEX_M_DIRECTORY	0x01		// Entry is a directory.
+#define INDEX_M_LISTED		0x02		// Directory content is part of the snapshot.
+
+// Snapshot file header. The header is followed by the root directory path, the
+// node table and the name pool.
+typedef struct indexHeader {
+	char		cMagic[8];				// INDEX_C_MAGIC
+	uint32_t	iByteOrder;				// INDEX_V_BYTE_ORDER
+	uint32_t	iNodes;					// Number of nodes
+	uint32_t	iRootLen;				// Length of the root directory path
+	uint32_t	iNodeOffset;			// File offset of the node table
+	uint64_t	iNameOffset;			// File offset of the name pool
+	uint64_t	iFileSize;				// Total file size
+	int64_t		lCreated;				// Snapshot time (seconds since Jan 1, 1970)
+} INDEX_HEADER;
+
+// Snapshot node. Node 0 is the root directory, the children of a directory are
+// stored as consecutive nodes sorted by name.
+typedef struct indexNode {
+	uint32_t	iName;					// Offset of the name record in the name pool
+	uint32_t	iFirst;					// Index of the first child
+	uint32_t	iCount;					// Number of children
+	uint32_t	iFlags;					// INDEX_M_xxx
+	int64_t		lSize;					// File size
+	int64_t		lModified;				// Last modified (seconds since Jan 1, 1970)
+} INDEX_NODE;
+
+// Directory iterator, returns the children of a directory in sorted order.
+typedef struct indexIter {
+	const INDEX_NODE	*pDir;			// Directory node
+	uint32_t			iNext;			// Index of the next child (relative)
+	const uint8_t		*pcRecord;		// Next name record
+	char				cName[MAX_PATH_SIZE];	// Name of the current child
+} INDEX_ITER;
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+int				  indexBuild( const char *pcRootDir, const char *pcIndexFile );
+int64_t			  indexCreated( void );
+bool			  indexEnabled( void );
+void			  indexFirst( INDEX_ITER *pIter, const INDEX_NODE *pDir );
+const INDEX_NODE *indexLookup( const char *pcFullPath );
+const INDEX_NODE *indexNext( INDEX_ITER *pIter );
+bool			  indexOpen( const char *pcIndexFile );
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif /* _CBTREE_INDEX_H_ */
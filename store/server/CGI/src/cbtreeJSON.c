@@ -14,6 +14,11 @@
 *	Description:
 *
 *		This module provides all the functionality to decode and encode JSON.
+*		File lists are encoded into a fixed size output buffer which is written
+*		to the response stream whenever it is full, the memory required to encode
+*		a response is therefore independent of the size of the response. Names
+*		and paths are escaped as JSON strings, runs of characters that need no
+*		escaping are detected 16 characters at a time if SSE2 is available.
 *
 *		Please refer to http://json.org/ for the JSON encoding rules.
 *
@@ -26,8 +31,13 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #include <emmintrin.h>
+  #define JSON_SSE2
+#endif
 
 #include "cbtreeCommon.h"
+#include "cbtreeDebug.h"
 #include "cbtreeJSON.h"
 #include "cbtreeList.h"
 #include "cbtreeString.h"
@@ -40,35 +50,214 @@ static bool _jsonIsObject( char *pcSrc, char **ppcNext );
 static bool _jsonIsString( char *pcSrc, char **ppcNext );
 char *_jsonNext( char *pcSrc, int iValue );
 
+typedef struct jsonStream {
+	FILE	*phStream;					// Output stream
+	size_t	iLength;					// Number of characters in the buffer
+	bool	bError;						// Write error
+	char	cBuffer[MAX_RSP_SEGM];		// Output buffer
+} JSON_STREAM;
+
+// Append a property key literal, including the leading comma unless iFirst is 1.
+#define jsonPutKey(p,k,iFirst)	_jsonPutn( (p), (k) + (iFirst), sizeof(k) - 1 - (iFirst) )
+
+// Decimal digit pairs "00" through "99".
+static const char cDigitPairs[] =
+	"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+	"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
 /**
-*	_jsonExtendResp
-*
-*		Extend the JSON encoding buffer. The JSON encoding buffer is allocated with a
-*		default size, if however, the amount of data to be encoded exceeds the current
-*		buffer size the buffer needs to be extended.
-*		
-*	@param	ppcResp			Address of a pointer of type char marking the buffer
-*	@param	piSize			Address of a pointer of type size_t marking the current
-*							buffer size.
-*	@param	ppcOffset		Address of a pointer of type char marking the current
-*							offset in the buffer.
-*
-*	@return		Address of the extended buffer or NULL in case of failure.
+*	_jsonFlush
+*
+*		Write the content of the output buffer to the output stream.
+*
+*	@param	pStream			Address JSON_STREAM struct.
+*	@param	bPush			If true the output stream is flushed as well, that is,
+*							the output is passed on to the server immediately.
 **/
-static char *_jsonExtendResp( char **ppcResp, size_t *piSize, char **ppcOffset )
+static void _jsonFlush( JSON_STREAM *pStream, bool bPush )
 {
-	char	*pcNewResp;
-	size_t	iRespLen;
-	
-	iRespLen = *ppcOffset - *ppcResp;
-	*piSize += MAX_RSP_SEGM;
-	
-	if( (pcNewResp = realloc( *ppcResp, *piSize )) )
+	if( pStream->iLength )
+	{
+		if( fwrite( pStream->cBuffer, 1, pStream->iLength, pStream->phStream ) != pStream->iLength )
+		{
+			pStream->bError = true;
+		}
+		pStream->iLength = 0;
+	}
+	if( bPush )
+	{
+		fflush( pStream->phStream );
+	}
+}
+
+/**
+*	_jsonPutn
+*
+*		Append iLength characters to the output buffer.
+*
+*	@param	pStream			Address JSON_STREAM struct.
+*	@param	pcSrc			Address of the characters to append.
+*	@param	iLength			Number of characters to append.
+**/
+static void _jsonPutn( JSON_STREAM *pStream, const char *pcSrc, size_t iLength )
+{
+	size_t	iCopy;
+
+	while( iLength )
+	{
+		if( pStream->iLength == sizeof(pStream->cBuffer) )
+		{
+			_jsonFlush( pStream, true );
+		}
+		iCopy = sizeof(pStream->cBuffer) - pStream->iLength;
+		iCopy = iCopy < iLength ? iCopy : iLength;
+		memcpy( &pStream->cBuffer[pStream->iLength], pcSrc, iCopy );
+		pStream->iLength += iCopy;
+		pcSrc	+= iCopy;
+		iLength -= iCopy;
+	}
+}
+
+/**
+*	_jsonPutLong
+*
+*		Append the decimal representation of a long integer to the output buffer.
+*		The digits are generated two at a time using a table of digit pairs.
+*
+*	@param	pStream			Address JSON_STREAM struct.
+*	@param	lValue			Integer value.
+**/
+static void _jsonPutLong( JSON_STREAM *pStream, long lValue )
+{
+	unsigned long	ulValue = lValue < 0 ? 0UL - (unsigned long)lValue : (unsigned long)lValue;
+	char			cDigits[24],
+					*pcDigit = &cDigits[sizeof(cDigits)];
+
+	while( ulValue >= 100 )
+	{
+		pcDigit -= 2;
+		memcpy( pcDigit, &cDigitPairs[(ulValue % 100) * 2], 2 );
+		ulValue /= 100;
+	}
+	if( ulValue >= 10 )
+	{
+		pcDigit -= 2;
+		memcpy( pcDigit, &cDigitPairs[ulValue * 2], 2 );
+	}
+	else
+	{
+		*--pcDigit = (char)('0' + ulValue);
+	}
+	if( lValue < 0 )
+	{
+		*--pcDigit = '-';
+	}
+	_jsonPutn( pStream, pcDigit, &cDigits[sizeof(cDigits)] - pcDigit );
+}
+
+/**
+*	_jsonPutc
+*
+*		Append a single character to the output buffer.
+*
+*	@param	pStream			Address JSON_STREAM struct.
+*	@param	iChar			Character to append.
+**/
+static void _jsonPutc( JSON_STREAM *pStream, int iChar )
+{
+	if( pStream->iLength == sizeof(pStream->cBuffer) )
+	{
+		_jsonFlush( pStream, true );
+	}
+	pStream->cBuffer[pStream->iLength++] = (char)iChar;
+}
+
+/**
+*	_jsonCleanLength
+*
+*		Returns the number of leading characters of a string that can be used in a
+*		JSON string as is, that is, characters other than a double quote, backslash
+*		or control character. If SSE2 is available 16 characters are tested at once.
+*
+*	@param	pcSrc			Address of the string.
+*	@param	iLength			Length of the string.
+*
+*	@return		Number of characters that need no escaping.
+**/
+static size_t _jsonCleanLength( const unsigned char *pcSrc, size_t iLength )
+{
+	size_t	i = 0;
+#ifdef JSON_SSE2
+	__m128i	xQuote = _mm_set1_epi8( '"' ),
+			xSlash = _mm_set1_epi8( '\\' ),
+			xCntrl = _mm_set1_epi8( 0x1F ),
+			xData,
+			xMatch;
+
+	for( ; i + 16 <= iLength; i += 16 )
+	{
+		xData  = _mm_loadu_si128( (const __m128i *)&pcSrc[i] );
+		// A control character is any character whose unsigned maximum with 0x1F is 0x1F.
+		xMatch = _mm_or_si128( _mm_or_si128( _mm_cmpeq_epi8( xData, xQuote ), _mm_cmpeq_epi8( xData, xSlash ) ),
+							   _mm_cmpeq_epi8( _mm_max_epu8( xData, xCntrl ), xCntrl ) );
+		if( _mm_movemask_epi8( xMatch ) )
+		{
+			break;	// Locate the character below.
+		}
+	}
+#endif	/* JSON_SSE2 */
+	for( ; i < iLength && pcSrc[i] >= 0x20 && pcSrc[i] != '"' && pcSrc[i] != '\\'; i++ );
+	return i;
+}
+
+/**
+*	_jsonEscape
+*
+*		Append a C-string to the output buffer as the content of a JSON string. Any
+*		double quote, backslash and control character is escaped, runs of other
+*		characters are copied as is.
+*
+*	@param	pStream			Address JSON_STREAM struct.
+*	@param	pcString		Address C-string.
+**/
+static void _jsonEscape( JSON_STREAM *pStream, const char *pcString )
+{
+	static const char	*pcSpecial = "\"\\\b\f\n\r\t",
+						*pcEscaped = "\"\\bfnrt",
+						*pcHex	   = "0123456789abcdef";
+	const unsigned char	*pcSrc = (const unsigned char *)pcString;
+	const char			*pcMatch;
+	char				cEscape[2] = { '\\', '\0' },
+						cUnicode[6] = { '\\', 'u', '0', '0', '0', '0' };
+	size_t				iLength = pcString ? strlen( pcString ) : 0,
+						iClean;
+
+	while( iLength )
 	{
-		*ppcOffset = (char *)(pcNewResp + iRespLen);
-		*ppcResp   = pcNewResp;
+		if( (iClean = _jsonCleanLength( pcSrc, iLength )) )
+		{
+			_jsonPutn( pStream, (const char *)pcSrc, iClean );
+			pcSrc	+= iClean;
+			iLength -= iClean;
+		}
+		if( iLength )
+		{
+			if( (pcMatch = strchr( pcSpecial, *pcSrc )) )
+			{
+				cEscape[1] = pcEscaped[pcMatch - pcSpecial];
+				_jsonPutn( pStream, cEscape, 2 );
+			}
+			else // Any other control character
+			{
+				cUnicode[4] = pcHex[*pcSrc >> 4];
+				cUnicode[5] = pcHex[*pcSrc & 0x0F];
+				_jsonPutn( pStream, cUnicode, 6 );
+			}
+			pcSrc++;
+			iLength--;
+		}
 	}
-	return pcNewResp;
 }
 
 /**
@@ -412,9 +601,10 @@ char *_jsonTrimBrackets( char *pcLBrck, char *pcRBrck )
 *		Decode a DATA struct of type string. The value of the string type must be
 *		JSON encoded otherwise NULL is returned.
 *
-*	@note	The content of a JSON array or object are parsed recursive but because
-*			the JSON strings are small and never exceed MAX_BUF_SIZE in length no
-*			stack overflow should happen.
+*	@note	The content of a JSON array or object are parsed recursive. The work
+*			buffers are allocated on the heap and sized after the JSON string,
+*			therefore the recursion depth is only bound by the nesting level of
+*			the JSON string and strings are never truncated.
 *
 *	@param	ptString		Address of a DATA struct of type string.
 *
@@ -426,16 +616,25 @@ static DATA *_jsonDecodeString( DATA *ptString )
 			*ptMember,
 			*pObject,
 			*ptValue;
-	char	cBuffer[MAX_BUF_SIZE],
-			cValue[MAX_BUF_SIZE],
-			cProp[MAX_BUF_SIZE],
-			*pcValue = cValue,
-			*pcProp  = cProp,
+	char	*pcBuffer,
+			*pcValue,
+			*pcProp,
 			*pcSrc, *pcNext;
-	long	lValue;
+	size_t	iSize = ptCopy->length + 1;
+	long long llValue;
 	
-	strncpyz( cBuffer, (char *)ptCopy->value.pcString, sizeof(cBuffer)-1 );
-	pcSrc = strtrim( cBuffer, TRIM_M_WSP );
+	// One buffer for the source, value and property strings. The buffer is padded
+	// so isData() never probes beyond its end.
+	if( !(pcBuffer = (char *)calloc( 1, 3 * iSize + sizeof(DATA) )) )
+	{
+		destroy( ptCopy );
+		return NULL;
+	}
+	pcValue = pcBuffer + iSize;
+	pcProp  = pcValue + iSize;
+
+	strncpyz( pcBuffer, (char *)ptCopy->value.pcString, iSize-1 );
+	pcSrc = strtrim( pcBuffer, TRIM_M_WSP );
 
 	if( pcSrc && *pcSrc )
 	{
@@ -448,9 +647,9 @@ static DATA *_jsonDecodeString( DATA *ptString )
 
 			while( pcSrc && *pcSrc )
 			{
-				if( _jsonGetProp( pcSrc, sizeof(cProp), &pcProp, &pcNext ) )
+				if( _jsonGetProp( pcSrc, iSize, &pcProp, &pcNext ) )
 				{
-					if( _jsonGetValue( pcNext, sizeof(cValue), &pcValue, &pcNext ) )
+					if( _jsonGetValue( pcNext, iSize, &pcValue, &pcNext ) )
 					{
 						ptValue  = newString( pcProp, pcValue );
 						if( (ptMember = _jsonDecodeString( ptValue )) )
@@ -467,9 +666,11 @@ static DATA *_jsonDecodeString( DATA *ptString )
 				}
 				destroy( pObject );
 				destroy( ptCopy );
+				free( pcBuffer );
 				return NULL;
 			}
 			destroy( ptCopy );
+			free( pcBuffer );
 			return pObject;
 		}
 		// array ::= '[' value (',' value)* ']'
@@ -480,7 +681,7 @@ static DATA *_jsonDecodeString( DATA *ptString )
 
 			while( pcSrc && *pcSrc )
 			{
-				if( _jsonGetValue( pcSrc, sizeof(cValue), &pcValue, &pcNext ) )
+				if( _jsonGetValue( pcSrc, iSize, &pcValue, &pcNext ) )
 				{
 					ptValue  = newString( NULL, pcValue );
 					if( (ptMember = _jsonDecodeString( ptValue )) )
@@ -496,9 +697,11 @@ static DATA *_jsonDecodeString( DATA *ptString )
 				}
 				destroy( pObject );
 				destroy( ptCopy );
+				free( pcBuffer );
 				return NULL;
 			}
 			destroy( ptCopy );
+			free( pcBuffer );
 			return pObject;
 		}
 		
@@ -506,31 +709,43 @@ static DATA *_jsonDecodeString( DATA *ptString )
 		{
 			strtrim( pcSrc, TRIM_M_QUOTES );
 			varSet( ptCopy, pcSrc );
+			free( pcBuffer );
 			return ptCopy;
 		}
 		if( _jsonIsNumber( pcSrc, &pcNext ) )
 		{
-			lValue = (long)strtod(pcSrc, NULL);
-			ptMember = newInteger( ptCopy->name, lValue );
+			// Integral numbers are decoded exact, strtoll() saturates instead of
+			// wrapping if the number exceeds 64 bits.
+			llValue = strtoll( pcSrc, &pcNext, 10 );
+			if( *pcNext == '.' || *pcNext == 'e' || *pcNext == 'E' )
+			{
+				llValue = (long long)strtod( pcSrc, NULL );
+			}
+			ptMember = newInteger( ptCopy->name, llValue );
 			destroy( ptCopy );
+			free( pcBuffer );
 			return ptMember;
 		}
 		if( _jsonIsBoolean( pcSrc, &pcNext ) )
 		{
 			ptMember = newBoolean( ptCopy->name, !strcmp(pcSrc,"true") );
 			destroy( ptCopy );
+			free( pcBuffer );
 			return ptMember;
 		}
 		if( _jsonIsNull( pcSrc, &pcNext ) )
 		{
 			ptMember = newNull( ptCopy->name );
 			destroy( ptCopy );
+			free( pcBuffer );
 			return ptMember;
 		}
 		// Invalid JSON type.
 		destroy( ptCopy );
+		free( pcBuffer );
 		return NULL;		
 	}
+	free( pcBuffer );
 	return ptCopy;
 }
 
@@ -575,113 +790,135 @@ DATA *jsonDecode( void *pvData )
 /**
 *	_jsonEncodeFileInfo
 *
-*		JSON encode a list of FILE_INFO structs. The response buffer size is automatically
-*		extended if required.
-*
-*	@param	pFileList		Address LIST struct.
-*	@param	ppcResp			Address of a pointer of type char containing the address
-*							of the response buffer
-*	@param	piSize			Address of a pointer of type int containing the current 
-*							response buffer size.
-*	@param	imFlags			Bit mask of encoding flags.
-*	@param	ppcDest			Address of a pointer of type char identifying the current
-*							offset in the response buffer.
+*		JSON encode a list of FILE_INFO structs as a JSON array and append it to the
+*		output buffer. The property keys are appended as precomputed literals and
+*		integers are converted using _jsonPutLong(), no format strings are parsed.
 *
-*	@return		On success 1 otherwise 0
+*	@param	pFileList		Address VECTOR struct or NULL.
+*	@param	imFlags			Bit mask of the file properties (PROP_M_xxx) to encode.
+*	@param	pStream			Address JSON_STREAM struct.
 **/
-static int _jsonEncodeFileInfo( LIST *pFileList, char **ppcResp, size_t *piSize, int imFlags, char **ppcDest )
+static void _jsonEncodeFileInfo( VECTOR *pFileList, int imFlags, JSON_STREAM *pStream )
 {
 	FILE_INFO	*pFileInfo;
-	ENTRY		*pEntry;
-	int			iFree;
+	int			iPropMask,
+				iFirst,
+				iCount,
+				i;
 
-	for( pEntry = pFileList->pNext; pEntry != pFileList; pEntry = pEntry->pNext )
+	_jsonPutc( pStream, '[' );
+	for( iCount = 0, i = 0; pFileList && i < pFileList->iCount; i++ )
 	{
-		iFree = *piSize - (*ppcDest - *ppcResp);
-		if( iFree < 1024 ) 
+		if( (pFileInfo = (FILE_INFO *)pFileList->ppvData[i]) )
 		{
-			if( !_jsonExtendResp( ppcResp, piSize, ppcDest ) ) 
+			// Only encode the properties that are both requested and available.
+			iPropMask = pFileInfo->iPropMask & imFlags;
+			iFirst	  = 1;
+
+			// Separate the entries actually encoded, empty slots are skipped.
+			if( iCount++ )
 			{
-				return 0;
+				_jsonPutc( pStream, ',' );
+			}
+			_jsonPutc( pStream, '{' );
+			if( (iPropMask & PROP_M_NAME) )
+			{
+				jsonPutKey( pStream, ",\"name\":\"", iFirst );
+				_jsonEscape( pStream, pFileInfo->pcName );
+				_jsonPutc( pStream, '"' );
+				iFirst = 0;
+			}
+			if( (iPropMask & PROP_M_PATH) )
+			{
+				jsonPutKey( pStream, ",\"path\":\"", iFirst );
+				_jsonEscape( pStream, pFileInfo->pcDir );
+				_jsonEscape( pStream, pFileInfo->pcName );
+				_jsonPutc( pStream, '"' );
+				iFirst = 0;
+			}
+			if( (iPropMask & PROP_M_SIZE) )
+			{
+				jsonPutKey( pStream, ",\"size\":", iFirst );
+				_jsonPutLong( pStream, pFileInfo->lSize );
+				iFirst = 0;
+			}
+			if( (iPropMask & PROP_M_MODIFIED) )
+			{
+				jsonPutKey( pStream, ",\"modified\":", iFirst );
+				_jsonPutLong( pStream, pFileInfo->lModified );
+				iFirst = 0;
 			}
-			iFree = *piSize - (*ppcDest - *ppcResp);
-		}
-
-		if( (pFileInfo = (FILE_INFO *)pEntry->pvData) )
-		{
-			*(*ppcDest)++ = '{';
-			*ppcDest += snprintf( *ppcDest, iFree, "\"name\":\"%s\"", pFileInfo->pcName );
-			*ppcDest += snprintf( *ppcDest, iFree, ",\"path\":\"%s\"", pFileInfo->pcPath );
-			*ppcDest += snprintf( *ppcDest, iFree, ",\"size\":%d", pFileInfo->lSize );
-			*ppcDest += snprintf( *ppcDest, iFree, ",\"modified\":%d", pFileInfo->lModified );
 
 			// Include directory related info if, and only if, it is a directory...
-			if( (pFileInfo->iPropMask & PROP_M_DIRECTORY)  )
+			if( (iPropMask & PROP_M_DIRECTORY)  )
 			{
-				*ppcDest += snprintf( *ppcDest, iFree, ",\"directory\":true" );
+				jsonPutKey( pStream, ",\"directory\":true", iFirst );
+				iFirst = 0;
 				if( (pFileInfo->iPropMask & PROP_M_CHILDREN)  )
 				{
-					*ppcDest += snprintf( *ppcDest, iFree, ",\"_EX\":true" );
-					*ppcDest += snprintf( *ppcDest, iFree, ",\"children\":[" );
-					_jsonEncodeFileInfo( pFileInfo->pChildren, ppcResp, piSize, imFlags, ppcDest );
-					*(*ppcDest)++ = ']';
+					jsonPutKey( pStream, ",\"_EX\":true,\"children\":", 0 );
+					_jsonEncodeFileInfo( pFileInfo->pChildren, imFlags, pStream );
 				} 
 				else 
 				{
-					*ppcDest += snprintf( *ppcDest, iFree, ",\"_EX\":false" );
-					*ppcDest += snprintf( *ppcDest, iFree, ",\"children\":[]" );
+					jsonPutKey( pStream, ",\"_EX\":false,\"children\":[]", 0 );
 				}
 			}
 			if( (pFileInfo->iPropMask & PROP_M_OLDPATH)  )
 			{
-				*ppcDest += snprintf( *ppcDest, iFree, ",\"oldPath\":\"%s\"", pFileInfo->pcOldPath );
+				jsonPutKey( pStream, ",\"oldPath\":\"", iFirst );
+				_jsonEscape( pStream, pFileInfo->pcOldPath );
+				_jsonPutc( pStream, '"' );
+				iFirst = 0;
+			}
+			if( (pFileInfo->iPropMask & PROP_M_DELETED)  )
+			{
+				jsonPutKey( pStream, ",\"deleted\":true", iFirst );
+				iFirst = 0;
 			}
-			*(*ppcDest)++ = '}';
-			if( pEntry->pNext != pFileList )
+			if( (pFileInfo->iPropMask & PROP_M_AGGREGATE)  )
 			{
-				*(*ppcDest)++ = ',';
+				jsonPutKey( pStream, ",\"files\":", iFirst );
+				_jsonPutLong( pStream, pFileInfo->lFiles );
+				jsonPutKey( pStream, ",\"bytes\":", 0 );
+				_jsonPutLong( pStream, pFileInfo->lBytes );
 			}
+			_jsonPutc( pStream, '}' );
 		}
 	}
-	return 1;
+	_jsonPutc( pStream, ']' );
 }
 
 /**
-*	jsonEncode
+*	jsonWrite
 *
-*		JSON encode a list of FILE_INFO structs. The result is a JSON encode array.
+*		JSON encode a list of FILE_INFO structs and write the resulting JSON array to
+*		an output stream. The output buffer is written to the stream, and the stream
+*		is flushed, each time the buffer is full therefore the first part of a large
+*		response is sent while the remainder is still being encoded. The remainder
+*		is left in the stream buffer for the caller to complete the response.
 *
-*	@note	It the callers responsibility to release (free) the resources
-*			associated with the returned result.
+*	@param	phStream		Output stream.
+*	@param	pFileList		Address VECTOR struct or NULL in which case an empty
+*							array is written.
+*	@param	imFlags			Bit mask of the file properties (PROP_M_xxx) to encode.
+*							If zero, all file properties are encoded.
 *
-*	@param	pFileList
-*	@param	imFlags			Integer bit mask (not used yet).
-*
-*	@return		Address C-string containing the JSON encoded file list
+*	@return		True on success otherwise false.
 **/
-char *jsonEncode( LIST *pFileList, int imFlags )
+bool jsonWrite( FILE *phStream, VECTOR *pFileList, int imFlags )
 {
-	size_t	iSize = MAX_RSP_SEGM;
-	char	*pcJSON = NULL,
-			*pcOffset;
-
-	if( pFileList )
-	{
-		if( (pcJSON = (char *)malloc(iSize)) )
-		{
-			pcOffset = pcJSON;
+	JSON_STREAM	sStream;
 
-			*pcOffset++ = '[';
-			
-			_jsonEncodeFileInfo( pFileList, &pcJSON, &iSize, imFlags, &pcOffset );
+	sStream.phStream = phStream;
+	sStream.iLength	 = 0;
+	sStream.bError	 = false;
 
-			*pcOffset++ = ']';
-			*pcOffset = '\0';
-		}
-	}
-	else // At least return an empty array.
+	_jsonEncodeFileInfo( pFileList, (imFlags ? imFlags : PROP_M_FIELDS), &sStream );
+	_jsonFlush( &sStream, false );
+	if( sStream.bError )
 	{
-		pcJSON = mstrcpy( "[]" );
+		cbtDebug( "Failed to write the JSON response." );
 	}
-	return pcJSON;
+	return !sStream.bError;
 }
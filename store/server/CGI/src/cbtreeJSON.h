@@ -1,6 +1,8 @@
 #ifndef _CBTREE_JSON_H_
 #define _CBTREE_JSON_H_
 
+#include <stdio.h>
+
 #include "cbtreeCommon.h"
 #include "cbtreeFiles.h"
 
@@ -14,7 +16,7 @@
 
 DATA *jsonDecode( void *pvData );
 
-char *jsonEncode( LIST *pFileInfo, int imFlags );
+bool  jsonWrite( FILE *phStream, VECTOR *pFileList, int imFlags );
 
 #ifdef __cplusplus
 	}
@@ -0,0 +1,391 @@
+/****************************************************************************************
+*	Copyright (c) 2012, Peter Jekel
+*	All rights reserved.
+*
+*	The Checkbox Tree File Store CGI (cbtreeFileStore) is released under to following
+*	license:
+*
+*	    BSD 2-Clause		(http://thejekels.com/cbtree/LICENSE)
+*
+*	@author		Peter Jekel
+*
+****************************************************************************************
+*
+*	Description:
+*
+*		This module provides the mutation journal used by the change feed. Every
+*		file or directory deleted (HTTP DELETE) or renamed (HTTP POST) by this
+*		application is recorded in the journal. Files added or modified are found
+*		by their last modified time instead, therefore only operations that leave
+*		no trace in the file tree need to be recorded.
+*
+*		A journal record is written using a single write() call to a file opened
+*		in append mode, concurrent CGI processes therefore never interleave their
+*		records. Each record has the following format:
+*
+*			record	 ::= operation '\t' time '\t' field ('\t' field)? '\n'
+*			field	 ::= length '\t' CHAR*
+*
+*		where operation is either 'D' (delete) or 'R' (rename), time is the time
+*		of the operation and each field is a full path preceded by its length in
+*		bytes. A rename record has two fields, the old and the new path.
+*
+*		A change feed token identifies a point in time and the position in the
+*		journal at that time. The journal may be truncated or replaced at any time,
+*		a token issued for a previous journal is detected by the inode number of
+*		the journal and the size of the journal.
+*
+*	NOTE:	The journal is currently only available on POSIX systems. On Microsoft
+*			Windows journalInit() always fails.
+*
+****************************************************************************************/
+#ifdef _MSC_VER
+	#define _CRT_SECURE_NO_WARNINGS
+#endif	/* _MSC_VER */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#ifndef WIN32
+  #include <fcntl.h>
+  #include <unistd.h>
+  #include <sys/stat.h>
+#endif /* WIN32 */
+
+#include "cbtreeJournal.h"
+#include "cbtreeDebug.h"
+#include "cbtreeString.h"
+
+#ifndef WIN32
+static int	iJournalFd = -1;
+#endif /* WIN32 */
+
+#ifndef WIN32
+/**
+*	_journalField
+*
+*		Extract a length prefixed field from a journal record.
+*
+*	@param	ppcRecord		Address of a pointer to the field separator, on return
+*							the pointer is advanced beyond the field.
+*	@param	pcEnd			Address end of the journal data.
+*	@param	ppcValue		Address of a pointer receiving the start of the field.
+*	@param	piLen			Address size_t receiving the length of the field.
+*
+*	@return		True if successful otherwise false.
+**/
+static bool _journalField( char **ppcRecord, char *pcEnd, char **ppcValue, size_t *piLen )
+{
+	char			*pcNext;
+	unsigned long	lLen;
+
+	if( *ppcRecord >= pcEnd || **ppcRecord != '\t' )
+	{
+		return false;
+	}
+	lLen = strtoul( *ppcRecord + 1, &pcNext, 10 );
+	if( pcNext >= pcEnd || *pcNext != '\t' || lLen > (unsigned long)(pcEnd - pcNext - 1) )
+	{
+		return false;
+	}
+	*ppcValue  = pcNext + 1;
+	*piLen	   = (size_t)lLen;
+	*ppcRecord = pcNext + 1 + lLen;
+	return true;
+}
+#endif /* WIN32 */
+
+/**
+*	journalAppend
+*
+*		Append a record to the journal.
+*
+*	@param	iOperation		Operation: JOURNAL_V_DELETE or JOURNAL_V_RENAME
+*	@param	pcPath			Address C-string containing the full path of the file.
+*	@param	pcNewPath		Address C-string containing the new full path of the
+*							file (rename only) or NULL.
+*
+*	@return		True if the record was written otherwise false.
+**/
+bool journalAppend( int iOperation, const char *pcPath, const char *pcNewPath )
+{
+#ifndef WIN32
+	char	cRecord[MAX_PATH_SIZE * 2 + 64];
+	int		iLen;
+
+	if( iJournalFd == -1 )
+	{
+		return false;
+	}
+	if( pcNewPath )
+	{
+		iLen = snprintf( cRecord, sizeof(cRecord), "%c\t%ld\t%lu\t%s\t%lu\t%s\n", iOperation, (long)time(NULL),
+						 (unsigned long)strlen(pcPath), pcPath, (unsigned long)strlen(pcNewPath), pcNewPath );
+	}
+	else
+	{
+		iLen = snprintf( cRecord, sizeof(cRecord), "%c\t%ld\t%lu\t%s\n", iOperation, (long)time(NULL),
+						 (unsigned long)strlen(pcPath), pcPath );
+	}
+	if( iLen < 0 || iLen >= (int)sizeof(cRecord) || write( iJournalFd, cRecord, iLen ) != iLen )
+	{
+		cbtDebug( "Journal record for [%s] not written.", pcPath );
+		return false;
+	}
+	return true;
+#else
+	(void)iOperation;
+	(void)pcPath;
+	(void)pcNewPath;
+
+	return false;
+#endif /* WIN32 */
+}
+
+/**
+*	journalDestroy
+*
+*		Release a list of journal records returned by journalRead().
+*
+*	@param	ppList			Address of a pointer of type LIST.
+**/
+void journalDestroy( LIST **ppList )
+{
+	destroyList( ppList, free );
+}
+
+/**
+*	journalEnabled
+*
+*		Returns true if the journal is enabled.
+*
+*	@return		True or false.
+**/
+bool journalEnabled( void )
+{
+#ifndef WIN32
+	return (iJournalFd != -1);
+#else
+	return false;
+#endif /* WIN32 */
+}
+
+/**
+*	journalFormat
+*
+*		Compose the string representation of a change feed token.
+*
+*	@param	pToken			Address JOURNAL_TOKEN struct.
+*	@param	pcBuf			Address character buffer receiving the token.
+*	@param	iSize			Size of the character buffer.
+*
+*	@return		Address C-string containing the token.
+**/
+char *journalFormat( JOURNAL_TOKEN *pToken, char *pcBuf, size_t iSize )
+{
+	snprintf( pcBuf, iSize, "%lx-%lx-%lx", pToken->lTime, pToken->lJournal, pToken->lOffset );
+	return pcBuf;
+}
+
+/**
+*	journalInit
+*
+*		Open, or create, the journal. The journal must not be located inside the
+*		document root, otherwise it would be served by the HTTP server.
+*
+*	@param	pcJournal		Address C-string containing the journal file path.
+*	@param	pcDocRoot		Address C-string containing the document root.
+*
+*	@return		True if the journal is enabled otherwise false.
+**/
+bool journalInit( const char *pcJournal, const char *pcDocRoot )
+{
+#ifndef WIN32
+	char	cDocRoot[PATH_MAX],
+			cDirectory[PATH_MAX],
+			cJournal[PATH_MAX],
+			*pcName;
+	size_t	iLen;
+
+	if( iJournalFd != -1 )	// The journal may have been replaced since.
+	{
+		close( iJournalFd );
+		iJournalFd = -1;
+	}
+	if( !pcJournal || !*pcJournal )
+	{
+		return false;
+	}
+	// The journal may not exist yet, validate the location of its directory instead.
+	strncpyz( cJournal, pcJournal, sizeof(cJournal)-1 );
+	if( (pcName = strrchr( cJournal, '/' )) )
+	{
+		*pcName++ = '\0';
+	}
+	if( !realpath( (pcName ? (*cJournal ? cJournal : "/") : "."), cDirectory ) || !realpath( pcDocRoot, cDocRoot ) )
+	{
+		cbtDebug( "Journal [%s] is not available.", pcJournal );
+		return false;
+	}
+	iLen = strlen( cDocRoot );
+	if( !strncmp( cDirectory, cDocRoot, iLen ) &&
+		(cDirectory[iLen] == '/' || cDirectory[iLen] == '\0' || cDocRoot[iLen-1] == '/') )
+	{
+		cbtDebug( "Journal [%s] is inside the document root.", pcJournal );
+		return false;
+	}
+	if( (iJournalFd = open( pcJournal, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644 )) == -1 )
+	{
+		cbtDebug( "Journal [%s] is not available.", pcJournal );
+		return false;
+	}
+	return true;
+#else
+	(void)pcJournal;
+	(void)pcDocRoot;
+
+	return false;
+#endif /* WIN32 */
+}
+
+/**
+*	journalParse
+*
+*		Decode the string representation of a change feed token. The token "0"
+*		represents the beginning of time.
+*
+*	@param	pcToken			Address C-string containing the token.
+*	@param	pToken			Address JOURNAL_TOKEN struct receiving the token.
+*
+*	@return		True if the token is valid otherwise false.
+**/
+bool journalParse( const char *pcToken, JOURNAL_TOKEN *pToken )
+{
+	char	cExtra;
+
+	memset( pToken, 0, sizeof(JOURNAL_TOKEN) );
+	if( pcToken && !strcmp( pcToken, "0" ) )
+	{
+		return true;
+	}
+	if( !pcToken || strchr( pcToken, '-' ) == NULL ||
+		sscanf( pcToken, "%lx-%lx-%lx%c", (unsigned long *)&pToken->lTime, &pToken->lJournal,
+				(unsigned long *)&pToken->lOffset, &cExtra ) != 3 ||
+		pToken->lTime < 0 || pToken->lOffset < 0 )
+	{
+		return false;
+	}
+	return true;
+}
+
+/**
+*	journalPosition
+*
+*		Returns the change feed token for the current time and journal position.
+*
+*	@param	pToken			Address JOURNAL_TOKEN struct receiving the token.
+**/
+void journalPosition( JOURNAL_TOKEN *pToken )
+{
+#ifndef WIN32
+	struct stat	sStat;
+#endif /* WIN32 */
+
+	memset( pToken, 0, sizeof(JOURNAL_TOKEN) );
+	pToken->lTime = (long)time(NULL);
+#ifndef WIN32
+	if( iJournalFd != -1 && !fstat( iJournalFd, &sStat ) )
+	{
+		pToken->lJournal = (unsigned long)sStat.st_ino;
+		pToken->lOffset	 = (long)sStat.st_size;
+	}
+#endif /* WIN32 */
+}
+
+/**
+*	journalRead
+*
+*		Returns the journal records between two journal positions. Incomplete or
+*		malformed records end the list.
+*
+*	@param	lOffset			Journal position of the first record.
+*	@param	lEnd			Journal position following the last record.
+*
+*	@return		Address LIST struct of JOURNAL_ENTRY structs or NULL if the journal
+*				isn't available.
+**/
+LIST *journalRead( long lOffset, long lEnd )
+{
+#ifndef WIN32
+	JOURNAL_ENTRY	*pEntry;
+	LIST	*pList = NULL;
+	char	*pcData,
+			*pcRecord,
+			*pcEnd,
+			*pcPath,
+			*pcNewPath,
+			*pcNext;
+	size_t	iPathLen,
+			iNewLen;
+	long	lTime;
+	int		iOperation;
+
+	if( iJournalFd == -1 || lOffset > lEnd )
+	{
+		return NULL;
+	}
+	if( !(pcData = (char *)malloc( (lEnd - lOffset) + 1 )) )
+	{
+		return NULL;
+	}
+	if( pread( iJournalFd, pcData, lEnd - lOffset, lOffset ) != lEnd - lOffset )
+	{
+		free( pcData );
+		return NULL;
+	}
+
+	pList  = newList();
+	pcEnd  = pcData + (lEnd - lOffset);
+	pcRecord = pcData;
+	while( pcRecord < pcEnd )
+	{
+		iOperation = *pcRecord++;
+		pcNewPath  = NULL;
+		iNewLen	   = 0;
+		if( pcRecord >= pcEnd || *pcRecord != '\t' )
+		{
+			break;
+		}
+		lTime = strtol( pcRecord + 1, &pcNext, 10 );
+		pcRecord = pcNext;
+		if( !_journalField( &pcRecord, pcEnd, &pcPath, &iPathLen ) ||
+			(iOperation == JOURNAL_V_RENAME && !_journalField( &pcRecord, pcEnd, &pcNewPath, &iNewLen )) ||
+			pcRecord >= pcEnd || *pcRecord++ != '\n' )
+		{
+			break;
+		}
+		if( (pEntry = (JOURNAL_ENTRY *)calloc( 1, sizeof(JOURNAL_ENTRY) + iPathLen + iNewLen + 2 )) )
+		{
+			pEntry->iOperation = iOperation;
+			pEntry->lTime	   = lTime;
+			pEntry->pcPath	   = (char *)(pEntry + 1);
+			memcpy( pEntry->pcPath, pcPath, iPathLen );
+			if( pcNewPath )
+			{
+				pEntry->pcNewPath = pEntry->pcPath + iPathLen + 1;
+				memcpy( pEntry->pcNewPath, pcNewPath, iNewLen );
+			}
+			insertTail( pEntry, pList );
+		}
+	}
+	free( pcData );
+	return pList;
+#else
+	(void)lOffset;
+	(void)lEnd;
+
+	return NULL;
+#endif /* WIN32 */
+}
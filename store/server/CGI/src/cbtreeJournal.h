@@ -0,0 +1,43 @@
+#ifndef _CBTREE_JOURNAL_H_
+#define _CBTREE_JOURNAL_H_
+
+#include "cbtreeCommon.h"
+#include "cbtreeList.h"
+
+#define JOURNAL_V_DELETE	'D'			// File or directory deleted.
+#define JOURNAL_V_RENAME	'R'			// File or directory renamed.
+
+// Change feed token, identifies a point in time and the journal position at
+// that time.
+typedef struct journalToken {
+	long			lTime;				// Time issued (seconds since Jan 1, 1970)
+	unsigned long	lJournal;			// Journal identification (0 = no journal)
+	long			lOffset;			// Journal size
+} JOURNAL_TOKEN;
+
+// Journal record.
+typedef struct journalEntry {
+	int		iOperation;					// JOURNAL_V_xxx
+	long	lTime;						// Time of the operation (seconds since Jan 1, 1970)
+	char	*pcPath;					// Full path of the file
+	char	*pcNewPath;					// Full path of the renamed file (rename only)
+} JOURNAL_ENTRY;
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+bool  journalAppend( int iOperation, const char *pcPath, const char *pcNewPath );
+void  journalDestroy( LIST **ppList );
+bool  journalEnabled( void );
+char *journalFormat( JOURNAL_TOKEN *pToken, char *pcBuf, size_t iSize );
+bool  journalInit( const char *pcJournal, const char *pcDocRoot );
+bool  journalParse( const char *pcToken, JOURNAL_TOKEN *pToken );
+void  journalPosition( JOURNAL_TOKEN *pToken );
+LIST *journalRead( long lOffset, long lEnd );
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif /* _CBTREE_JOURNAL_H_ */
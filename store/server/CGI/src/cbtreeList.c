@@ -14,7 +14,8 @@
 *	Description:
 *
 *		This modules provides the required functionality to create and maintain
-*		double linked list.
+*		double linked list.  List headers and entries are allocated from the request
+*		arena, if active (see cbtreeArena.c).
 *
 ****************************************************************************************/
 #ifdef _MSC_VER
@@ -23,6 +24,7 @@
 
 #include <stdlib.h>
 
+#include "cbtreeArena.h"
 #include "cbtreeList.h"
 
 /**
@@ -66,10 +68,10 @@ void destroyList( LIST **ppList, DESTROY_DATA func )
 				func( pEntry->pvData );
 			}
 			pNext = pEntry->pNext;
-			free( pEntry );
+			arenaFree( pEntry );
 			pEntry = pNext;
 		}
-		free(*ppList);
+		arenaFree( *ppList );
 		*ppList = NULL;
 	}
 }
@@ -86,7 +88,7 @@ LIST *newList()
 {
 	LIST	*pList;
 	
-	if( (pList = (LIST *)malloc(sizeof(LIST))) )
+	if( (pList = (LIST *)arenaAlloc(sizeof(LIST))) )
 	{
 		pList->pNext  = pList;
 		pList->pPrev  = pList;
@@ -112,7 +114,7 @@ ENTRY *insertHead( void *pMember, LIST *pList )
 {
 	ENTRY	*pEntry;
 
-	if( (pEntry = (ENTRY *)malloc(sizeof(ENTRY))) )
+	if( (pEntry = (ENTRY *)arenaAlloc(sizeof(ENTRY))) )
 	{
 		pList->pNext->pPrev	= pEntry;
 		pEntry->pNext		= pList->pNext;
@@ -141,7 +143,7 @@ ENTRY *insertTail( void *pMember, LIST *pList )
 {
 	ENTRY	*pEntry;
 	
-	if( (pEntry = (ENTRY *)malloc(sizeof(ENTRY))) )
+	if( (pEntry = (ENTRY *)arenaAlloc(sizeof(ENTRY))) )
 	{
 		pEntry->pPrev		= pList->pPrev;
 		pEntry->pNext		= pList;
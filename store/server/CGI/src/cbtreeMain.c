@@ -27,17 +27,24 @@
 *		required to enable the dojo cbtree FileStore and is part of the github project
 *		'cbtree'.
 *
-*		The cbtree FileStore CGI application is invoked by means of a HTTP GET, DELETE
-*		or POST request, the basic ABNF format of a request looks like:
+*		The cbtree FileStore CGI application is invoked by means of a HTTP GET, HEAD,
+*		DELETE or POST request, the basic ABNF format of a request looks like:
 *
 *			HTTP-request  ::= uri ('?' query-string)?
 *			query-string  ::= (qs-param ('&' qs-param)*)?
-*			qs-param	  ::= authToken | basePath | path | query | queryOptions | options 
+*			qs-param	  ::= authToken | basePath | fields | path | query | queryOptions | options |
+*							  start | count | since | sort
 *			authToken	  ::= 'authToken' '=' json-object
 *			basePath	  ::= 'basePath' '=' path-rfc3986
+*			fields		  ::= 'fields' '=' json-array
 *			path		  ::= 'path' '=' path-rfc3986
+*			query		  ::= 'query' '=' json-object
 *			query-options ::= 'queryOptions' '=' json-object
 *			options		  ::= 'options' '=' json-array
+*			start		  ::= 'start' '=' number
+*			count		  ::= 'count' '=' number
+*			since		  ::= 'since' '=' token
+*			sort		  ::= 'sort' '=' (json-object | json-array)
 *
 *		Please refer to http://json.org for the correct JSON encoding of the
 *		parameters.
@@ -61,6 +68,17 @@
 *
 *				root-dir ::= document_root '/' basePath?
 *
+*		fields:
+*
+*			The fields parameter is a JSON array of strings. Each string specifying a
+*			file property to be returned. The supported properties are "name", "path",
+*			"directory", "size" and "modified". If omitted all properties are returned.
+*			Only if "directory" is requested the children of a directory are returned.
+*			If neither "size" nor "modified" is requested the server may not need to
+*			retrieve the file status of each file.
+*
+*				fields=["name","directory"]
+*
 *		path:
 *
 *			The path parameter is used to specify a specific location relative to the
@@ -68,22 +86,90 @@
 *
 *				full-path = root_dir '/' path?
 *
+*		query:
+*
+*			The query parameter is a JSON object of file properties a file must match
+*			to be returned. The supported properties are "name", "size", "modified"
+*			and "directory". The name is either a wildcard pattern ('*' and '?') or
+*			an object with a POSIX extended regular expression ("regex"), both are
+*			matched case insensitive if the ignoreCase query option is set. The size
+*			and modified properties are either a number or a range object with the
+*			optional properties "min" and "max". If directory is true only directories
+*			match, if false only files match. In case of a deep search directories that
+*			do not match themselves are only returned if any of their descendants match.
+*
+*				query={"name":"*.txt", "size":{"min":1}}
+*				query={"name":{"regex":"^img[0-9]+[.]png$"}}&queryOptions={"ignoreCase":true}
+*
 *		queryOptions:
 *
 *			The queryOptions parameter specifies a set of JSON 'property:value' pairs
-*			used during the file search. Currently two properties are supported: "deep"
-*			and "ignoreCase". Property deep indicates if a recursive search is required
-*			whereas ignoreCase indicates if values are to be compared case insensitive/
+*			used during the file search. Currently three properties are supported: "deep",
+*			"depth" and "ignoreCase". Property deep indicates if a recursive search is
+*			required whereas ignoreCase indicates if values are to be compared case
+*			insensitive. Property depth limits a deep search to the given number of
+*			directory levels, directories beyond that level are returned unexpanded
+*			("_EX":false). A depth of zero, the default, means no limit.
 *
 *				queryOptions={"deep":true, "ignorecase":true}
+*				queryOptions={"deep":true, "depth":2}
 *
 *		options:
 *
 *			The options parameter is a JSON array of strings. Each string specifying a
-*			search options to be enabled. Currently the following option is supported:
-*			"showHiddenFiles".
+*			search options to be enabled. Currently the following options are supported:
+*			"showHiddenFiles" and "aggregate". If aggregate is enabled each directory
+*			returned includes the number of files ("files") and the total size of the
+*			files ("bytes") in its entire subtree, regardless of the depth of the search
+*			and the query. Directories are not counted. Files with multiple hard links
+*			are counted once per directory, except when served by the daemon or from a
+*			snapshot. Hidden files are only counted if showHiddenFiles is enabled.
 *
 *				options=["showHiddenFiles"]
+*				options=["aggregate"]
+*
+*		start, count:
+*
+*			The start and count parameters request a range of the children of the
+*			directory identified by path. Only the children start through start+count-1
+*			are returned and the total property of the response is set to the total
+*			number of children in the directory. If start is omitted it defaults to
+*			zero, if count is omitted all remaining children are returned.
+*
+*				path=logs&start=100&count=50
+*
+*		since:
+*
+*			The since parameter requests the changes to the file tree at path since
+*			the change feed token was issued instead of the file tree itself. The
+*			response includes a new token to be used for the next request. Token "0"
+*			returns all files and can be used to obtain the initial token. The items
+*			returned are a flat list of all files and directories modified, renamed
+*			or deleted at or below path. Deleted files have the property "deleted"
+*			set, a modified directory is returned with all its children. Files are
+*			considered modified if their last modified time equals or exceeds the
+*			time the token was issued, therefore a change may be returned twice.
+*			Files deleted or renamed by this application are recorded in the journal
+*			(see CBTREE_JOURNAL), files deleted by other means are only reflected by
+*			the children of their parent directory. If the journal was truncated or
+*			replaced since the token was issued the response is 410 Gone and the
+*			client must reload the file tree.
+*
+*				path=logs&since=6ad27f33-ce800f-62
+*
+*		sort:
+*
+*			The sort parameter is a JSON sort field object or an array of sort field
+*			objects as used by the cbtree FileStore. Each sort field has the properties
+*			"attribute", "descending" and "ignoreCase", only attribute is required. The
+*			children of each directory are sorted by the first sort field, files that
+*			compare equal are sorted by the next sort field and so on. Files that are
+*			equal on all sort fields remain in their natural order. To list directories
+*			before files sort on attribute "directory" in descending order. If a range
+*			of children is requested (start and count) the range is selected after the
+*			children have been sorted.
+*
+*				sort=[{"attribute":"directory","descending":true},{"attribute":"name"}]
 *
 ****************************************************************************************
 *
@@ -98,6 +184,45 @@
 *
 *				CBTREE_BASEPATH /myServer/wide/path
 *
+*		CBTREE_CACHE_DIR
+*
+*			The directory used to cache directory listings between requests. The
+*			cache directory must exist and must be located outside the document
+*			root. A cached listing is used as long as the modification time and
+*			inode of the directory are unchanged, avoiding the need to read the
+*			directory again. The file status of each file is always retrieved from
+*			the file system. If omitted no listings are cached. Example:
+*
+*				CBTREE_CACHE_DIR /var/cache/cbtree
+*
+*		CBTREE_CACHE_SIZE
+*
+*			The size cap of the listing cache in kilobytes, the default is 65536
+*			(64 MB). If the cache grows beyond the cap the oldest listings are
+*			removed. A value of zero means no limit. Example:
+*
+*				CBTREE_CACHE_SIZE 16384
+*
+*		CBTREE_DAEMON_SOCKET
+*
+*			The Unix domain socket of the file store daemon. If set, HTTP GET and
+*			HEAD requests are forwarded to the daemon which answers them from a
+*			resident copy of the file tree. If the daemon is not running the
+*			request is processed as usual. Example:
+*
+*				CBTREE_DAEMON_SOCKET /var/run/cbtree.sock
+*
+*		CBTREE_JOURNAL
+*
+*			The mutation journal of the change feed (query string parameter since).
+*			Every file deleted or renamed by this application is recorded in the
+*			journal. The journal is created if it doesn't exist and must be located
+*			outside the document root, it may be truncated or removed at any time
+*			which invalidates all outstanding change feed tokens. When running the
+*			daemon the same journal must be configured for the daemon. Example:
+*
+*				CBTREE_JOURNAL /var/cache/cbtree/journal
+*
 *		CBTREE_METHODS
 *
 *			A comma separated list of HTTP methods to be supported by the Server
@@ -105,6 +230,26 @@
 *
 *				CBTREE_METHODS GET,DELETE
 *
+*		CBTREE_SNAPSHOT
+*
+*			A file tree snapshot created with the --index argument. Any file within
+*			the file tree of the snapshot is served from the snapshot without
+*			accessing the file system, the children of each directory are returned
+*			sorted by name. The snapshot must be rebuilt whenever the file tree
+*			changes. Example:
+*
+*				CBTREE_SNAPSHOT /var/cache/cbtree/archive.idx
+*
+*		CBTREE_THREADS
+*
+*			The number of threads used to load the directory tree when a deep
+*			search (queryOptions={"deep":true}) or subtree totals (options=
+*			["aggregate"]) are requested, and to delete the content of a directory
+*			tree (HTTP DELETE). By default only a single thread is used, the
+*			maximum is 64. Example:
+*
+*				CBTREE_THREADS 8
+*
 *	Notes:
 *
 *		-	Some HTTP servers require  special configuration to make environment
@@ -132,8 +277,60 @@
 *
 *			http://httpd.apache.org/docs/2.2/howto/cgi.html
 *
+*		All file information collected while processing a request is allocated from
+*		a request arena which is released in a single step at the end of the request
+*		instead of releasing each file individually.
+*
 *	NOTE:	When using this CGI implementation no PHP server support is required.
 *
+*	DAEMON MODE:
+*
+*		On very large file systems the application can also run as a daemon which
+*		holds the entire file tree, rooted at the document root and CBTREE_BASEPATH,
+*		in memory and keeps it current using inotify. To start the daemon run:
+*
+*			DOCUMENT_ROOT=/var/www CBTREE_DAEMON_SOCKET=/var/run/cbtree.sock \
+*				cbtreeFileStore --daemon
+*
+*		and set CBTREE_DAEMON_SOCKET for the CGI application as well. To report
+*		the memory footprint of the resident file tree, per million entries, run
+*		the application with the --tree-stats argument instead. (Linux only)
+*
+*	SNAPSHOTS:
+*
+*		File trees that rarely change, like archives, can be served from a read-only
+*		snapshot instead. To create a snapshot of the file tree at root-dir run:
+*
+*			cbtreeFileStore --index /var/www/archive /var/cache/cbtree/archive.idx
+*
+*		The root-dir must be specified exactly as composed by the application, that
+*		is, document root and basePath, and the snapshot file should be located outside
+*		the document root. Set CBTREE_THREADS to load the file tree using multiple
+*		threads and set CBTREE_SNAPSHOT to use the snapshot. A new snapshot replaces
+*		the previous one atomically.
+*
+*	BATCH REQUESTS:
+*
+*		Multiple files can be deleted and/or renamed with a single HTTP POST request
+*		whose content is a JSON array of operations, or a URL encoded operations
+*		parameter, instead of the path and newValue parameters:
+*
+*			operations	  ::= '[' (operation (',' operation)*)? ']'
+*			operation	  ::= '{' op ',' path (',' newValue)? '}'
+*			op			  ::= '"op"' ':' ('"delete"' | '"rename"')
+*			path		  ::= '"path"' ':' json-string
+*			newValue	  ::= '"newValue"' ':' json-string	(rename only)
+*
+*				[{"op":"delete","path":"logs/old"},{"op":"rename","path":"a.txt","newValue":"b.txt"}]
+*
+*		The operations are executed in order, the root directory is composed only
+*		once. The items of the response are the responses of the operations in the
+*		same order, each with its own total and status. A failing operation doesn't
+*		affect any other operation. Delete operations require the DELETE method to
+*		be allowed (see CBTREE_METHODS), a deleted directory is returned without
+*		its children. The request content is limited to 1 MB and each operation to
+*		4 KB.
+*
 ****************************************************************************************
 *
 *	SECURITY:
@@ -161,19 +358,24 @@
 *		Assuming a valid HTTP GET or DELETE request was received the response to
 *		the client complies with the following ABNF notation:
 *
-*			response	  ::= '{' (totals ',')? (status ',')? file-list '}'
+*			response	  ::= '{' (totals ',')? (status ',')? (token ',')? file-list '}'
 *			totals 		  ::= '"total"' ':' number
 *			status		  ::= '"status"' ':' status-code
 *			status-code	  ::=	'200' | '204' | '401'
+*			token		  ::= '"token"' ':' json-string
 *			file-list	  ::= '"items"' ':' '[' file-info* ']'
 *			file-info	  ::= '{' name ',' path ',' size ',' modified ',' (',' directory)? 
-*								(',' oldPath)? (',' children ',' expanded)? '}'
+*								(',' oldPath)? (',' deleted)? (',' children ',' expanded)?
+*								(',' files ',' bytes)? '}'
 *			name		  ::= '"name"' ':' json-string
 *			path		  ::= '"path"' ':' json-string
 *			size		  ::= '"size"' ':' number
 *			modified	  ::= '"modified"' ':' number
 *			directory	  ::= '"directory"' ':' ('true' | 'false')
 *			oldPath		  ::= '"oldPath"' ':' json-string
+*			deleted		  ::= '"deleted"' ':' 'true'
+*			files		  ::= '"files"' ':' number
+*			bytes		  ::= '"bytes"' ':' number
 *			children	  ::= '[' file-info* ']'
 *			expanded	  ::= '"_EX"' ':' ('true' | 'false')
 *			quoted-string ::= '"' CHAR* '"'
@@ -188,6 +390,22 @@
 *			been searched/expanded yet. The expanded property is typically used
 *			when lazy loading the file store.
 *
+*		-	A GET response carries a weak ETag and, if available, a Last-Modified
+*			header derived from the file or directory requested and the query
+*			string. A conditional GET or HEAD request (If-None-Match or If-Modified-
+*			Since) for an unchanged resource is answered with 304 Not Modified
+*			without reading the directory. A HEAD request returns the headers only.
+*			Because the last modified time of a directory doesn't change when a
+*			file in it is rewritten in place, or when a subdirectory changes, a
+*			directory read from the file system only gets a validator if the
+*			search is not deep and the 'fields', 'query' and 'sort' parameters
+*			need neither the size nor the modified property, that is, the typical
+*			lazy load request for the names of the children. If the file tree is
+*			served by the daemon or from a snapshot every response has a validator.
+*			Limitation: the directory property of a symbolic link is the type of
+*			its target. Retargeting a link from a file to a directory, or vice
+*			versa, does not change the validator of its parent directory.
+*
 ***************************************************************************************/
 #ifdef _MSC_VER
 	#define _CRT_SECURE_NO_WARNINGS
@@ -197,14 +415,20 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "cbtreeArena.h"
 #include "cbtreeArgs.h"
+#include "cbtreeCache.h"
 #include "cbtreeCGI.h"
+#include "cbtreeDaemon.h"
 #include "cbtreeURI.h"
 #include "cbtreeJSON.h"
 #include "cbtreeString.h"
 #include "cbtreeFiles.h"
+#include "cbtreeIndex.h"
+#include "cbtreeJournal.h"
 #include "cbtreeDebug.h"
 #include "cbtree_NP.h"
+#include "cbtreeTree.h"
 
 #define	STORE_C_IDENTIFIER	"path"
 #define STORE_C_LABEL		"name"
@@ -214,26 +438,116 @@ static char	cDbgServer[] = "d:/MyServer/html/";		// For debug purpose only.
 extern FILE	*phResp;		// File handle output stream. (set by cgiInit() )
 
 /**
-*	main
+*	_getFullPath
+*
+*		Compose and normalize the full path of a file relative to the root directory.
+*		The path is handled as a URI path as described in RFC 3986.
+*
+*	@param	pcRootDir		Address C-string containing the root directory.
+*	@param	pcPath			Address C-string containing the path or NULL.
+*	@param	pcFullPath		Address character buffer receiving the full path.
+*	@param	iSize			Size of the full path buffer.
+*
+*	@return		True if the full path is located within the root directory otherwise
+*				false.
+**/
+static bool _getFullPath( char *pcRootDir, const char *pcPath, char *pcFullPath, size_t iSize )
+{
+	char	cTempPath[MAX_PATH_SIZE] = "",
+			cPath[MAX_PATH_SIZE] = "";
+
+	snprintf( cTempPath, sizeof(cTempPath)-1, "./%s", pcPath ? pcPath : "" );
+	snprintf( cPath, sizeof(cPath)-1, "./%s", normalizePath(cTempPath) );
+	strtrim( cPath, TRIM_M_SLASH );
+	
+	snprintf( pcFullPath, iSize-1, "%s/%s", pcRootDir, cPath );
+	strtrim( normalizePath( pcFullPath ), TRIM_M_SLASH );
+
+	return (strncmp( pcRootDir, pcFullPath, strlen(pcRootDir)) == 0);
+}
+
+/**
+*	_batchRequest
+*
+*		Execute the operations of a batch request in order and return the result
+*		of each operation, formatted as the response to the equivalent DELETE or
+*		POST request, as the items of a single response. An operation failing
+*		doesn't affect the remaining operations. A delete operation requires the
+*		HTTP DELETE method to be allowed.
+*
+*	@param	pcRootDir		Address C-string containing the root directory.
+*	@param	pArgs			Address arguments struct
+**/
+static void _batchRequest( char *pcRootDir, ARGS *pArgs )
+{
+	BATCH_OP	*pOp;
+	VECTOR		*pFileList;
+	char		cFullPath[MAX_PATH_SIZE] = "";
+	int			iResult,
+				i;
+
+	fprintf( phResp, "Content-Type: text/json\r\n" );
+	fprintf( phResp, "\r\n" );
+	fprintf( phResp, "{\"total\":%d,\"status\":%d,\"items\":[", pArgs->iBatchCount, HTTP_V_OK );
+	for( i = 0; i < pArgs->iBatchCount; i++ )
+	{
+		pOp		  = &pArgs->pBatch[i];
+		pFileList = NULL;
+		if( !_getFullPath( pcRootDir, pOp->pcPath, cFullPath, sizeof(cFullPath) ) )
+		{
+			iResult = HTTP_V_FORBIDDEN;
+		}
+		else if( !cgiMethodAllowed( pOp->iMethod ) )
+		{
+			iResult = HTTP_V_METHOD_NOT_ALLOWED;
+		}
+		else if( pOp->iMethod == HTTP_V_DELETE )
+		{
+			pFileList = removePath( cFullPath, pcRootDir, pArgs, &iResult );
+		}
+		else
+		{
+			pArgs->pcNewValue = pOp->pcNewValue;
+			pFileList = renameFile( cFullPath, pcRootDir, pArgs, &iResult );
+		}
+		fprintf( phResp, "%s{\"total\":%d,\"status\":%d,\"items\":", (i ? "," : ""),
+				 vectorCount( pFileList ), iResult );
+		jsonWrite( phResp, pFileList, 0 );
+		fprintf( phResp, "}" );
+		cbtDebug( "BATCH %s [%s] %d", (pOp->iMethod == HTTP_V_DELETE ? "DELETE" : "POST"), cFullPath, iResult );
+		destroyFileList( &pFileList );
+	}
+	fprintf( phResp, "]}\r\n" );
+}
+
+/**
+*	_cgiRequest
 *
-*		Main entry point Common Gateway Interface (CGI) application.
+*		Process a single Common Gateway Interface (CGI) request.
 *
 **/
-int main()
+static int _cgiRequest( void )
 {
 	ARGS	*pArgs = NULL;
 	FILE_INFO	*pFileInfo;
-	LIST	*pFileList;
+	VECTOR	*pFileList;
+	SYS_COUNT	*pSysCount;
+	CACHE_COUNT	*pCacheCount;
+	TREE_STATS	*pTreeStats;
+	ARENA_STATS	*pArenaStats;
 	
 	char	cDocRoot[MAX_PATH_SIZE]   = "",
 			cRootDir[MAX_PATH_SIZE]   = "",
 			cFullPath[MAX_PATH_SIZE]  = "",
-			cTempPath[MAX_PATH_SIZE]   = "",
-			cPath[MAX_PATH_SIZE]   = "",
 			cPathEnc[MAX_PATH_SIZE*2] = "";			
-	char	*pcResult;
+	FILE_TAG	sTag;
+	JOURNAL_TOKEN	sToken;
+	char	cETag[32],
+			cToken[64];
+	bool	bExists;
 	int		iMethod,
-			iResult;
+			iResult,
+			iTotal;
 	
 	cgiInit();		// Initialize the CGI environment.
 
@@ -248,6 +562,7 @@ int main()
 	{
 		cgiResponse( HTTP_V_METHOD_NOT_ALLOWED, NULL );
 		cbtDebug( "Invalid method: %d", iMethod );
+		cgiCleanup();
 		return 0;
 	}
 	// Get the application specific arguments and options.
@@ -263,6 +578,8 @@ int main()
 				cgiResponse( iResult, "Undetermined error condition" );
 				break;
 		}
+		cgiCleanup();
+		return 0;
 	}
 
 	/*
@@ -276,6 +593,8 @@ int main()
 	{
 		cgiResponse( HTTP_V_SERVER_ERROR, "CGI environment variables missing." );
 		cbtDebug( "No DOCUMENT_ROOT available." );
+		destroyArguments( &pArgs );
+		cgiCleanup();
 		return 0;
 	}
 	snprintf( cDocRoot, sizeof(cDocRoot)-1, "%s", varGet( cgiGetProperty( "DOCUMENT_ROOT" )) );
@@ -283,48 +602,44 @@ int main()
 	snprintf( cRootDir, sizeof(cRootDir)-1, "%s/%s", cDocRoot, (pArgs->pcBasePath ? pArgs->pcBasePath : "") );
 	strtrim( normalizePath( cRootDir ), (TRIM_M_WSP | TRIM_M_SLASH) );
 
-	snprintf( cTempPath, sizeof(cTempPath)-1, "./%s", pArgs->pcPath ? pArgs->pcPath : "" );
-	snprintf( cPath, sizeof(cPath)-1, "./%s", normalizePath(cTempPath) );
-	strtrim( cPath, TRIM_M_SLASH );
-	
-	snprintf( cFullPath, sizeof(cFullPath)-1, "%s/%s", cRootDir, cPath );
-	strtrim( normalizePath( cFullPath ), TRIM_M_SLASH );
-
 	// Make sure the caller is not backtracking by specifying paths like '../../../../'
-	if( strncmp( cDocRoot, cRootDir, strlen(cDocRoot)) || strncmp( cRootDir, cFullPath, strlen(cRootDir)) )
+	if( strncmp( cDocRoot, cRootDir, strlen(cDocRoot)) || 
+		!_getFullPath( cRootDir, pArgs->pcPath, cFullPath, sizeof(cFullPath) ) )
 	{
 		cgiResponse( HTTP_V_FORBIDDEN, "We're not going there." );
 		destroyArguments( &pArgs );
 		cgiCleanup();
 		return 0;
 	}
+	if( pArgs->pcCacheDir )
+	{
+		cacheInit( pArgs->pcCacheDir, cDocRoot, pArgs->iCacheSize );
+	}
+	if( pArgs->pcSnapshot )
+	{
+		indexOpen( pArgs->pcSnapshot );
+	}
+	if( pArgs->pcJournal )
+	{
+		journalInit( pArgs->pcJournal, cDocRoot );
+	}
+	// All file lists of this request are allocated from the request arena.
+	arenaBegin();
 
 	switch( iMethod )
 	{
 		case HTTP_V_DELETE:
-			// Delete a file or directory
-			if( (pFileList = getFile( cFullPath, cRootDir, pArgs, &iResult )) )
+			// Delete a file or directory, the content of a directory isn't listed first.
+			if( (pFileList = removePath( cFullPath, cRootDir, pArgs, &iResult )) )
 			{
-				pFileInfo = pFileList->pNext->pvData;	// Get first entry in the list
-				pFileList = removeFile( pFileInfo, cRootDir, pArgs, &iResult );
-
-				if( pFileList )
-				{
-					if( (pcResult = jsonEncode(pFileList, 0)) )
-					{
-						fprintf( phResp, "Content-Type: text/json\r\n" );
-						fprintf( phResp, "\r\n" );
-						// Write the body
-						fprintf( phResp, "{\"total\":%d,\"status\":%d,\"items\":%s}\r\n", 
-								 fileCount(pFileList, false), iResult, pcResult );
-						destroy( pcResult );
-					}
-					else
-					{
-						cgiResponse( HTTP_V_SERVER_ERROR, "JSON encoding failed" );
-					}
-					destroyFileList( &pFileList );	// Destroy list AND associated FILE_INFO.
-				}
+				fprintf( phResp, "Content-Type: text/json\r\n" );
+				fprintf( phResp, "\r\n" );
+				// Write the body
+				fprintf( phResp, "{\"total\":%d,\"status\":%d,\"items\":", 
+						 vectorCount( pFileList ), iResult );
+				jsonWrite( phResp, pFileList, 0 );
+				fprintf( phResp, "}\r\n" );
+				destroyFileList( &pFileList );	// Destroy list AND associated FILE_INFO.
 			}
 			else
 			{
@@ -333,26 +648,89 @@ int main()
 			cbtDebug( "DELETE \"%s\" %d", cFullPath, iResult );
 			break;
 
+		case HTTP_V_HEAD:
 		case HTTP_V_GET:
-			pFileList = getFile( cFullPath, cRootDir, pArgs, &iResult );
-			if( pFileList )
+			if( iMethod == HTTP_V_GET && pArgs->pSince )
 			{
-				iResult = listIsEmpty( pFileList ) ? HTTP_V_NO_CONTENT : HTTP_V_OK;
-
-				if( (pcResult = jsonEncode(pFileList, 0)) )
+				// Return the changes since the token was issued and a new token. A token
+				// issued for a previous journal can't be honoured.
+				journalPosition( &sToken );
+				if( pArgs->pSince->lTime && (pArgs->pSince->lJournal != sToken.lJournal || 
+											 pArgs->pSince->lOffset > sToken.lOffset) )
+				{
+					cgiResponse( HTTP_V_GONE, "Change token expired" );
+					break;
+				}
+				if( (pFileList = getChanges( cFullPath, cRootDir, pArgs, sToken.lOffset, &iResult )) )
 				{
-					// Write the header(s)
 					fprintf( phResp, "Content-Type: text/json\r\n" );
 					fprintf( phResp, "\r\n" );
-					// Write the body
-					fprintf( phResp, "{\"total\":%d,\"status\":%d,\"items\":%s}\r\n", 
-							 fileCount(pFileList, false), iResult, pcResult );
-					destroy( pcResult );
+					fprintf( phResp, "{\"total\":%d,\"status\":%d,\"token\":\"%s\",\"items\":", 
+							 vectorCount( pFileList ), iResult, 
+							 journalFormat( &sToken, cToken, sizeof(cToken) ) );
+					jsonWrite( phResp, pFileList, pArgs->iPropMask );
+					fprintf( phResp, "}\r\n" );
+					destroyFileList( &pFileList );
 				}
 				else
 				{
-					cgiResponse( HTTP_V_SERVER_ERROR, "JSON encoding failed" );
+					cgiResponse( HTTP_V_NOT_FOUND, "Invalid path and/or basePath" );
+				}
+				break;
+			}
+			// Answer conditional requests without searching or encoding anything.
+			bExists = getFileTag_NP( cFullPath, varGet( cgiGetProperty("QUERY_STRING") ), 
+									 (pArgs->pOptions->bDeep || pArgs->pOptions->bAggregate), 
+									 pArgs->iNeedMask, &sTag );
+			if( sTag.bValid )
+			{
+				snprintf( cETag, sizeof(cETag), "W/\"%0*lx\"", (int)(sizeof(long) * 2), sTag.lHash );
+				if( cgiNotModified( cETag, sTag.lModified ) )
+				{
+					fprintf( phResp, "Status: 304 Not Modified\r\n" );
+					cgiValidators( cETag, sTag.lModified );
+					fprintf( phResp, "\r\n" );
+					break;
+				}
+			}
+			if( iMethod == HTTP_V_HEAD )
+			{
+				if( bExists )
+				{
+					fprintf( phResp, "Content-Type: text/json\r\n" );
+					cgiValidators( (sTag.bValid ? cETag : NULL), sTag.lModified );
+					fprintf( phResp, "\r\n" );
+				}
+				else
+				{
+					cgiResponse( HTTP_V_NOT_FOUND, NULL );
 				}
+				break;
+			}
+			pFileList = getFile( cFullPath, cRootDir, pArgs, &iResult );
+			if( pFileList )
+			{
+				iResult = vectorIsEmpty( pFileList ) ? HTTP_V_NO_CONTENT : HTTP_V_OK;
+				iTotal	= vectorCount( pFileList );
+
+				// If a range of directory children was requested return the total number
+				// of children instead.
+				if( iResult == HTTP_V_OK && (pArgs->iStart > 0 || pArgs->iCount >= 0) )
+				{
+					pFileInfo = (FILE_INFO *)pFileList->ppvData[0];
+					if( pFileInfo->iPropMask & PROP_M_CHILDREN )
+					{
+						iTotal = pFileInfo->iTotal;
+					}
+				}
+				// Write the header(s)
+				fprintf( phResp, "Content-Type: text/json\r\n" );
+				cgiValidators( (sTag.bValid ? cETag : NULL), sTag.lModified );
+				fprintf( phResp, "\r\n" );
+				// Write the body, the items are streamed while being encoded.
+				fprintf( phResp, "{\"total\":%d,\"status\":%d,\"items\":", iTotal, iResult );
+				jsonWrite( phResp, pFileList, pArgs->iPropMask );
+				fprintf( phResp, "}\r\n" );
 				destroyFileList( &pFileList );	// Destroy list AND associated FILE_INFO.
 			}
 			else
@@ -374,22 +752,21 @@ int main()
 			break;
 
 		case HTTP_V_POST:
+			if( pArgs->pBatch )
+			{
+				_batchRequest( cRootDir, pArgs );
+				break;
+			}
 			pFileList = renameFile( cFullPath, cRootDir, pArgs, &iResult );
 			if( pFileList )
 			{
-				if( (pcResult = jsonEncode(pFileList, 0)) )
-				{
-					fprintf( phResp, "Content-Type: text/json\r\n" );
-					fprintf( phResp, "\r\n" );
-					// Write the body
-					fprintf( phResp, "{\"total\":%d,\"status\":%d,\"items\":%s}\r\n", 
-							 fileCount(pFileList, false), iResult, pcResult );
-					destroy( pcResult );
-				}
-				else
-				{
-					cgiResponse( HTTP_V_SERVER_ERROR, "JSON encoding failed" );
-				}
+				fprintf( phResp, "Content-Type: text/json\r\n" );
+				fprintf( phResp, "\r\n" );
+				// Write the body
+				fprintf( phResp, "{\"total\":%d,\"status\":%d,\"items\":", 
+						 vectorCount( pFileList ), iResult );
+				jsonWrite( phResp, pFileList, 0 );
+				fprintf( phResp, "}\r\n" );
 				destroyFileList( &pFileList );	// Destroy list AND associated FILE_INFO.
 			}
 			else
@@ -399,8 +776,60 @@ int main()
 			cbtDebug( "POST [%s] > [%s]", cFullPath, pArgs->pcNewValue );
 			break;
 	}
+	if( pArgs->pOptions->bDebug )
+	{
+		pSysCount = getSysCount_NP();
+		cbtDebug( "System calls: open: %ld, read: %ld, stat: %ld, stat batches: %ld", 
+				  pSysCount->lOpen, pSysCount->lRead, pSysCount->lStat, pSysCount->lSubmit );
+		if( cacheEnabled() )
+		{
+			pCacheCount = getCacheCount();
+			cbtDebug( "Listing cache: hit: %ld, miss: %ld, write: %ld, trim: %ld",
+					  pCacheCount->lHit, pCacheCount->lMiss, pCacheCount->lWrite, pCacheCount->lTrim );
+		}
+		if( (pTreeStats = treeStats())->lEntries )
+		{
+			cbtDebug( "Resident tree: entries: %ld, bytes: %ld (%ld per million entries), events: %ld",
+					  pTreeStats->lEntries, pTreeStats->lBytes, 
+					  (long)((double)pTreeStats->lBytes * 1000000.0 / pTreeStats->lEntries), pTreeStats->lEvents );
+		}
+		pArenaStats = arenaStats();
+		cbtDebug( "Request arena: blocks: %ld, bytes: %ld", pArenaStats->lBlocks, pArenaStats->lBytes );
+	}
+	arenaEnd();
 	// The END
 	destroyArguments( &pArgs );
 	cgiCleanup();
 	return 0;
 }
+
+/**
+*	main
+*
+*		Main entry point Common Gateway Interface (CGI) application. If invoked
+*		with the --daemon argument the application runs as the file store daemon,
+*		the --tree-stats argument reports the memory footprint of the resident
+*		file tree and the --index argument creates a file tree snapshot.
+*
+**/
+int main( int argc, char *argv[] )
+{
+	if( argc > 1 && !strcmp( argv[1], "--daemon" ) )
+	{
+		return daemonRun( _cgiRequest );
+	}
+	if( argc > 1 && !strcmp( argv[1], "--tree-stats" ) )
+	{
+		return daemonStats();
+	}
+	if( argc > 3 && !strcmp( argv[1], "--index" ) )
+	{
+		return indexBuild( argv[2], argv[3] );
+	}
+	// Let the daemon, if any, answer the request.
+	if( daemonForward() )
+	{
+		return 0;
+	}
+	return _cgiRequest();
+}
@@ -25,6 +25,7 @@
 #include <ctype.h>
 
 #include "cbtreeCommon.h"
+#include "cbtreeArena.h"
 #include "cbtreeString.h"
 
 /**
@@ -176,6 +177,37 @@ bool isQuoted( char *s )
 	return false;
 }
 
+/**
+*	astrncpy
+*
+*		Same as mstrncpy() except that the memory is allocated from the request arena,
+*		if active. The string must be released with arenaFree().
+*
+**/
+char *astrncpy( const char *src, size_t len )
+{
+	char	*b = NULL;
+
+	if( src != NULL )
+	{
+		if( (b = (char *)arenaAlloc( len+1 )) )
+		{
+			memcpy( b, src, len );
+			b[len] = '\0';
+		}
+	}
+	return b;
+}
+
+/**
+*	astrcpy
+*
+**/
+char *astrcpy( const char *src )
+{
+	return (src ? astrncpy( src, strlen(src) ) : NULL );
+}
+
 /**
 *	mstrncpy
 *
@@ -264,6 +296,59 @@ char *strfchr( char *src )
 	return src;
 }
 
+/**
+*	strmatch
+*
+*		Match a string against a wildcard pattern. An asterisk (*) matches any
+*		sequence of characters, a question mark (?) matches any single character
+*		and a backslash (\\) matches the next pattern character literally.
+*
+*	@param	pcPattern		Reference to a zero terminated pattern string
+*	@param	pcString		Reference to a zero terminated string
+*	@param	bIgnoreCase		If true, characters are compared case insensitive.
+*
+*	@return		True if the string matches the pattern otherwise false.
+**/
+bool strmatch( const char *pcPattern, const char *pcString, bool bIgnoreCase )
+{
+	const char	*pcStar = NULL,		// Pattern position following the last asterisk
+				*pcMark = NULL;		// String position matched by the last asterisk
+	char		cPat;
+	int			iLen;
+
+	while( *pcString )
+	{
+		if( *pcPattern == '*' )
+		{
+			pcStar = ++pcPattern;
+			pcMark = pcString;
+			continue;
+		}
+		iLen = (*pcPattern == '\\' && pcPattern[1]) ? 2 : 1;
+		cPat = pcPattern[iLen-1];
+		if( cPat && ((iLen == 1 && cPat == '?') || cPat == *pcString || 
+					 (bIgnoreCase && tolower(cPat) == tolower(*pcString))) )
+		{
+			pcPattern += iLen;
+			pcString++;
+		}
+		else if( pcStar )	// Let the last asterisk match one more character.
+		{
+			pcPattern = pcStar;
+			pcString  = ++pcMark;
+		}
+		else
+		{
+			return false;
+		}
+	}
+	while( *pcPattern == '*' )
+	{
+		pcPattern++;
+	}
+	return (*pcPattern == '\0');
+}
+
 /**
 *	strncpyz
 *
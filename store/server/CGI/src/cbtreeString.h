@@ -23,12 +23,15 @@ bool isBoolean( char *pcSrc, bool *pbValue );
 bool isNumeric( char *pcSrc, long *plValue );
 bool isQuoted( char *s );
 
+char *astrncpy( const char *src, size_t len );
+char *astrcpy( const char *src );
 char *mstrncpy( const char *src, size_t len );
 char *mstrcpy( const char *src );
 
 char *strcap( char *src );
 int strcpair( char *src, int iLvalue, int iRvalue );
 char *strfchr( char *src );
+bool  strmatch( const char *pcPattern, const char *pcString, bool bIgnoreCase );
 char *strncpyz( char *dst, const char *src, size_t len );
 char *strpair( char *src, int iLvalue, int iRvalue );
 char *strtrim( char *src, int flag );
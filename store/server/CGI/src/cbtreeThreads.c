@@ -0,0 +1,444 @@
+/****************************************************************************************
+*	Copyright (c) 2012, Peter Jekel
+*	All rights reserved.
+*
+*	The Checkbox Tree File Store CGI (cbtreeFileStore) is released under to following
+*	license:
+*
+*	    BSD 2-Clause		(http://thejekels.com/cbtree/LICENSE)
+*
+*	@author		Peter Jekel
+*
+****************************************************************************************
+*
+*	Description:
+*
+*		This module provides a small work-stealing task pool. Each worker owns a
+*		double ended task queue (deque). A worker pushes and pops tasks at the
+*		bottom of its own deque, idle workers steal tasks from the top of the
+*		deques of other workers. Tasks may push new tasks while being executed,
+*		the pool is done when all tasks, including the ones pushed by other tasks,
+*		have completed.
+*
+*		The calling thread always participates as worker 0, therefore a pool with
+*		only one worker does not create any additional threads.
+*
+****************************************************************************************/
+#ifdef _MSC_VER
+	#define _CRT_SECURE_NO_WARNINGS
+#endif	/* _MSC_VER */
+
+#include <stdlib.h>
+#ifdef WIN32
+  #include <windows.h>
+  #include <process.h>
+#else
+  #include <pthread.h>
+#endif /* WIN32 */
+
+#include "cbtreeThreads.h"
+
+#ifdef WIN32
+  typedef CRITICAL_SECTION		MUTEX;
+  typedef CONDITION_VARIABLE	COND;
+  typedef HANDLE				THREAD;
+
+  #define mutexInit(m)			InitializeCriticalSection(m)
+  #define mutexDestroy(m)		DeleteCriticalSection(m)
+  #define mutexLock(m)			EnterCriticalSection(m)
+  #define mutexUnlock(m)		LeaveCriticalSection(m)
+  #define condInit(c)			InitializeConditionVariable(c)
+  #define condDestroy(c)
+  #define condWait(c,m)			SleepConditionVariableCS((c),(m),INFINITE)
+  #define condSignal(c)			WakeConditionVariable(c)
+  #define condBroadcast(c)		WakeAllConditionVariable(c)
+#else
+  typedef pthread_mutex_t		MUTEX;
+  typedef pthread_cond_t		COND;
+  typedef pthread_t				THREAD;
+
+  #define mutexInit(m)			pthread_mutex_init((m), NULL)
+  #define mutexDestroy(m)		pthread_mutex_destroy(m)
+  #define mutexLock(m)			pthread_mutex_lock(m)
+  #define mutexUnlock(m)		pthread_mutex_unlock(m)
+  #define condInit(c)			pthread_cond_init((c), NULL)
+  #define condDestroy(c)		pthread_cond_destroy(c)
+  #define condWait(c,m)			pthread_cond_wait((c),(m))
+  #define condSignal(c)			pthread_cond_signal(c)
+  #define condBroadcast(c)		pthread_cond_broadcast(c)
+#endif /* WIN32 */
+
+#define DEQUE_SIZE		64			// Initial number of deque slots.
+
+typedef struct taskDeque {
+	MUTEX		lock;
+	void		**ppvTasks;			// Circular task buffer
+	int			iSize;				// Number of slots in the task buffer
+	int			iTop;				// Index of the top (oldest) task
+	int			iCount;				// Number of queued tasks
+} TASK_DEQUE;
+
+typedef struct worker {
+	TASK_POOL	*pPool;
+	int			iWorker;			// Worker index (0 = calling thread)
+	THREAD		thread;
+	bool		bStarted;
+} WORKER;
+
+struct taskPool {
+	TASK_FUNC	pFunc;				// Task function
+	void		*pvArg;				// Argument shared by all tasks
+	int			iThreads;			// Number of workers
+	TASK_DEQUE	*pDeques;			// One deque per worker
+	WORKER		*pWorkers;
+	MUTEX		lock;				// Protects the counters below.
+	COND		cond;				// Signaled when tasks are queued or all are done.
+	long		lPending;			// Tasks pushed but not yet completed.
+	long		lQueued;			// Tasks currently sitting in a deque.
+	bool		bDone;
+};
+
+/**
+*	_dequePop
+*
+*		Take the most recently pushed task from the bottom of a deque. Only the
+*		worker owning the deque pops tasks.
+*
+*	@param	pDeque			Address TASK_DEQUE struct.
+*
+*	@return		Address of the task or NULL if the deque is empty.
+**/
+static void *_dequePop( TASK_DEQUE *pDeque )
+{
+	void	*pvTask = NULL;
+
+	mutexLock( &pDeque->lock );
+	if( pDeque->iCount > 0 )
+	{
+		pDeque->iCount--;
+		pvTask = pDeque->ppvTasks[(pDeque->iTop + pDeque->iCount) % pDeque->iSize];
+	}
+	mutexUnlock( &pDeque->lock );
+	return pvTask;
+}
+
+/**
+*	_dequePush
+*
+*		Push a task at the bottom of a deque. The deque is extended if it is full.
+*
+*	@param	pDeque			Address TASK_DEQUE struct.
+*	@param	pvTask			Address of the task.
+*
+*	@return		True on success otherwise false (out of memory).
+**/
+static bool _dequePush( TASK_DEQUE *pDeque, void *pvTask )
+{
+	void	**ppvTasks;
+	int		i;
+
+	mutexLock( &pDeque->lock );
+	if( pDeque->iCount == pDeque->iSize )
+	{
+		if( !(ppvTasks = (void **)malloc( 2 * pDeque->iSize * sizeof(void *) )) )
+		{
+			mutexUnlock( &pDeque->lock );
+			return false;
+		}
+		// Unwrap the circular buffer.
+		for( i = 0; i < pDeque->iCount; i++ )
+		{
+			ppvTasks[i] = pDeque->ppvTasks[(pDeque->iTop + i) % pDeque->iSize];
+		}
+		free( pDeque->ppvTasks );
+		pDeque->ppvTasks = ppvTasks;
+		pDeque->iSize	*= 2;
+		pDeque->iTop	 = 0;
+	}
+	pDeque->ppvTasks[(pDeque->iTop + pDeque->iCount) % pDeque->iSize] = pvTask;
+	pDeque->iCount++;
+	mutexUnlock( &pDeque->lock );
+	return true;
+}
+
+/**
+*	_dequeSteal
+*
+*		Take the oldest task from the top of a deque. Being the oldest, the task is
+*		likely to represent the largest amount of remaining work.
+*
+*	@param	pDeque			Address TASK_DEQUE struct.
+*
+*	@return		Address of the task or NULL if the deque is empty.
+**/
+static void *_dequeSteal( TASK_DEQUE *pDeque )
+{
+	void	*pvTask = NULL;
+
+	mutexLock( &pDeque->lock );
+	if( pDeque->iCount > 0 )
+	{
+		pvTask = pDeque->ppvTasks[pDeque->iTop];
+		pDeque->iTop = (pDeque->iTop + 1) % pDeque->iSize;
+		pDeque->iCount--;
+	}
+	mutexUnlock( &pDeque->lock );
+	return pvTask;
+}
+
+/**
+*	_taskNext
+*
+*		Get the next task for a worker. The worker's own deque is tried first, if
+*		empty a task is stolen from any of the other workers.
+*
+*	@param	pPool			Address TASK_POOL struct.
+*	@param	iWorker			Worker index.
+*
+*	@return		Address of the task or NULL if no task is available.
+**/
+static void *_taskNext( TASK_POOL *pPool, int iWorker )
+{
+	void	*pvTask;
+	int		i;
+
+	if( !(pvTask = _dequePop( &pPool->pDeques[iWorker] )) )
+	{
+		for( i = 1; i < pPool->iThreads && !pvTask; i++ )
+		{
+			pvTask = _dequeSteal( &pPool->pDeques[(iWorker + i) % pPool->iThreads] );
+		}
+	}
+	if( pvTask )
+	{
+		mutexLock( &pPool->lock );
+		pPool->lQueued--;
+		mutexUnlock( &pPool->lock );
+	}
+	return pvTask;
+}
+
+/**
+*	_taskWorker
+*
+*		Main worker loop. Tasks are executed until all tasks in the pool have been
+*		completed. An idle worker sleeps until new tasks are queued.
+*
+*	@param	pWorker			Address WORKER struct.
+**/
+static void _taskWorker( WORKER *pWorker )
+{
+	TASK_POOL	*pPool = pWorker->pPool;
+	void		*pvTask;
+
+	for(;;)
+	{
+		if( (pvTask = _taskNext( pPool, pWorker->iWorker )) )
+		{
+			pPool->pFunc( pPool, pWorker->iWorker, pPool->pvArg, pvTask );
+
+			mutexLock( &pPool->lock );
+			if( --pPool->lPending == 0 )
+			{
+				pPool->bDone = true;
+				condBroadcast( &pPool->cond );
+			}
+			mutexUnlock( &pPool->lock );
+		}
+		else
+		{
+			mutexLock( &pPool->lock );
+			while( !pPool->bDone && pPool->lQueued == 0 )
+			{
+				condWait( &pPool->cond, &pPool->lock );
+			}
+			if( pPool->bDone )
+			{
+				mutexUnlock( &pPool->lock );
+				break;
+			}
+			mutexUnlock( &pPool->lock );
+		}
+	}
+}
+
+#ifdef WIN32
+static unsigned __stdcall _taskThread( void *pvWorker )
+{
+	_taskWorker( (WORKER *)pvWorker );
+	return 0;
+}
+#else
+static void *_taskThread( void *pvWorker )
+{
+	_taskWorker( (WORKER *)pvWorker );
+	return NULL;
+}
+#endif /* WIN32 */
+
+/**
+*	destroyTaskPool
+*
+*		Release all resources associated with a task pool.
+*
+*	@param	ppPool			Address of a pointer of type TASK_POOL.
+**/
+void destroyTaskPool( TASK_POOL **ppPool )
+{
+	TASK_POOL	*pPool;
+	int			i;
+
+	if( ppPool && (pPool = *ppPool) )
+	{
+		for( i = 0; i < pPool->iThreads; i++ )
+		{
+			mutexDestroy( &pPool->pDeques[i].lock );
+			free( pPool->pDeques[i].ppvTasks );
+		}
+		mutexDestroy( &pPool->lock );
+		condDestroy( &pPool->cond );
+		free( pPool->pDeques );
+		free( pPool->pWorkers );
+		free( pPool );
+		*ppPool = NULL;
+	}
+}
+
+/**
+*	newTaskPool
+*
+*		Create a new task pool. The number of workers is limited to MAX_THREADS.
+*		No threads are started until taskRun() is called.
+*
+*	@param	iThreads		Number of workers, including the calling thread.
+*	@param	pFunc			Address task function called once for each task.
+*	@param	pvArg			Argument passed to every invocation of pFunc.
+*
+*	@return		Address TASK_POOL struct or NULL in case of an error.
+**/
+TASK_POOL *newTaskPool( int iThreads, TASK_FUNC pFunc, void *pvArg )
+{
+	TASK_POOL	*pPool;
+	int			i;
+
+	iThreads = (iThreads < 1 ? 1 : (iThreads > MAX_THREADS ? MAX_THREADS : iThreads));
+
+	if( (pPool = (TASK_POOL *)calloc(1, sizeof(TASK_POOL))) )
+	{
+		pPool->pDeques	= (TASK_DEQUE *)calloc( iThreads, sizeof(TASK_DEQUE) );
+		pPool->pWorkers = (WORKER *)calloc( iThreads, sizeof(WORKER) );
+		if( !pPool->pDeques || !pPool->pWorkers )
+		{
+			free( pPool->pDeques );
+			free( pPool->pWorkers );
+			free( pPool );
+			return NULL;
+		}
+		pPool->pFunc	= pFunc;
+		pPool->pvArg	= pvArg;
+		pPool->iThreads = iThreads;
+		mutexInit( &pPool->lock );
+		condInit( &pPool->cond );
+
+		for( i = 0; i < iThreads; i++ )
+		{
+			mutexInit( &pPool->pDeques[i].lock );
+			pPool->pDeques[i].ppvTasks = (void **)malloc( DEQUE_SIZE * sizeof(void *) );
+			pPool->pDeques[i].iSize	   = DEQUE_SIZE;
+			pPool->pWorkers[i].pPool   = pPool;
+			pPool->pWorkers[i].iWorker = i;
+			if( !pPool->pDeques[i].ppvTasks )
+			{
+				pPool->iThreads = i + 1;
+				destroyTaskPool( &pPool );
+				return NULL;
+			}
+		}
+	}
+	return pPool;
+}
+
+/**
+*	taskPush
+*
+*		Queue a new task on the deque of a worker. Tasks can be pushed before the
+*		pool is run or by a task function while the pool is running, in the latter
+*		case iWorker must be the worker index passed to the task function.
+*
+*	@param	pPool			Address TASK_POOL struct.
+*	@param	iWorker			Worker index.
+*	@param	pvTask			Address of the task.
+*
+*	@return		True on success otherwise false in which case the caller is
+*				responsible for executing the task.
+**/
+bool taskPush( TASK_POOL *pPool, int iWorker, void *pvTask )
+{
+	// Count the task as pending BEFORE anyone can steal and complete it.
+	mutexLock( &pPool->lock );
+	pPool->lPending++;
+	mutexUnlock( &pPool->lock );
+
+	if( !_dequePush( &pPool->pDeques[iWorker], pvTask ) )
+	{
+		mutexLock( &pPool->lock );
+		pPool->lPending--;
+		mutexUnlock( &pPool->lock );
+		return false;
+	}
+
+	mutexLock( &pPool->lock );
+	pPool->lQueued++;
+	condSignal( &pPool->cond );
+	mutexUnlock( &pPool->lock );
+	return true;
+}
+
+/**
+*	taskRun
+*
+*		Run all tasks in the pool. The calling thread runs as worker 0 and the
+*		function returns after all tasks have completed. If a thread can not be
+*		started the remaining workers will process its share of the tasks.
+*
+*	@param	pPool			Address TASK_POOL struct.
+**/
+void taskRun( TASK_POOL *pPool )
+{
+	WORKER	*pWorker;
+	int		i;
+
+	if( pPool->lPending == 0 )
+	{
+		return;
+	}
+	pPool->bDone = false;
+
+	for( i = 1; i < pPool->iThreads; i++ )
+	{
+		pWorker = &pPool->pWorkers[i];
+#ifdef WIN32
+		pWorker->thread	  = (HANDLE)_beginthreadex( NULL, 0, _taskThread, pWorker, 0, NULL );
+		pWorker->bStarted = (pWorker->thread != 0);
+#else
+		pWorker->bStarted = !pthread_create( &pWorker->thread, NULL, _taskThread, pWorker );
+#endif /* WIN32 */
+	}
+
+	_taskWorker( &pPool->pWorkers[0] );
+
+	for( i = 1; i < pPool->iThreads; i++ )
+	{
+		pWorker = &pPool->pWorkers[i];
+		if( pWorker->bStarted )
+		{
+#ifdef WIN32
+			WaitForSingleObject( pWorker->thread, INFINITE );
+			CloseHandle( pWorker->thread );
+#else
+			pthread_join( pWorker->thread, NULL );
+#endif /* WIN32 */
+			pWorker->bStarted = false;
+		}
+	}
+}
@@ -0,0 +1,25 @@
+#ifndef _CBTREE_THREADS_H_
+#define _CBTREE_THREADS_H_
+
+#include "cbtreeCommon.h"
+
+#define MAX_THREADS		64			// Maximum number of worker threads.
+
+typedef struct taskPool TASK_POOL;
+
+typedef void (*TASK_FUNC)( TASK_POOL *pPool, int iWorker, void *pvArg, void *pvTask );
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+void		destroyTaskPool( TASK_POOL **ppPool );
+TASK_POOL  *newTaskPool( int iThreads, TASK_FUNC pFunc, void *pvArg );
+bool		taskPush( TASK_POOL *pPool, int iWorker, void *pvTask );
+void		taskRun( TASK_POOL *pPool );
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif /* _CBTREE_THREADS_H_ */
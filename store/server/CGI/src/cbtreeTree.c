@@ -0,0 +1,634 @@
+/****************************************************************************************
+*	Copyright (c) 2012, Peter Jekel
+*	All rights reserved.
+*
+*	The Checkbox Tree File Store CGI (cbtreeFileStore) is released under to following
+*	license:
+*
+*	    BSD 2-Clause		(http://thejekels.com/cbtree/LICENSE)
+*
+*	@author		Peter Jekel
+*
+****************************************************************************************
+*
+*	Description:
+*
+*		This module maintains a resident copy of a file tree in memory. The tree
+*		is loaded once and kept current using inotify, every resident directory
+*		has an inotify watch and any change notification is applied to the tree
+*		as it is received (see treeUpdate()). The resident tree is used by the
+*		daemon mode of the file store (see cbtreeDaemon.c) to answer requests
+*		without accessing the file system.
+*
+*		The children of a directory are kept in the order in which they were read
+*		from the file system, new files are appended. As a result, the resident
+*		tree returns the same file order as a directory search does.
+*
+*		Symbolic links to directories are not followed and directories for which
+*		no watch could be added, for example because the inotify watch limit was
+*		reached, are not resident. The content of those directories is always
+*		retrieved from the file system.
+*
+*	NOTE:	The resident file tree is only available on Linux.
+*
+****************************************************************************************/
+#ifdef _MSC_VER
+	#define _CRT_SECURE_NO_WARNINGS
+#endif	/* _MSC_VER */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <time.h>
+#ifdef __linux__
+  #include <dirent.h>
+  #include <errno.h>
+  #include <unistd.h>
+  #include <sys/inotify.h>
+  #include <sys/stat.h>
+#endif /* __linux__ */
+
+#include "cbtreeTree.h"
+#include "cbtreeDebug.h"
+#include "cbtreeString.h"
+
+#ifdef __linux__
+#define TREE_EVENT_MASK		(IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB | \
+							 IN_MODIFY | IN_CLOSE_WRITE | IN_DONT_FOLLOW | IN_ONLYDIR)
+#define TREE_EVENT_BUF		65536		// Size of the inotify event buffer.
+
+static TREE_NODE	*pTreeRoot = NULL;
+static TREE_NODE	**ppWatches = NULL;		// Nodes indexed by watch descriptor.
+static int			iWatchSize = 0;
+static int			iNotifyFd  = -1;
+static char			cTreeRoot[MAX_PATH_SIZE];
+static size_t		iTreeRootLen = 0;
+#endif /* __linux__ */
+
+static TREE_STATS	treeStat = { 0, 0, 0, 0, 0 };
+
+#ifdef __linux__
+/**
+*	_nodeNew
+*
+*		Allocate a new tree node.
+*
+*	@param	pcName			Address C-string containing the filename.
+*	@param	pParent			Address parent TREE_NODE struct or NULL.
+*
+*	@return		On success the address of a TREE_NODE struct otherwise NULL
+**/
+static TREE_NODE *_nodeNew( const char *pcName, TREE_NODE *pParent )
+{
+	TREE_NODE	*pNode;
+	size_t		iSize = offsetof(TREE_NODE, cName) + strlen( pcName ) + 1;
+
+	if( (pNode = (TREE_NODE *)calloc( 1, iSize )) )
+	{
+		strcpy( pNode->cName, pcName );
+		pNode->pParent = pParent;
+		pNode->iWatch  = -1;
+
+		treeStat.lBytes += iSize;
+		treeStat.lEntries++;
+	}
+	return pNode;
+}
+
+/**
+*	_nodeFree
+*
+*		Release a tree node and all its descendants. The inotify watches of all
+*		resident directories released are removed.
+*
+*	@param	pNode			Address TREE_NODE struct.
+**/
+static void _nodeFree( TREE_NODE *pNode )
+{
+	int		i;
+
+	if( pNode )
+	{
+		for( i = 0; i < pNode->iCount; i++ )
+		{
+			_nodeFree( pNode->ppChildren[i] );
+		}
+		if( pNode->iWatch != -1 )
+		{
+			inotify_rm_watch( iNotifyFd, pNode->iWatch );
+			ppWatches[pNode->iWatch] = NULL;
+			treeStat.lDirectories--;
+		}
+		treeStat.lBytes -= offsetof(TREE_NODE, cName) + strlen( pNode->cName ) + 1;
+		treeStat.lBytes -= pNode->iSize * sizeof(TREE_NODE *);
+		treeStat.lEntries--;
+
+		free( pNode->ppChildren );
+		free( pNode );
+	}
+}
+
+/**
+*	_nodePath
+*
+*		Compose the full path of a tree node.
+*
+*	@param	pNode			Address TREE_NODE struct.
+*	@param	pcPath			Address character buffer receiving the path.
+*	@param	iSize			Size of the character buffer.
+*
+*	@return		Length of the path or -1 if the path doesn't fit.
+**/
+static int _nodePath( TREE_NODE *pNode, char *pcPath, size_t iSize )
+{
+	int		iLen;
+
+	if( !pNode->pParent )
+	{
+		return (iTreeRootLen < iSize) ? (int)strlen( strcpy( pcPath, cTreeRoot ) ) : -1;
+	}
+	if( (iLen = _nodePath( pNode->pParent, pcPath, iSize )) == -1 ||
+		iLen + strlen( pNode->cName ) + 2 > iSize )
+	{
+		return -1;
+	}
+	pcPath[iLen++] = '/';
+	strcpy( &pcPath[iLen], pNode->cName );
+	return iLen + (int)strlen( pNode->cName );
+}
+
+/**
+*	_nodeStat
+*
+*		Get the file status of a tree node. If the file is a symbolic link the
+*		status of the link target is used, in case the link is broken the status
+*		of the link itself is used.
+*
+*	@param	pNode			Address TREE_NODE struct.
+*	@param	pcPath			Address C-string containing the full path of the node.
+*	@param	pbLink			Address boolean receiving true if the file is a symbolic
+*							link, or NULL.
+*
+*	@return		True if successful otherwise false.
+**/
+static bool _nodeStat( TREE_NODE *pNode, const char *pcPath, bool *pbLink )
+{
+	struct stat	sStat,
+				sLink;
+
+	if( lstat( pcPath, &sStat ) )
+	{
+		return false;
+	}
+	if( pbLink )
+	{
+		*pbLink = S_ISLNK( sStat.st_mode ) ? true : false;
+	}
+	if( S_ISLNK( sStat.st_mode ) && !stat( pcPath, &sLink ) )
+	{
+		sStat = sLink;
+	}
+	pNode->directory = S_ISDIR( sStat.st_mode ) ? true : false;
+	pNode->lSize	 = (long)sStat.st_size;
+	pNode->lModified = (long)sStat.st_mtime;
+	return true;
+}
+
+/**
+*	_nodeFind
+*
+*		Returns the index of the child of a directory node with the given name.
+*
+*	@param	pNode			Address TREE_NODE struct of the directory.
+*	@param	pcName			Address of the filename.
+*	@param	iLen			Length of the filename.
+*
+*	@return		Index of the child or -1 if there is no such child.
+**/
+static int _nodeFind( TREE_NODE *pNode, const char *pcName, size_t iLen )
+{
+	TREE_NODE	*pChild;
+	int			i;
+
+	for( i = 0; i < pNode->iCount; i++ )
+	{
+		pChild = pNode->ppChildren[i];
+		if( pChild->cName[0] == pcName[0] && !strncmp( pChild->cName, pcName, iLen ) &&
+			!pChild->cName[iLen] )
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+/**
+*	_nodeAttach
+*
+*		Append a child to a directory node.
+*
+*	@param	pNode			Address TREE_NODE struct of the directory.
+*	@param	pChild			Address TREE_NODE struct of the child.
+*
+*	@return		True if successful otherwise false.
+**/
+static bool _nodeAttach( TREE_NODE *pNode, TREE_NODE *pChild )
+{
+	void	*pvNew;
+	int		iSize;
+
+	if( pNode->iCount == pNode->iSize )
+	{
+		iSize = pNode->iSize ? pNode->iSize * 2 : 4;
+		if( !(pvNew = realloc( pNode->ppChildren, iSize * sizeof(TREE_NODE *) )) )
+		{
+			return false;
+		}
+		treeStat.lBytes += (iSize - pNode->iSize) * sizeof(TREE_NODE *);
+		pNode->ppChildren = (TREE_NODE **)pvNew;
+		pNode->iSize	  = iSize;
+	}
+	pNode->ppChildren[pNode->iCount++] = pChild;
+	return true;
+}
+
+/**
+*	_nodeWatch
+*
+*		Add an inotify watch for a directory node making the directory content
+*		resident.
+*
+*	@param	pNode			Address TREE_NODE struct of the directory.
+*	@param	pcPath			Address C-string containing the full path of the node.
+*
+*	@return		True if successful otherwise false.
+**/
+static bool _nodeWatch( TREE_NODE *pNode, const char *pcPath )
+{
+	void	*pvNew;
+	int		iWatch,
+			iSize;
+
+	if( (iWatch = inotify_add_watch( iNotifyFd, pcPath, TREE_EVENT_MASK )) == -1 )
+	{
+		if( errno == ENOSPC )
+		{
+			cbtDebug( "Resident tree: inotify watch limit reached at [%s]", pcPath );
+		}
+		return false;
+	}
+	if( iWatch >= iWatchSize )
+	{
+		iSize = iWatchSize ? iWatchSize * 2 : 1024;
+		while( iSize <= iWatch )
+		{
+			iSize *= 2;
+		}
+		if( !(pvNew = realloc( ppWatches, iSize * sizeof(TREE_NODE *) )) )
+		{
+			inotify_rm_watch( iNotifyFd, iWatch );
+			return false;
+		}
+		ppWatches = (TREE_NODE **)pvNew;
+		memset( &ppWatches[iWatchSize], 0, (iSize - iWatchSize) * sizeof(TREE_NODE *) );
+		treeStat.lBytes += (iSize - iWatchSize) * sizeof(TREE_NODE *);
+		iWatchSize = iSize;
+	}
+	ppWatches[iWatch] = pNode;
+	pNode->iWatch	  = iWatch;
+	treeStat.lDirectories++;
+	return true;
+}
+
+/**
+*	_nodeScan
+*
+*		Load the content of a directory node. The directory is watched before it
+*		is read so no change can be missed. All subdirectories, except symbolic
+*		links to directories, are loaded recursively.
+*
+*	@param	pNode			Address TREE_NODE struct of the directory.
+*	@param	pcPath			Address C-string containing the full path of the node.
+**/
+static void _nodeScan( TREE_NODE *pNode, const char *pcPath )
+{
+	struct dirent	*pDirEnt;
+	TREE_NODE		*pChild;
+	DIR				*pDir;
+	char			cPath[MAX_PATH_SIZE];
+	bool			bLink;
+
+	if( !_nodeWatch( pNode, pcPath ) )
+	{
+		return;
+	}
+	if( (pDir = opendir( pcPath )) )
+	{
+		while( (pDirEnt = readdir( pDir )) )
+		{
+			if( !strcmp( pDirEnt->d_name, "." ) || !strcmp( pDirEnt->d_name, ".." ) ||
+				snprintf( cPath, sizeof(cPath), "%s/%s", pcPath, pDirEnt->d_name ) >= (int)sizeof(cPath) )
+			{
+				continue;
+			}
+			if( (pChild = _nodeNew( pDirEnt->d_name, pNode )) )
+			{
+				if( !_nodeStat( pChild, cPath, &bLink ) || !_nodeAttach( pNode, pChild ) )
+				{
+					_nodeFree( pChild );
+					continue;
+				}
+				if( pChild->directory && !bLink )
+				{
+					_nodeScan( pChild, cPath );
+				}
+			}
+		}
+		closedir( pDir );
+	}
+}
+
+/**
+*	_nodeAdd
+*
+*		Add or refresh the child of a directory node after a file was created,
+*		moved into the directory or modified.
+*
+*	@param	pNode			Address TREE_NODE struct of the directory.
+*	@param	pcName			Address C-string containing the filename.
+*	@param	bCreated		True if the file was created or moved into the directory.
+**/
+static void _nodeAdd( TREE_NODE *pNode, const char *pcName, bool bCreated )
+{
+	TREE_NODE	*pChild;
+	char		cPath[MAX_PATH_SIZE];
+	bool		bLink;
+	int			iLen,
+				iIndex;
+
+	if( (iLen = _nodePath( pNode, cPath, sizeof(cPath) )) == -1 ||
+		iLen + strlen( pcName ) + 2 > sizeof(cPath) )
+	{
+		return;
+	}
+	cPath[iLen++] = '/';
+	strcpy( &cPath[iLen], pcName );
+
+	if( (iIndex = _nodeFind( pNode, pcName, strlen(pcName) )) != -1 )
+	{
+		pChild = pNode->ppChildren[iIndex];
+		if( !bCreated )
+		{
+			_nodeStat( pChild, cPath, NULL );
+			return;
+		}
+		// The file was replaced, drop the old node.
+		_nodeFree( pChild );
+		memmove( &pNode->ppChildren[iIndex], &pNode->ppChildren[iIndex+1],
+				 (pNode->iCount - iIndex - 1) * sizeof(TREE_NODE *) );
+		pNode->iCount--;
+	}
+	if( (pChild = _nodeNew( pcName, pNode )) )
+	{
+		if( !_nodeStat( pChild, cPath, &bLink ) || !_nodeAttach( pNode, pChild ) )
+		{
+			_nodeFree( pChild );
+			return;
+		}
+		if( pChild->directory && !bLink )
+		{
+			_nodeScan( pChild, cPath );
+		}
+	}
+}
+
+/**
+*	_nodeRemove
+*
+*		Remove the child of a directory node after a file was deleted or moved
+*		out of the directory.
+*
+*	@param	pNode			Address TREE_NODE struct of the directory.
+*	@param	pcName			Address C-string containing the filename.
+**/
+static void _nodeRemove( TREE_NODE *pNode, const char *pcName )
+{
+	int		iIndex;
+
+	if( (iIndex = _nodeFind( pNode, pcName, strlen(pcName) )) != -1 )
+	{
+		_nodeFree( pNode->ppChildren[iIndex] );
+		memmove( &pNode->ppChildren[iIndex], &pNode->ppChildren[iIndex+1],
+				 (pNode->iCount - iIndex - 1) * sizeof(TREE_NODE *) );
+		pNode->iCount--;
+	}
+}
+
+/**
+*	_treeLoad
+*
+*		(Re)load the entire resident tree.
+**/
+static void _treeLoad( void )
+{
+	_nodeFree( pTreeRoot );
+	treeStat.lLoaded = (long)time(NULL);
+	if( (pTreeRoot = _nodeNew( ".", NULL )) )
+	{
+		if( _nodeStat( pTreeRoot, cTreeRoot, NULL ) && pTreeRoot->directory )
+		{
+			_nodeScan( pTreeRoot, cTreeRoot );
+		}
+	}
+}
+#endif /* __linux__ */
+
+/**
+*	treeDestroy
+*
+*		Release the resident tree and stop watching the file system.
+**/
+void treeDestroy( void )
+{
+#ifdef __linux__
+	_nodeFree( pTreeRoot );
+	pTreeRoot = NULL;
+	if( iNotifyFd != -1 )
+	{
+		close( iNotifyFd );
+		iNotifyFd = -1;
+	}
+	treeStat.lBytes -= iWatchSize * sizeof(TREE_NODE *);
+	free( ppWatches );
+	ppWatches  = NULL;
+	iWatchSize = 0;
+#endif /* __linux__ */
+}
+
+/**
+*	treeEventFd
+*
+*		Returns the file descriptor on which change notifications are received.
+*		The caller must call treeUpdate() whenever the descriptor is readable.
+*
+*	@return		File descriptor or -1 if there is no resident tree.
+**/
+int treeEventFd( void )
+{
+#ifdef __linux__
+	return iNotifyFd;
+#else
+	return -1;
+#endif /* __linux__ */
+}
+
+/**
+*	treeInit
+*
+*		Load the file tree rooted at pcRootDir into memory and start watching it
+*		for changes.
+*
+*	@param	pcRootDir		Address C-string containing the root directory.
+*
+*	@return		True if successful otherwise false.
+**/
+bool treeInit( const char *pcRootDir )
+{
+#ifdef __linux__
+	if( (iTreeRootLen = strlen( pcRootDir )) >= sizeof(cTreeRoot) ||
+		(iNotifyFd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC )) == -1 )
+	{
+		return false;
+	}
+	strcpy( cTreeRoot, pcRootDir );
+	_treeLoad();
+	return (pTreeRoot && pTreeRoot->iWatch != -1);
+#else
+	(void)pcRootDir;
+	return false;
+#endif /* __linux__ */
+}
+
+/**
+*	treeLookup
+*
+*		Returns the resident tree node of a file. A node is only returned if all
+*		its ancestors are resident. If the node is a directory, its content is
+*		only resident if the node's iWatch is not -1.
+*
+*	@param	pcFullPath		Address C-string containing the full path.
+*
+*	@return		Address TREE_NODE struct or NULL if the file is not resident.
+**/
+TREE_NODE *treeLookup( const char *pcFullPath )
+{
+#ifdef __linux__
+	TREE_NODE	*pNode = pTreeRoot;
+	const char	*pcSegm = &pcFullPath[iTreeRootLen];
+	size_t		iLen;
+	int			iIndex;
+
+	if( !pNode || strncmp( pcFullPath, cTreeRoot, iTreeRootLen ) || (*pcSegm && *pcSegm != '/') )
+	{
+		return NULL;
+	}
+	while( *pcSegm )
+	{
+		pcSegm += strspn( pcSegm, "/" );
+		if( !(iLen = strcspn( pcSegm, "/" )) )
+		{
+			break;
+		}
+		if( pNode->iWatch == -1 || (pcSegm[0] == '.' && (iLen == 1 || (iLen == 2 && pcSegm[1] == '.'))) ||
+			(iIndex = _nodeFind( pNode, pcSegm, iLen )) == -1 )
+		{
+			return NULL;
+		}
+		pNode   = pNode->ppChildren[iIndex];
+		pcSegm += iLen;
+	}
+	return pNode;
+#else
+	(void)pcFullPath;
+	return NULL;
+#endif /* __linux__ */
+}
+
+/**
+*	treeStats
+*
+*		Returns the address of the resident tree statistics.
+*
+*	@return		Address TREE_STATS struct.
+**/
+TREE_STATS *treeStats( void )
+{
+	return &treeStat;
+}
+
+/**
+*	treeUpdate
+*
+*		Apply all pending change notifications to the resident tree. This function
+*		never blocks. If the notification queue overflowed the entire tree is
+*		reloaded.
+**/
+void treeUpdate( void )
+{
+#ifdef __linux__
+	struct inotify_event	*pEvent;
+	TREE_NODE	*pNode;
+	char		*pcBuf,
+				cPath[MAX_PATH_SIZE];
+	ssize_t		iCount,
+				iPos;
+
+	if( iNotifyFd == -1 || !(pcBuf = (char *)malloc( TREE_EVENT_BUF )) )
+	{
+		return;
+	}
+	while( (iCount = read( iNotifyFd, pcBuf, TREE_EVENT_BUF )) > 0 )
+	{
+		for( iPos = 0; iPos < iCount; iPos += sizeof(struct inotify_event) + pEvent->len )
+		{
+			pEvent = (struct inotify_event *)&pcBuf[iPos];
+			treeStat.lEvents++;
+			if( pEvent->mask & IN_Q_OVERFLOW )
+			{
+				cbtDebug( "Resident tree: event queue overflow, reloading." );
+				_treeLoad();
+				continue;
+			}
+			if( pEvent->wd < 0 || pEvent->wd >= iWatchSize || !(pNode = ppWatches[pEvent->wd]) )
+			{
+				continue;
+			}
+			if( pEvent->mask & IN_IGNORED )		// Watch removed, directory vanished.
+			{
+				ppWatches[pEvent->wd] = NULL;
+				pNode->iWatch = -1;
+				treeStat.lDirectories--;
+				continue;
+			}
+			if( pEvent->len && pEvent->name[0] )
+			{
+				if( pEvent->mask & (IN_DELETE | IN_MOVED_FROM) )
+				{
+					_nodeRemove( pNode, pEvent->name );
+				}
+				else
+				{
+					_nodeAdd( pNode, pEvent->name, (pEvent->mask & (IN_CREATE | IN_MOVED_TO)) ? true : false );
+				}
+			}
+			// The directory itself changed as well.
+			if( _nodePath( pNode, cPath, sizeof(cPath) ) != -1 )
+			{
+				_nodeStat( pNode, cPath, NULL );
+			}
+		}
+	}
+	free( pcBuf );
+#endif /* __linux__ */
+}
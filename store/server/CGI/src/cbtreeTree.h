@@ -0,0 +1,44 @@
+#ifndef _CBTREE_TREE_H_
+#define _CBTREE_TREE_H_
+
+#include "cbtreeCommon.h"
+
+// Resident file tree node.
+typedef struct treeNode {
+	struct treeNode	*pParent;			// Parent directory (NULL for the root)
+	struct treeNode	**ppChildren;		// Children (directory only)
+	int			iCount;					// Number of children
+	int			iSize;					// Number of child slots allocated
+	int			iWatch;					// Watch descriptor, -1 if the directory content
+										// is not resident.
+	bool		directory;				// True if file is a directory
+	long		lSize;					// File size
+	long		lModified;				// Last modified (seconds since Jan 1, 1970)
+	char		cName[1];				// Filename (variable length)
+} TREE_NODE;
+
+// Resident file tree statistics.
+typedef struct treeStats {
+	long		lEntries;				// Number of resident entries.
+	long		lDirectories;			// Number of resident directories (watches).
+	long		lBytes;					// Number of bytes allocated for the tree.
+	long		lEvents;				// Number of change notifications processed.
+	long		lLoaded;				// Time the tree was (re)loaded.
+} TREE_STATS;
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+void		treeDestroy( void );
+int			treeEventFd( void );
+bool		treeInit( const char *pcRootDir );
+TREE_NODE  *treeLookup( const char *pcFullPath );
+TREE_STATS *treeStats( void );
+void		treeUpdate( void );
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif /* _CBTREE_TREE_H_ */
@@ -60,11 +60,17 @@ static void _destroyValue( DATA *ptObject )
 					destroy( ptMember );
 					ptMember = ptNext;
 				}
+				free( ptObject->pptIndex );
 				ptObject->value.ptMember = NULL;
+				ptObject->ptLast		 = NULL;
+				ptObject->pptIndex		 = NULL;
+				ptObject->iIndexSize	 = 0;
+				ptObject->ptCursor		 = NULL;
+				ptObject->iCursor		 = 0;
 				break;
 			case TYPE_V_BOOLEAN:
 			case TYPE_V_INTEGER:
-				ptObject->value.iValue = 0;
+				ptObject->value.llValue = 0;
 				break;
 			case TYPE_V_STRING:
 				if( ptObject->value.pcString )
@@ -78,6 +84,135 @@ static void _destroyValue( DATA *ptObject )
 	}
 }
 
+/**
+*	_varHash
+*
+*		Returns the hash value (FNV-1a) of the first iLength characters of a property
+*		name. The hash value returned is never zero.
+*
+*	@param	pcName			Address C-string containing the property name.
+*	@param	iLength			Number of characters to hash.
+*
+*	@return		Hash value.
+**/
+static unsigned int _varHash( const char *pcName, size_t iLength )
+{
+	unsigned int	iHash = 2166136261U;
+	size_t			i;
+
+	for( i = 0; i < iLength; i++ )
+	{
+		iHash = (iHash ^ (unsigned char)pcName[i]) * 16777619U;
+	}
+	return (iHash ? iHash : 1);
+}
+
+/**
+*	_varIndexInsert
+*
+*		Add a member to the hash index of an array or object. If a member with the
+*		same property name is already indexed the index is left unchanged, a lookup
+*		therefore always returns the first member with a given property name just
+*		like a linear search does.
+*
+*	@param	ptObject		Address dynamic variable of type array or object.
+*	@param	ptMember		Address dynamic variable.
+**/
+static void _varIndexInsert( DATA *ptObject, DATA *ptMember )
+{
+	DATA			*ptSlot;
+	unsigned int	iMask = ptObject->iIndexSize - 1,
+					i;
+
+	for( i = ptMember->iHash & iMask; (ptSlot = ptObject->pptIndex[i]); i = (i + 1) & iMask )
+	{
+		if( ptSlot->iHash == ptMember->iHash && !strcmp( ptSlot->name, ptMember->name ) )
+		{
+			return;
+		}
+	}
+	ptObject->pptIndex[i] = ptMember;
+}
+
+/**
+*	_varIndex
+*
+*		(Re)build the hash index of an array or object with room for at least iCount
+*		members. The index is an open addressing table that is never more than half
+*		full. If no memory is available the index is dropped and all lookups revert
+*		to a linear search.
+*
+*	@param	ptObject		Address dynamic variable of type array or object.
+*	@param	iCount			Number of members the index must be able to hold.
+**/
+static void _varIndex( DATA *ptObject, int iCount )
+{
+	DATA			*ptMember;
+	unsigned int	iSize = 2 * VAR_INDEX_MIN;
+
+	while( iSize < 2 * (unsigned int)iCount )
+	{
+		iSize *= 2;
+	}
+	free( ptObject->pptIndex );
+	ptObject->iIndexSize = 0;
+	if( (ptObject->pptIndex = (DATA **)calloc( iSize, sizeof(DATA *) )) )
+	{
+		ptObject->iIndexSize = iSize;
+		for( ptMember = ptObject->value.ptMember; ptMember; ptMember = ptMember->ptNext )
+		{
+			if( ptMember->name )
+			{
+				_varIndexInsert( ptObject, ptMember );
+			}
+		}
+	}
+}
+
+/**
+*	_varFindMember
+*
+*		Returns the first member of an array or object whose property name matches
+*		the first iLength characters of pcName. If the array or object has a hash
+*		index it is used, otherwise the members are searched linearly.
+*
+*	@param	ptObject		Address dynamic variable of type array or object.
+*	@param	pcName			Address property name (not necessarily terminated).
+*	@param	iLength			Length of the property name.
+*	@param	iHash			Hash value of the property name.
+*
+*	@return		Address DATA struct or NULL if member doesn't exist.
+**/
+static DATA *_varFindMember( DATA *ptObject, const char *pcName, size_t iLength, unsigned int iHash )
+{
+	DATA			*ptMember;
+	unsigned int	iMask,
+					i;
+
+	if( ptObject->pptIndex )
+	{
+		iMask = ptObject->iIndexSize - 1;
+		for( i = iHash & iMask; (ptMember = ptObject->pptIndex[i]); i = (i + 1) & iMask )
+		{
+			if( ptMember->iHash == iHash && !strncmp( ptMember->name, pcName, iLength ) && 
+				!ptMember->name[iLength] )
+			{
+				return ptMember;
+			}
+		}
+		return NULL;
+	}
+	for( ptMember = ptObject->value.ptMember; ptMember; ptMember = ptMember->ptNext )
+	{
+		if( ptMember->iHash == iHash && ptMember->name && !strncmp( ptMember->name, pcName, iLength ) && 
+			!ptMember->name[iLength] )
+		{
+			return ptMember;
+		}
+	}
+	return NULL;
+}
+
 /**
 *	_newVar
 *
@@ -116,8 +251,7 @@ static DATA *_newVar( const char *pcName )
 static DATA *_varGetMember( const char *pcProperty, DATA *ptObject )
 {
 	DATA	*ptMember = NULL;
-	char	cPropName[64];
-	int		l;
+	size_t	l;
 		
 	if( isData( ptObject ) )
 	{
@@ -128,16 +262,11 @@ static DATA *_varGetMember( const char *pcProperty, DATA *ptObject )
 				if( pcProperty && *pcProperty )
 				{
 					l = strcspn( pcProperty, "." );
-					strncpyz( cPropName, pcProperty, l );
-					for( ptMember = ptObject->value.ptMember; ptMember; ptMember = ptMember->ptNext )
+					if( (ptMember = _varFindMember( ptObject, pcProperty, l, _varHash( pcProperty, l ) )) )
 					{
-						if( !strcmp( ptMember->name, cPropName ) )
+						if( pcProperty[l] == '.' )
 						{
-							if( pcProperty[l] == '.' )
-							{
-								return _varGetMember( &pcProperty[l+1], ptMember );
-							}
-							break;
+							return _varGetMember( &pcProperty[l+1], ptMember );
 						}
 					}
 				}
@@ -184,6 +313,7 @@ void destroy( void *pvData )
 					destroy( ptMember );
 					ptMember = ptNext;
 				}
+				free( ptData->pptIndex );
 				break;
 			case TYPE_V_STRING:
 				free( ptData->value.pcString );
@@ -306,10 +436,10 @@ DATA *newVar( const char *pcName, void *pvValue )
 				}	
 				break;
 			case TYPE_V_BOOLEAN:
-				ptNewVar = newBoolean( pcPropNam, ptValue->value.iValue );
+				ptNewVar = newBoolean( pcPropNam, ptValue->value.llValue );
 				break;
 			case TYPE_V_INTEGER:
-				ptNewVar = newInteger( pcPropNam, ptValue->value.iValue );
+				ptNewVar = newInteger( pcPropNam, ptValue->value.llValue );
 				break;
 			case TYPE_V_STRING:
 				ptNewVar = newString( pcPropNam, ptValue->value.pcString );
@@ -323,12 +453,17 @@ DATA *newVar( const char *pcName, void *pvValue )
 	{
 		if( pvValue )
 		{
+			// A value that doesn't fit the buffer is neither numeric nor boolean.
+			if( strlen( (char *)pvValue ) >= sizeof(cValue) )
+			{
+				return newString( pcName, (char *)pvValue );
+			}
 			strncpy( cValue, (char *)pvValue, sizeof(cValue)-1);
 			cValue[sizeof(cValue)-1] = '\0';
 
 			if( isNumeric( cValue, &lValue ) )
 			{
-				return newInteger( pcName, (int)lValue );
+				return newInteger( pcName, lValue );
 			}
 			if( isBoolean( cValue, &bValue ) )
 			{
@@ -378,7 +513,7 @@ DATA *newBoolean( const char *pcName, bool bValue )
 	if( (ptInt = _newVar( pcName )) )
 	{
 		ptInt->type			= TYPE_V_BOOLEAN;
-		ptInt->value.iValue = bValue ? 1 : 0;
+		ptInt->value.llValue = bValue ? 1 : 0;
 		ptInt->length		= 1;
 	}
 	return ptInt;
@@ -430,18 +565,18 @@ DATA *newObject( const char *pcName )
 *		Allocate a dynamic variable of type integer.
 *
 *	@param	pcName			Address C-string containing the property name.
-*	@param	iValue			Integer value to be assigned.
+*	@param	llValue			Integer value to be assigned.
 *
 *	@return		Address dynamic variable of type integer.
 **/
-DATA *newInteger( const char *pcName, int iValue )
+DATA *newInteger( const char *pcName, long long llValue )
 {
 	DATA	*ptInt;
 	
 	if( (ptInt = _newVar( pcName )) )
 	{
 		ptInt->type			= TYPE_V_INTEGER;
-		ptInt->value.iValue = iValue;
+		ptInt->value.llValue = llValue;
 		ptInt->length		= 1;
 	}
 	return ptInt;
@@ -508,9 +643,9 @@ void *varGet( DATA *ptVar )
 			case TYPE_V_OBJECT:
 				break;
 			case TYPE_V_BOOLEAN:
-				return (void *)(ptVar->value.iValue ? 1 : 0);
+				return (void *)(ptVar->value.llValue ? 1 : 0);
 			case TYPE_V_INTEGER:
-				return (void *)ptVar->value.iValue;
+				return (void *)(size_t)ptVar->value.llValue;
 				break;
 			case TYPE_V_STRING:
 				return ptVar->value.pcString;
@@ -525,7 +660,8 @@ void *varGet( DATA *ptVar )
 *	varGetByIndex
 *
 *		Return the address of array member by its index. If the index is out of
-*		range NULL is returned.
+*		range NULL is returned. The member returned is remembered so iterating an
+*		array by index only walks the list of members once.
 *
 *	@param	iIndex			Integer index value.
 *	@param	ptObject		Address dynamic array.
@@ -534,16 +670,73 @@ void *varGet( DATA *ptVar )
 **/
 DATA *varGetByIndex( int iIndex, DATA *ptObject )
 {
-	DATA	*ptProp;
+	DATA	*ptProp = NULL;
+	int		i = 0;
 	
 	if( isArray( ptObject ) && iIndex >= 0 )
 	{
-		for( ptProp = ptObject->value.ptMember; ptProp && iIndex; ptProp = ptProp->ptNext, iIndex-- );
-		return ptProp;
+		if( ptObject->ptCursor && iIndex >= ptObject->iCursor )
+		{
+			ptProp = ptObject->ptCursor;
+			i	   = ptObject->iCursor;
+		}
+		else
+		{
+			ptProp = ptObject->value.ptMember;
+		}
+		for( ; ptProp && i < iIndex; ptProp = ptProp->ptNext, i++ );
+		if( ptProp )
+		{
+			ptObject->ptCursor = ptProp;
+			ptObject->iCursor  = iIndex;
+		}
+	}
+	return ptProp;
+}
+
+/**
+*	varGetByKey
+*
+*		Returns the address of array or object member by a pre-resolved property
+*		name. The hash value of the key is computed on first use, therefore keys
+*		used repeatedly should be declared static and initialized with VAR_KEY().
+*		Unlike varGetProperty() dotted property names are not supported.
+*
+*	@param	pKey			Address DATA_KEY struct.
+*	@param	ptObject		Address dynamic variable of type array or object.
+*
+*	@return		Address dynamic variable or NULL if the member doesn't exist.
+**/
+DATA *varGetByKey( DATA_KEY *pKey, DATA *ptObject )
+{
+	if( (isArray( ptObject ) || isObject( ptObject )) && (pKey && pKey->pcName) )
+	{
+		if( !pKey->iHash )
+		{
+			pKey->iLength = strlen( pKey->pcName );
+			pKey->iHash	  = _varHash( pKey->pcName, pKey->iLength );
+		}
+		return _varFindMember( ptObject, pKey->pcName, pKey->iLength, pKey->iHash );
 	}
 	return NULL;
 }
 
+/**
+*	varGetInteger
+*
+*		Return the full 64-bit value of a dynamic variable of type integer. Unlike
+*		varGet() the value is not passed through a pointer and therefore is never
+*		truncated on platforms with 32-bit pointers.
+*
+*	@param	ptVar			Address dynamic variable.
+*
+*	@return		Integer value or 0 if ptVar is not of type integer.
+**/
+long long varGetInteger( DATA *ptVar )
+{
+	return isInteger( ptVar ) ? ptVar->value.llValue : 0;
+}
+
 /**
 *	varGetProperties
 *
@@ -665,7 +858,8 @@ DATA *varNewProperty( const char *pcProperty, void *pvValue, DATA *ptVar )
 *
 *		PHP style push operation adding a new member to a dynamic array or object.
 *		If ptObject is an array and the new member has no property name, the name
-*		will be assigned the index in the array.
+*		will be assigned the index in the array. Once an array or object has
+*		VAR_INDEX_MIN members its members are also added to a hash index.
 *
 *	@note	Function varPush() does not check if the property already exists.
 *
@@ -676,30 +870,42 @@ DATA *varNewProperty( const char *pcProperty, void *pvValue, DATA *ptVar )
 **/
 int varPush( DATA *ptObject, DATA *ptMember )
 {
-	DATA	*ptLast;
 	char	cIndex[16];
-	int i = 0;
 
 	if( ptObject && ptMember )
 	{
 		if( (isArray( ptObject ) || isObject( ptObject )) && isData(ptMember) )
 		{
-			if( ptObject->value.ptMember )
+			if( ptObject->ptLast )
 			{
-				for( ptLast = ptObject->value.ptMember; ptLast->ptNext; ptLast = ptLast->ptNext, i++ );
-				ptLast->ptNext = ptMember;
+				ptObject->ptLast->ptNext = ptMember;
 			}
 			else  /* It's the first element. */
 			{
 				ptObject->value.ptMember = ptMember;
 			}
+			ptObject->ptLast = ptMember;
+
 			if( isArray( ptObject ) && !ptMember->name )
 			{
 				sprintf( cIndex, "%d", ptObject->length );
 				ptMember->name = mstrcpy( cIndex );
 			}
+			ptMember->iHash = ptMember->name ? _varHash( ptMember->name, strlen(ptMember->name) ) : 0;
 			ptObject->length++;
-			return i;
+
+			if( ptObject->length >= VAR_INDEX_MIN )
+			{
+				if( 2 * (unsigned int)ptObject->length > ptObject->iIndexSize )
+				{
+					_varIndex( ptObject, ptObject->length );
+				}
+				else if( ptMember->name )
+				{
+					_varIndexInsert( ptObject, ptMember );
+				}
+			}
+			return ptObject->length - 1;
 		}
 	}
 	return -1;
@@ -771,10 +977,10 @@ DATA *varSet( DATA *ptVar, void *pvValue )
 								varPush( ptVar, newVar( NULL, ptMember ) );
 								break;
 							case TYPE_V_BOOLEAN:
-								varPush( ptVar, newBoolean( ptMember->name, ptMember->value.iValue ) );
+								varPush( ptVar, newBoolean( ptMember->name, ptMember->value.llValue ) );
 								break;
 							case TYPE_V_INTEGER:
-								varPush( ptVar, newInteger( ptMember->name, ptMember->value.iValue ) );
+								varPush( ptVar, newInteger( ptMember->name, ptMember->value.llValue ) );
 								break;
 							case TYPE_V_STRING:
 								varPush( ptVar, newString( ptMember->name, ptMember->value.pcString ) );
@@ -783,12 +989,12 @@ DATA *varSet( DATA *ptVar, void *pvValue )
 					}
 					break;
 				case TYPE_V_BOOLEAN:
-					ptVar->value.iValue = ptValObj->value.iValue;
+					ptVar->value.llValue = ptValObj->value.llValue;
 					ptVar->length		= 1;
 					ptVar->type			= TYPE_V_BOOLEAN;
 					break;
 				case TYPE_V_INTEGER:
-					ptVar->value.iValue = ptValObj->value.iValue;
+					ptVar->value.llValue = ptValObj->value.llValue;
 					ptVar->length		= 1;
 					ptVar->type			= TYPE_V_INTEGER;
 					break;
@@ -1,9 +1,12 @@
 #ifndef _CBTREE_TYPES_H_
 #define _CBTREE_TYPES_H_
 
+#include <stdlib.h>
+
 #include "cbtreeCommon.h"
 
 #define MAGIC_V_VALUE	0XFEDCBA98
+#define VAR_INDEX_MIN	8			// Number of members at which an array or object gets a hash index.
 
 #define isArray(x)		isType((x), TYPE_V_ARRAY)
 #define isBool(x)		isType((x), TYPE_V_BOOLEAN)
@@ -13,8 +16,13 @@
 #define isObject(x)		isType((x), TYPE_V_OBJECT)
 #define isString(x)		isType((x), TYPE_V_STRING)
 
+#define VAR_KEY(name)	{ (name), 0, 0 }	// Static initializer of a DATA_KEY struct.
+
 // Default data type structure to build PHP style associative arrays
 typedef struct data {
+	int		_magic;					// Magic number of a valid data type. (MAGIC_V_VALUE)
+									// The first member, isData() must never probe beyond
+									// the first bytes of any other object passed to destroy().
 	struct data	*ptNext;			// Pointer to next entry in the list.
 	char		*name;				// Property name.
 	int			type;				// Property type.
@@ -22,13 +30,25 @@ typedef struct data {
 	union {
 		struct data	*ptMember;		// Pointer to the first member in an array or object.
 		char		*pcString;		// Pointer to a C-string (type = TYPE_V_STRING)
-		int			iValue;			// Integer value (type = (TYPE_V_BOOLEAN | TYPE_V_INTEGER)
+		long long	llValue;		// Integer value (type = (TYPE_V_BOOLEAN | TYPE_V_INTEGER)
 	} value;
-	int		_magic;					// Magic number of a valid data type. (MAGIC_V_VALUE)
+	struct data	*ptLast;			// Pointer to the last member in an array or object.
+	struct data	**pptIndex;			// Hash index of the array or object members, or NULL.
+	unsigned int iIndexSize;		// Number of hash index slots (power of two).
+	unsigned int iHash;				// Hash value of the property name.
+	struct data	*ptCursor;			// Member last returned by varGetByIndex().
+	int			iCursor;			// Index of ptCursor.
 } DATA;
 
+// Pre-resolved property name, see varGetByKey().
+typedef struct dataKey {
+	const char		*pcName;		// Property name (no dotted names).
+	size_t			iLength;		// Length of the property name.
+	unsigned int	iHash;			// Hash value of the property name (0 = not yet resolved).
+} DATA_KEY;
+
 // Enumerate common data types.
-enum {
+enum dataTypes {
 	TYPE_V_NONE = 0,
 	TYPE_V_ARRAY,
 	TYPE_V_BOOLEAN,
@@ -36,7 +56,7 @@ enum {
 	TYPE_V_OBJECT,
 	TYPE_V_STRING,
 	TYPE_V_NULL
-} dataTypes;
+};
 
 #ifdef __cplusplus
 	extern "C" {
@@ -52,7 +72,7 @@ bool hasProperty( const char *pcProperty, DATA *ptObject );
 DATA *newVar( const char *pcName, void *pvValue );
 DATA *newArray( const char *pcName );
 DATA *newBoolean( const char *pcName, bool bValue );
-DATA *newInteger( const char *pcName, int iValue );
+DATA *newInteger( const char *pcName, long long llValue );
 DATA *newNull( const char *pcName );
 DATA *newObject( const char *pcName );
 DATA *newString( const char *pcName, char *pcValue );
@@ -60,6 +80,8 @@ DATA *newString( const char *pcName, char *pcValue );
 int varCount( void *pvData );
 void *varGet( DATA *ptVar );
 DATA *varGetByIndex( int iIndex, DATA *ptObject  );
+DATA *varGetByKey( DATA_KEY *pKey, DATA *ptObject );
+long long varGetInteger( DATA *ptVar );
 void *varGetProperty( const char *pcProperty, DATA *ptVar );
 DATA *varGetProperties( DATA *ptObject );
 int varGetType( DATA *ptVar );
@@ -31,35 +31,37 @@
 #include "cbtreeURI.h"
 
 #define MIN(x,y) (x < y ? x : y)
+#define HEXVAL(c) (isdigit(c) ? (c) - '0' : (toupper(c) - 'A' + 10))
 /**
 *	decodeURI
 *
 *		Decode a URI encoded string into a ISO-8859-1 (ASCII) string. Any percent (%) 
-*		encode character is translated to its ASCII equivalent.
+*		encode character is translated to its ASCII equivalent. The string is decoded
+*		in a single pass, a percent sign not followed by two hexadecimal digits is
+*		copied as is. If no destination buffer is specified the source string is
+*		decoded in place.
 *
 *	@param	pcSrc			Address URI encode C-string
-*	@param	pcDst			Address destination (output) buffer
+*	@param	pcDst			Address destination (output) buffer or NULL
 *	@param	iDstLen			Length destination string
 *
 *	@return		Address destination C-string.
 */
 char *decodeURI( char *pcSrc, char *pcDst, size_t iDstLen )
 {
-	char	*pcDecode = pcSrc,
-				*pNext;
-	char	hex[3] = { '\0', '\0', '\0' };
-	int		lValue;
-	size_t	iSrcLen;
+	unsigned char	*pcDecode,
+					*pcOut;
+	int				iValue;
+	size_t			iSrcLen;
 
 	if( pcSrc )
 	{
-		iSrcLen  = strlen(pcSrc);
 		if( pcDst )
 		{
+			iSrcLen = strlen(pcSrc);
 			if( iSrcLen < iDstLen )
 			{
 				memmove( pcDst, pcSrc, iSrcLen+1 );
-				pcDecode = pcDst;
 			}
 			else
 				return NULL;
@@ -67,19 +69,19 @@ char *decodeURI( char *pcSrc, char *pcDst, size_t iDstLen )
 		else
 			pcDst = pcSrc;
 
-		while( (pcDecode = strchr( pcDecode, '%' )) )
+		// The decoded string is never longer than the encoded string.
+		for( pcDecode = pcOut = (unsigned char *)pcDst; *pcDecode; )
 		{
-			hex[0] = pcDecode[1]; 
-			hex[1] = pcDecode[2];
-			if( (lValue = strtol( hex, NULL, 16 )) )
+			if( pcDecode[0] == '%' && isxdigit(pcDecode[1]) && isxdigit(pcDecode[2]) &&
+				(iValue = HEXVAL(pcDecode[1]) * 16 + HEXVAL(pcDecode[2])) )
 			{
-				*pcDecode++ = (unsigned char)lValue;
-				pNext = pcDecode + 2;
-				memmove( pcDecode, pNext, strlen( pNext ) + 1);
+				*pcOut++  = (unsigned char)iValue;
+				pcDecode += 3;
 			}
 			else
-				pcDecode++;
+				*pcOut++ = *pcDecode++;
 		}
+		*pcOut = '\0';
 		return pcDst;
 	}
 	return NULL;
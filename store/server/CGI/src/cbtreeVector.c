@@ -0,0 +1,258 @@
+/****************************************************************************************
+*	Copyright (c) 2012, Peter Jekel
+*	All rights reserved.
+*
+*	The Checkbox Tree File Store CGI (cbtreeFileStore) is released under to following
+*	license:
+*
+*	    BSD 2-Clause		(http://thejekels.com/cbtree/LICENSE)
+*
+*	@author		Peter Jekel
+*
+****************************************************************************************
+*
+*	Description:
+*
+*		This modules provides a vector, a growable array of references to arbitrary
+*		data. Members are appended at the end, the array is doubled in size when
+*		full. Unlike the double linked list (see cbtreeList.c) the number of members
+*		is known at all times and the members are stored contiguously which allows
+*		the members to be sorted and sliced in place. The vector and its array are
+*		allocated from the request arena, if active (see cbtreeArena.c).
+*
+****************************************************************************************/
+#ifdef _MSC_VER
+	#define _CRT_SECURE_NO_WARNINGS
+#endif	/* _MSC_VER */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "cbtreeArena.h"
+#include "cbtreeVector.h"
+
+#define VECTOR_SIZE		16			// Default initial number of members allocated.
+
+/**
+*	_mergeSort
+*
+*		Sort an array of member references. Merge sort is used because it is stable,
+*		members that compare equal retain their order.
+*
+*	@param	ppvData			Address array of member references.
+*	@param	ppvTemp			Address scratch array with room for iCount/2 references.
+*	@param	iCount			Number of array elements.
+*	@param	func			Address compare function.
+*	@param	pvArg			Argument passed to the compare function.
+**/
+static void _mergeSort( void **ppvData, void **ppvTemp, int iCount, COMPARE_DATA func, void *pvArg )
+{
+	int		iHalf = iCount / 2,
+			i, j, k;
+
+	if( iCount < 2 )
+	{
+		return;
+	}
+	_mergeSort( ppvData, ppvTemp, iHalf, func, pvArg );
+	_mergeSort( &ppvData[iHalf], ppvTemp, iCount - iHalf, func, pvArg );
+
+	// Nothing to merge if both halves are already in order.
+	if( func( ppvData[iHalf-1], ppvData[iHalf], pvArg ) <= 0 )
+	{
+		return;
+	}
+	memcpy( ppvTemp, ppvData, iHalf * sizeof(void *) );
+	for( i = 0, j = iHalf, k = 0; i < iHalf; )
+	{
+		if( j < iCount && func( ppvData[j], ppvTemp[i], pvArg ) < 0 )
+		{
+			ppvData[k++] = ppvData[j++];
+		}
+		else
+		{
+			ppvData[k++] = ppvTemp[i++];
+		}
+	}
+}
+
+/**
+*	destroyVector
+*
+*		Release all resource associated with a vector. If parameter func is specified
+*		the associated function is called once for each member.
+*
+*	@param	ppVector		Address of a pointer of type VECTOR
+*	@param	func			Address user defined callback function.
+**/
+void destroyVector( VECTOR **ppVector, DESTROY_DATA func )
+{
+	int		i;
+
+	if( ppVector && *ppVector )
+	{
+		if( func )
+		{
+			for( i = 0; i < (*ppVector)->iCount; i++ )
+			{
+				if( (*ppVector)->ppvData[i] )
+				{
+					func( (*ppVector)->ppvData[i] );
+				}
+			}
+		}
+		arenaFree( (*ppVector)->ppvData );
+		arenaFree( *ppVector );
+		*ppVector = NULL;
+	}
+}
+
+/**
+*	newVector
+*
+*		Returns the address of a newly allocated, empty, VECTOR struct.
+*
+*	@param	iSize			Initial number of members to allocate, if zero a default
+*							size is used.
+*
+*	@return		Address newly allocated VECTOR struct or NULL.
+**/
+VECTOR *newVector( int iSize )
+{
+	VECTOR	*pVector;
+
+	iSize = iSize > 0 ? iSize : VECTOR_SIZE;
+	if( (pVector = (VECTOR *)arenaAlloc( sizeof(VECTOR) )) )
+	{
+		if( (pVector->ppvData = (void **)arenaAlloc( iSize * sizeof(void *) )) )
+		{
+			pVector->iCount = 0;
+			pVector->iSize	= iSize;
+			return pVector;
+		}
+		arenaFree( pVector );
+	}
+	return NULL;
+}
+
+/**
+*	vectorAppend
+*
+*		Append a new member at the end of the vector. Paramater pMember represents
+*		the address of any amount of arbitrary data, only the reference (data address)
+*		is stored.
+*
+*	@param	pMember			Address arbitrary data.
+*	@param	pVector			Address of struct of type VECTOR.
+*
+*	@return		True on success otherwise false.
+**/
+bool vectorAppend( void *pMember, VECTOR *pVector )
+{
+	void	**ppvNew;
+
+	if( pVector->iCount == pVector->iSize )
+	{
+		if( !(ppvNew = (void **)arenaRealloc( pVector->ppvData, pVector->iSize * sizeof(void *),
+											  2 * pVector->iSize * sizeof(void *) )) )
+		{
+			return false;
+		}
+		pVector->ppvData = ppvNew;
+		pVector->iSize	*= 2;
+	}
+	pVector->ppvData[pVector->iCount++] = pMember;
+	return true;
+}
+
+/**
+*	vectorCount
+*
+*		Returns the number of members of a vector.
+*
+*	@param	pVector			Address of struct of type VECTOR.
+**/
+int vectorCount( VECTOR *pVector )
+{
+	return pVector ? pVector->iCount : 0;
+}
+
+/**
+*	vectorIsEmpty
+*
+*		Returns true if the vector identified by parameter pVector is empty, that is,
+*		it does not contain any members.
+*
+*	@param	pVector			Address of struct of type VECTOR.
+**/
+bool vectorIsEmpty( VECTOR *pVector )
+{
+	return (pVector ? pVector->iCount == 0 : true);
+}
+
+/**
+*	vectorSlice
+*
+*		Retain only the members iStart through iStart+iCount-1 of a vector. If
+*		parameter func is specified the associated function is called once for
+*		each member outside that range.
+*
+*	@param	pVector			Address of struct of type VECTOR.
+*	@param	iStart			Index of the first member to retain.
+*	@param	iCount			Maximum number of members to retain (-1 = all).
+*	@param	func			Address user defined callback function.
+**/
+void vectorSlice( VECTOR *pVector, int iStart, int iCount, DESTROY_DATA func )
+{
+	int		iEnd = pVector->iCount,
+			i;
+
+	iStart = iStart < pVector->iCount ? iStart : pVector->iCount;
+	if( iCount >= 0 && iStart + iCount < iEnd )
+	{
+		iEnd = iStart + iCount;
+	}
+	if( func )
+	{
+		for( i = 0; i < pVector->iCount; i++ )
+		{
+			if( (i < iStart || i >= iEnd) && pVector->ppvData[i] )
+			{
+				func( pVector->ppvData[i] );
+			}
+		}
+	}
+	if( iStart > 0 )
+	{
+		memmove( pVector->ppvData, &pVector->ppvData[iStart], (iEnd - iStart) * sizeof(void *) );
+	}
+	pVector->iCount = iEnd - iStart;
+}
+
+/**
+*	vectorSort
+*
+*		Sort the members of a vector in place. The sort is stable, members that
+*		compare equal retain their order.
+*
+*	@param	pVector			Address of struct of type VECTOR.
+*	@param	func			Address compare function.
+*	@param	pvArg			Argument passed to the compare function.
+*
+*	@return		True on success otherwise false (out of memory).
+**/
+bool vectorSort( VECTOR *pVector, COMPARE_DATA func, void *pvArg )
+{
+	void	**ppvTemp;
+
+	if( pVector->iCount > 1 )
+	{
+		if( !(ppvTemp = (void **)malloc( (pVector->iCount / 2 + 1) * sizeof(void *) )) )
+		{
+			return false;
+		}
+		_mergeSort( pVector->ppvData, ppvTemp, pVector->iCount, func, pvArg );
+		free( ppvTemp );
+	}
+	return true;
+}
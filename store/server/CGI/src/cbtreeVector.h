@@ -0,0 +1,31 @@
+#ifndef _CBTREE_VECTOR_H_
+#define _CBTREE_VECTOR_H_
+
+#include "cbtreeCommon.h"
+#include "cbtreeList.h"
+
+typedef struct vector {
+	void	**ppvData;				// Array of members
+	int		iCount;					// Number of members
+	int		iSize;					// Number of members allocated
+} VECTOR;
+
+typedef int (*COMPARE_DATA)( const void *pvDataA, const void *pvDataB, void *pvArg );
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+void	destroyVector( VECTOR **ppVector, DESTROY_DATA func );
+VECTOR *newVector( int iSize );
+bool	vectorAppend( void *pMember, VECTOR *pVector );
+int		vectorCount( VECTOR *pVector );
+bool	vectorIsEmpty( VECTOR *pVector );
+void	vectorSlice( VECTOR *pVector, int iStart, int iCount, DESTROY_DATA func );
+bool	vectorSort( VECTOR *pVector, COMPARE_DATA func, void *pvArg );
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif /* _CBTREE_VECTOR_H_ */
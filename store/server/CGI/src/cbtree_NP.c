@@ -15,26 +15,133 @@
 *
 *		This module holds all non-portable Operating System specific source code. 
 *		To implement the CGI application for any OS other than Microsoft Windows
-*		you must provide the following four functions:
+*		or a POSIX compliant OS you must provide the following six functions:
 *
 *			1 - _fileToStruct	(Convert OS specific file info to a generic format).
 *			2 -	findFile_NP		(Find the first file in a search sequence.)
 *			3 -	findNextFile_NP	(Find the next file in a search sequence.)
-*			4 - findEnd_NP			(File search completion.)
+*			4 -	findSkipFile_NP	(Skip the next file in a search sequence.)
+*			5 - findEnd_NP			(File search completion.)
+*			6 - removeFile_NP		(Delete a file found by a search sequence.)
 *		
 *		All other modules, part of this CGI implementation, are OS independent.
 *
+*	NOTE:	The POSIX implementation keeps an open directory file descriptor for
+*			the duration of a directory search. All directory entries are stat-ed
+*			relative to that descriptor using fstatat() and the relative path of
+*			the directory is computed only once per search, therefore no full path
+*			names are composed for the individual directory entries. Files are
+*			deleted relative to the same descriptor using unlinkat().
+*
+*			On Linux a directory level is loaded as a whole and the file status
+*			of its entries is retrieved, as the entries are read, in batches of
+*			io_uring IORING_OP_STATX operations. If io_uring is unavailable at runtime the synchronous
+*			fstatat() is used instead. Define NO_IO_URING to build without any
+*			io_uring support. Batching pays off when the file status is not
+*			cached and the statx operations can overlap. When the inodes are
+*			cached the batches are slower than plain fstatat() calls: a deep
+*			search of 100,000 files with a warm cache took 0.21 seconds with
+*			io_uring against 0.16 seconds with NO_IO_URING.
+*
+*			In daemon mode resident directories are loaded from the resident file
+*			tree (see cbtreeTree.c), if a snapshot is configured the directories
+*			in its file tree are loaded from the snapshot (see cbtreeIndex.c). In
+*			both cases no system calls are made at all.
+*
+*			All functions in this module are thread safe, a deep directory search
+*			may call them from multiple threads simultaneously.
+*
 ****************************************************************************************/
 #ifdef _MSC_VER
 	#define _CRT_SECURE_NO_WARNINGS
 #endif	/* _MSC_VER */
 
+#ifdef __linux__
+	#define _GNU_SOURCE				// statx()
+#endif	/* __linux__ */
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
+#include <errno.h>
+#ifdef WIN32
+  #include <direct.h>
+  #include <io.h>
+#else
+  #include <fcntl.h>
+  #include <unistd.h>
+  #include <sys/stat.h>
+  #ifdef __linux__
+	#include <stdint.h>
+	#include <sys/syscall.h>
+	#include <sys/sysmacros.h>
+	#ifndef NO_IO_URING
+	  #define IO_URING_SUPPORT
+	  #include <pthread.h>
+	  #include <sys/mman.h>
+	  #include <linux/io_uring.h>
+	#endif /* NO_IO_URING */
+  #endif /* __linux__ */
+#endif /* WIN32 */
 
 #include "cbtree_NP.h"
+#include "cbtreeArena.h"
+#include "cbtreeCache.h"
+#include "cbtreeIndex.h"
 #include "cbtreeString.h"
+#include "cbtreeTree.h"
+#include "cbtreeURI.h"
+
+#ifdef __linux__
+// Directory entry as returned by the getdents64() system call.
+struct linux_dirent64 {
+	uint64_t		d_ino;
+	int64_t			d_off;
+	unsigned short	d_reclen;
+	unsigned char	d_type;
+	char			d_name[1];
+};
+#endif /* __linux__ */
+
+#ifdef IO_URING_SUPPORT
+// io_uring instance used to batch file status requests.
+typedef struct ioRing {
+	int					iState;			// 0 = not initialized, 1 = available, -1 = unavailable
+	int					iFd;			// io_uring file descriptor
+	unsigned			*puSqHead,
+						*puSqTail,
+						*puSqMask,
+						*puSqArray;
+	unsigned			*puCqHead,
+						*puCqTail,
+						*puCqMask;
+	unsigned			uEntries;		// Number of submission queue entries.
+	struct io_uring_sqe	*pSqes;
+	struct io_uring_cqe	*pCqes;
+	struct statx		*pStatx;		// One statx buffer per submission queue entry.
+	int					*piSlot;		// Directory entry index per submission queue entry.
+	char				*pcSq,			// Mapped submission queue ring.
+						*pcCq;			// Mapped completion queue ring (may equal pcSq).
+	size_t				iSqLen,
+						iCqLen;
+} IO_RING;
+
+// Each thread uses its own io_uring instance, it is released when the thread exits.
+static __thread IO_RING	ioRing;
+static pthread_key_t	ringKey;
+static pthread_once_t	ringOnce = PTHREAD_ONCE_INIT;
+#endif /* IO_URING_SUPPORT */
+
+static SYS_COUNT	sysCount = { 0, 0, 0, 0 };
+
+// The system call counters are updated by multiple threads during a deep search.
+#ifdef WIN32
+  #define sysCountAdd(c)	InterlockedIncrement( &sysCount.c )
+#elif defined(__GNUC__)
+  #define sysCountAdd(c)	__sync_fetch_and_add( &sysCount.c, 1 )
+#else
+  #define sysCountAdd(c)	(sysCount.c++)
+#endif /* WIN32 */
 
 #ifdef WIN32
 /**
@@ -59,6 +166,7 @@ static time_t _fileTimeToTime( FILETIME *pFileTime )
 }
 #endif /* WIN32 */
 
+#ifdef WIN32
 /**
 *	_fileToStruct
 *
@@ -73,20 +181,18 @@ static time_t _fileTimeToTime( FILETIME *pFileTime )
 **/
 static FILE_INFO *_fileToStruct( char *pcFullPath, char *pcRootDir, void *pvFileData, ARGS *pArgs )
 {
-#ifdef WIN32
 	WIN32_FIND_DATA	*psFileData = (WIN32_FIND_DATA *)pvFileData;
 	FILE_INFO		*pFileInfo = NULL;
 	char			cRelPath[MAX_PATH_SIZE],
 					*pcRelPath = cRelPath;
+	size_t			iRelLen;
 
 	(void)pArgs;
-		
-	if( (pFileInfo = (FILE_INFO *)calloc(1, sizeof(FILE_INFO))) )
-	{
-		getRelativePath( pcFullPath, pcRootDir, psFileData->cFileName, &pcRelPath );
 
-		pFileInfo->pcName		= mstrcpy( psFileData->cFileName );
-		pFileInfo->pcPath		= mstrcpy( cRelPath );
+	getRelativePath( pcFullPath, pcRootDir, "", &pcRelPath );
+	iRelLen = strlen( cRelPath );
+	if( (pFileInfo = newFileInfo( cRelPath, iRelLen, psFileData->cFileName, strlen(psFileData->cFileName), false )) )
+	{
 		pFileInfo->directory	= (psFileData->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ? 1: 0;
 		pFileInfo->bIsHidden	= (psFileData->dwFileAttributes & FILE_ATTRIBUTE_HIDDEN) ? 1: 0;
 		pFileInfo->lSize		= psFileData->nFileSizeLow;
@@ -95,12 +201,952 @@ static FILE_INFO *_fileToStruct( char *pcFullPath, char *pcRootDir, void *pvFile
 		pFileInfo->iPropMask	= PROP_M_DEFAULT | (pFileInfo->directory ? PROP_M_DIRECTORY : 0);
 	}
 	return pFileInfo;
+}
+
+/**
+*	_skipFindData
+*
+*		Returns true if a file found by FindFirstFile() or FindNextFile() is to be
+*		skipped. The special entries "." and ".." are always skipped, hidden files
+*		are skipped unless requested otherwise (same selection as _fileFilter()).
+*		Files not matching the query are skipped except for directories of a deep
+*		search, their descendants may still match.
+*
+*	@param	psFileData		Address WIN32_FIND_DATA struct.
+*	@param	pArgs			Address arguments struct
+*
+*	@return		True or false.
+**/
+static bool _skipFindData( WIN32_FIND_DATA *psFileData, ARGS *pArgs )
+{
+	char	*pcName = psFileData->cFileName;
+	bool	directory = (psFileData->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ? true : false;
+
+	if( !strcmp( pcName, "." ) || !strcmp( pcName, ".." ) ||
+		(!pArgs->pOptions->bShowHiddenFiles && 
+		 (pcName[0] == '.' || (psFileData->dwFileAttributes & FILE_ATTRIBUTE_HIDDEN))) )
+	{
+		return true;
+	}
+	if( pArgs->pQuery && !(directory && pArgs->pOptions->bDeep) )
+	{
+		return !queryMatch( pArgs->pQuery, pcName, directory, psFileData->nFileSizeLow,
+							(long)_fileTimeToTime( &psFileData->ftLastWriteTime ) );
+	}
+	return false;
+}
 #else
-	#error Function _fileToStruct() not implemented
+/**
+*	_fileToStruct
+*
+*		Convert a directory entry to the cbtreeFileStore FILE_INFO struct. The relative
+*		path of the file is composed of the relative directory path saved in the OS_ARG
+*		struct and the filename. If no file status is available for the entry, that is,
+*		the entry was classified by its directory entry type only, the size and last
+*		modified properties are not set.
+*
+*	@param	pOSArg			Address OS_ARG struct of the current search.
+*	@param	pcFilename		Address C-string containing the filename.
+*	@param	pEntry			Address DIR_ENTRY struct.
+*	@param	pArgs			Address arguments struct
+*
+*	@return		On sucess, pointer to a FILE_INFO struct otherwise NULL
+**/
+static FILE_INFO *_fileToStruct( OS_ARG *pOSArg, const char *pcFilename, DIR_ENTRY *pEntry, ARGS *pArgs )
+{
+	FILE_INFO	*pFileInfo = NULL;
+	size_t		iNameLen = strlen( pcFilename );
+
+	(void)pArgs;
+
+	if( pOSArg->iRelLen + iNameLen >= MAX_PATH_SIZE )
+	{
+		return NULL;
+	}
+	// While the request arena is active all files share the directory path.
+	if( !pOSArg->pcRelDir && arenaActive() )
+	{
+		pOSArg->pcRelDir = astrncpy( pOSArg->cRelPath, pOSArg->iRelLen );
+	}
+	if( (pFileInfo = newFileInfo( (pOSArg->pcRelDir ? pOSArg->pcRelDir : pOSArg->cRelPath), pOSArg->iRelLen,
+								  pcFilename, iNameLen, (pOSArg->pcRelDir != NULL) )) )
+	{
+		pFileInfo->directory = pEntry->directory;
+		pFileInfo->bIsLink	 = (pEntry->iStatus == STAT_V_OK) && pEntry->bLink;
+		pFileInfo->bIsHidden = (pcFilename[0] == '.') ? 1 : 0;
+		pFileInfo->iPropMask = PROP_M_NAME | PROP_M_PATH;
+		if( pEntry->iStatus == STAT_V_OK )
+		{
+			pFileInfo->lSize	  = pEntry->lSize;
+			pFileInfo->lModified  = pEntry->lModified;
+			pFileInfo->lDevice	  = pEntry->lDevice;
+			pFileInfo->lInode	  = pEntry->lInode;
+			pFileInfo->iLinks	  = pEntry->iLinks;
+			pFileInfo->iPropMask |= PROP_M_SIZE | PROP_M_MODIFIED;
+		}
+		pFileInfo->iPropMask |= (pFileInfo->directory ? PROP_M_DIRECTORY : 0);
+	}
+	return pFileInfo;
+}
+
+/**
+*	_skipFile
+*
+*		Returns true if a directory entry can be skipped before its file status
+*		is retrieved. The special entries "." and ".." are always skipped, hidden
+*		files (dot files) are skipped unless requested otherwise.
+*
+*	@param	pcFilename		Address C-string containing the filename.
+*	@param	pArgs			Address arguments struct
+*
+*	@return		True or false.
+**/
+static bool _skipFile( const char *pcFilename, ARGS *pArgs )
+{
+	if( pcFilename[0] == '.' )
+	{
+		if( !pcFilename[1] || (pcFilename[1] == '.' && !pcFilename[2]) )
+		{
+			return true;
+		}
+		return (pArgs && pArgs->pOptions) ? !pArgs->pOptions->bShowHiddenFiles : false;
+	}
+	return false;
+}
+
+/**
+*	_queryFilter
+*
+*		Returns true if a directory entry does not match the query, if any, of the
+*		HTTP query string arguments. Directories of a deep search are never filtered
+*		because their descendants may still match the query, instead the search
+*		result is pruned once all directories are loaded.
+*
+*	@param	pcFilename		Address C-string containing the filename.
+*	@param	pEntry			Address DIR_ENTRY struct.
+*	@param	pArgs			Address arguments struct
+*
+*	@return		True or false.
+**/
+static bool _queryFilter( const char *pcFilename, DIR_ENTRY *pEntry, ARGS *pArgs )
+{
+	if( !pArgs || !pArgs->pQuery || (pEntry->directory && pArgs->pOptions->bDeep) )
+	{
+		return false;
+	}
+	return !queryMatch( pArgs->pQuery, pcFilename, pEntry->directory, pEntry->lSize, pEntry->lModified );
+}
+
+/**
+*	_statAt
+*
+*		Get the file status of a directory entry relative to an open directory. If
+*		the entry is a symbolic link the status of the link target is returned, in
+*		case the link is broken the status of the link itself is returned. In both
+*		cases the entry is marked as a link so callers that modify the file system
+*		never follow it.
+*
+*	@param	iDirFd			Directory file descriptor or AT_FDCWD.
+*	@param	pcFilename		Address C-string containing the filename.
+*	@param	pEntry			Address DIR_ENTRY struct receiving the file status.
+*
+*	@return		0 if successful otherwise -1
+**/
+static int _statAt( int iDirFd, const char *pcFilename, DIR_ENTRY *pEntry )
+{
+	struct stat	sStat,
+				sLink;
+
+	sysCountAdd( lStat );
+	if( fstatat( iDirFd, pcFilename, &sStat, AT_SYMLINK_NOFOLLOW ) )
+	{
+		pEntry->iStatus = STAT_V_FAILED;
+		return -1;
+	}
+	pEntry->bLink = S_ISLNK( sStat.st_mode ) ? true : false;
+	if( pEntry->bLink )
+	{
+		sysCountAdd( lStat );
+		if( !fstatat( iDirFd, pcFilename, &sLink, 0 ) )
+		{
+			sStat = sLink;
+		}
+	}
+	pEntry->directory = S_ISDIR( sStat.st_mode ) ? 1 : 0;
+	pEntry->lSize	  = (long)sStat.st_size;
+	pEntry->lModified = (long)sStat.st_mtime;
+	pEntry->lDevice	  = (unsigned long)sStat.st_dev;
+	pEntry->lInode	  = (unsigned long)sStat.st_ino;
+	pEntry->iLinks	  = (int)sStat.st_nlink;
+	pEntry->iStatus	  = STAT_V_OK;
+	return 0;
+}
+
+#ifdef __linux__
+#ifdef IO_URING_SUPPORT
+/**
+*	_ringClose
+*
+*		Release the io_uring instance of the calling thread. Called as the destructor
+*		of the thread specific ring key when a thread that used its io_uring exits.
+*
+*	@param	pvData			Address of the IO_RING struct (unused).
+**/
+static void _ringClose( void *pvData )
+{
+	(void)pvData;
+
+	if( ioRing.iState > 0 )
+	{
+		munmap( ioRing.pSqes, ioRing.uEntries * sizeof(struct io_uring_sqe) );
+		if( ioRing.pcCq != ioRing.pcSq )
+		{
+			munmap( ioRing.pcCq, ioRing.iCqLen );
+		}
+		munmap( ioRing.pcSq, ioRing.iSqLen );
+		close( ioRing.iFd );
+		free( ioRing.pStatx );
+		free( ioRing.piSlot );
+	}
+	memset( &ioRing, 0, sizeof(IO_RING) );
+}
+
+/**
+*	_ringKeyInit
+*
+*		Create the thread specific key whose destructor releases the io_uring
+*		instance of an exiting thread.
+**/
+static void _ringKeyInit( void )
+{
+	pthread_key_create( &ringKey, _ringClose );
+}
+
+/**
+*	_ringInit
+*
+*		Setup the io_uring instance used to batch file status requests. If io_uring
+*		is not supported by the kernel, or its use is not permitted, the io_uring is
+*		marked as unavailable and all file status requests will be synchronous.
+*
+*	@return		True if the io_uring is available otherwise false.
+**/
+static bool _ringInit( void )
+{
+	struct io_uring_params	sParams;
+	size_t		iSqLen,
+				iCqLen;
+	char		*pcSq,
+				*pcCq;
+	int			iFd;
+
+	if( ioRing.iState )
+	{
+		return (ioRing.iState > 0);
+	}
+	ioRing.iState = -1;		// Assume the worst...
+
+	memset( &sParams, 0, sizeof(sParams) );
+	if( (iFd = (int)syscall( __NR_io_uring_setup, IO_RING_ENTRIES, &sParams )) < 0 )
+	{
+		return false;
+	}
+	iSqLen = sParams.sq_off.array + sParams.sq_entries * sizeof(unsigned);
+	iCqLen = sParams.cq_off.cqes + sParams.cq_entries * sizeof(struct io_uring_cqe);
+	if( sParams.features & IORING_FEAT_SINGLE_MMAP )
+	{
+		iSqLen = iCqLen = (iSqLen > iCqLen ? iSqLen : iCqLen);
+	}
+	pcSq = mmap( NULL, iSqLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, iFd, IORING_OFF_SQ_RING );
+	if( pcSq == MAP_FAILED )
+	{
+		close( iFd );
+		return false;
+	}
+	if( sParams.features & IORING_FEAT_SINGLE_MMAP )
+	{
+		pcCq = pcSq;
+	}
+	else
+	{
+		pcCq = mmap( NULL, iCqLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, iFd, IORING_OFF_CQ_RING );
+		if( pcCq == MAP_FAILED )
+		{
+			munmap( pcSq, iSqLen );
+			close( iFd );
+			return false;
+		}
+	}
+	ioRing.pSqes = mmap( NULL, sParams.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+						 MAP_SHARED | MAP_POPULATE, iFd, IORING_OFF_SQES );
+	ioRing.pStatx = (struct statx *)calloc( sParams.sq_entries, sizeof(struct statx) );
+	ioRing.piSlot = (int *)calloc( sParams.sq_entries, sizeof(int) );
+	if( ioRing.pSqes == MAP_FAILED || !ioRing.pStatx || !ioRing.piSlot )
+	{
+		if( ioRing.pSqes != MAP_FAILED )
+		{
+			munmap( ioRing.pSqes, sParams.sq_entries * sizeof(struct io_uring_sqe) );
+		}
+		if( pcCq != pcSq )
+		{
+			munmap( pcCq, iCqLen );
+		}
+		munmap( pcSq, iSqLen );
+		free( ioRing.pStatx );
+		free( ioRing.piSlot );
+		close( iFd );
+		return false;
+	}
+	ioRing.puSqHead	 = (unsigned *)(pcSq + sParams.sq_off.head);
+	ioRing.puSqTail	 = (unsigned *)(pcSq + sParams.sq_off.tail);
+	ioRing.puSqMask	 = (unsigned *)(pcSq + sParams.sq_off.ring_mask);
+	ioRing.puSqArray = (unsigned *)(pcSq + sParams.sq_off.array);
+	ioRing.puCqHead	 = (unsigned *)(pcCq + sParams.cq_off.head);
+	ioRing.puCqTail	 = (unsigned *)(pcCq + sParams.cq_off.tail);
+	ioRing.puCqMask	 = (unsigned *)(pcCq + sParams.cq_off.ring_mask);
+	ioRing.pCqes	 = (struct io_uring_cqe *)(pcCq + sParams.cq_off.cqes);
+	ioRing.uEntries	 = sParams.sq_entries;
+	ioRing.pcSq		 = pcSq;
+	ioRing.pcCq		 = pcCq;
+	ioRing.iSqLen	 = iSqLen;
+	ioRing.iCqLen	 = iCqLen;
+	ioRing.iFd		 = iFd;
+	ioRing.iState	 = 1;
+
+	// Release the io_uring when the thread exits, the workers of a deep search are
+	// started anew for each search.
+	pthread_once( &ringOnce, _ringKeyInit );
+	pthread_setspecific( ringKey, &ioRing );
+
+	return true;
+}
+
+/**
+*	_ringStat
+*
+*		Retrieve the file status of all pending directory entries in the range
+*		iFirst..iLast-1 using batches of IORING_OP_STATX operations. Each batch
+*		holds up to IO_RING_ENTRIES requests and costs a single system call.
+*		Entries whose status could not be retrieved remain pending and are left
+*		to the synchronous fstatat() fallback.
+*
+*	@param	pOSArg			Address OS_ARG struct of the current search.
+*	@param	iFirst			Index of the first directory entry.
+*	@param	iLast			Index of the directory entry following the range.
+**/
+static void _ringStat( OS_ARG *pOSArg, int iFirst, int iLast )
+{
+	struct io_uring_sqe	*pSqe;
+	struct io_uring_cqe	*pCqe;
+	struct statx		*pStatx;
+	DIR_ENTRY	*pEntry;
+	unsigned	uTail,
+				uHead,
+				uIdx,
+				uSlot,
+				uCount,
+				uSubmitted,
+				uDone;
+	int			iNext = iFirst,
+				iResult;
+
+	if( !_ringInit() )
+	{
+		return;
+	}
+	while( iNext < iLast && ioRing.iState > 0 )
+	{
+		// Fill the submission queue.
+		uTail  = *ioRing.puSqTail;
+		uCount = 0;
+		for( ; iNext < iLast && uCount < ioRing.uEntries; iNext++ )
+		{
+			if( pOSArg->pEntries[iNext].iStatus == STAT_V_PENDING )
+			{
+				uIdx = uTail & *ioRing.puSqMask;
+				pSqe = &ioRing.pSqes[uIdx];
+				memset( pSqe, 0, sizeof(struct io_uring_sqe) );
+				pSqe->opcode	= IORING_OP_STATX;
+				pSqe->fd		= pOSArg->iDirFd;
+				pSqe->addr		= (uint64_t)(uintptr_t)&pOSArg->pcNames[pOSArg->pEntries[iNext].iName];
+				pSqe->len		= STATX_TYPE | STATX_SIZE | STATX_MTIME | STATX_INO | STATX_NLINK;
+				pSqe->statx_flags = AT_SYMLINK_NOFOLLOW;
+				pSqe->off		= (uint64_t)(uintptr_t)&ioRing.pStatx[uCount];
+				pSqe->user_data = uCount;
+
+				ioRing.piSlot[uCount]  = iNext;
+				ioRing.puSqArray[uIdx] = uIdx;
+				uTail++;
+				uCount++;
+			}
+		}
+		if( !uCount )
+		{
+			break;
+		}
+		__atomic_store_n( ioRing.puSqTail, uTail, __ATOMIC_RELEASE );
+
+		// Submit and wait for all completions. The kernel may accept fewer entries
+		// than offered, in which case the remainder is offered again.
+		for( uSubmitted = 0; uSubmitted < uCount; )
+		{
+			sysCountAdd( lSubmit );
+			iResult = (int)syscall( __NR_io_uring_enter, ioRing.iFd, uCount - uSubmitted, uCount - uSubmitted,
+									IORING_ENTER_GETEVENTS, NULL, 0 );
+			if( iResult > 0 )
+			{
+				uSubmitted += (unsigned)iResult;
+			}
+			else if( iResult == 0 || errno != EINTR )
+			{
+				break;
+			}
+		}
+		if( uSubmitted < uCount )
+		{
+			// Withdraw the entries not submitted, they remain pending and are left to
+			// the fstatat() fallback. Entries already submitted are still collected.
+			__atomic_store_n( ioRing.puSqTail, __atomic_load_n( ioRing.puSqHead, __ATOMIC_ACQUIRE ), __ATOMIC_RELEASE );
+			ioRing.iState = -1;
+		}
+		for( uDone = 0; uDone < uSubmitted; )
+		{
+			uHead = *ioRing.puCqHead;
+			if( uHead == __atomic_load_n( ioRing.puCqTail, __ATOMIC_ACQUIRE ) )
+			{
+				sysCountAdd( lSubmit );
+				if( syscall( __NR_io_uring_enter, ioRing.iFd, 0, uSubmitted - uDone, IORING_ENTER_GETEVENTS, NULL, 0 ) < 0 &&
+					errno != EINTR )
+				{
+					ioRing.iState = -1;
+					return;
+				}
+				continue;
+			}
+			pCqe   = &ioRing.pCqes[uHead & *ioRing.puCqMask];
+			uSlot  = (unsigned)pCqe->user_data;
+			pEntry = &pOSArg->pEntries[ioRing.piSlot[uSlot]];
+			pStatx = &ioRing.pStatx[uSlot];
+
+			// Symbolic links remain pending, _statAt() records the link and its target.
+			if( pCqe->res == 0 && !S_ISLNK( pStatx->stx_mode ) )
+			{
+				pEntry->directory = S_ISDIR( pStatx->stx_mode ) ? 1 : 0;
+				pEntry->lSize	  = (long)pStatx->stx_size;
+				pEntry->lModified = (long)pStatx->stx_mtime.tv_sec;
+				pEntry->lDevice	  = (unsigned long)makedev( pStatx->stx_dev_major, pStatx->stx_dev_minor );
+				pEntry->lInode	  = (unsigned long)pStatx->stx_ino;
+				pEntry->iLinks	  = (int)pStatx->stx_nlink;
+				pEntry->iStatus	  = STAT_V_OK;
+			}
+			else if( pCqe->res == -EINVAL || pCqe->res == -EOPNOTSUPP )
+			{
+				ioRing.iState = -1;		// IORING_OP_STATX not supported.
+			}
+			__atomic_store_n( ioRing.puCqHead, uHead + 1, __ATOMIC_RELEASE );
+			uDone++;
+		}
+	}
+}
+#endif /* IO_URING_SUPPORT */
+
+/**
+*	_statDirectory
+*
+*		Retrieve the file status of the next IO_RING_ENTRIES directory entries,
+*		starting at index iFirst, that require one. If available an io_uring is
+*		used to batch the requests, any entries left pending are stat-ed
+*		synchronously using fstatat(). The file status is retrieved on demand,
+*		that is, entries which are skipped are never stat-ed.
+*
+*	@param	pOSArg			Address OS_ARG struct of the current search.
+*	@param	iFirst			Index of the first directory entry.
+**/
+static void _statDirectory( OS_ARG *pOSArg, int iFirst )
+{
+	DIR_ENTRY	*pEntry;
+	int			iLast = iFirst + IO_RING_ENTRIES,
+				i;
+#ifdef IO_URING_SUPPORT
+	int			iPending = 0;
+#endif /* IO_URING_SUPPORT */
+
+	if( iLast > pOSArg->iCount )
+	{
+		iLast = pOSArg->iCount;
+	}
+#ifdef IO_URING_SUPPORT
+	for( i = iFirst; i < iLast; i++ )
+	{
+		iPending += (pOSArg->pEntries[i].iStatus == STAT_V_PENDING);
+	}
+	if( iPending > 1 )
+	{
+		_ringStat( pOSArg, iFirst, iLast );
+	}
+#endif /* IO_URING_SUPPORT */
+	for( i = iFirst; i < iLast; i++ )
+	{
+		pEntry = &pOSArg->pEntries[i];
+		if( pEntry->iStatus == STAT_V_PENDING )
+		{
+			_statAt( pOSArg->iDirFd, &pOSArg->pcNames[pEntry->iName], pEntry );
+		}
+	}
+}
+
+/**
+*	_addEntry
+*
+*		Add a raw directory entry to the directory level of an OS_ARG struct. If
+*		neither the size nor the last modified property of a file is required and
+*		the directory entry type is known, the file is classified by its entry type
+*		(d_type) and no stat call is made at all. All other entries are marked
+*		pending and are stat-ed in batches when they are read (see _readDirectory()).
+*		Entries whose name does not match the query are not added.
+*
+*	@param	pOSArg			Address OS_ARG struct of the current search.
+*	@param	pcFilename		Address C-string containing the filename.
+*	@param	iType			Directory entry type (DT_xxx)
+*	@param	pArgs			Address arguments struct
+*
+*	@return		1 if successful otherwise 0.
+**/
+static int _addEntry( OS_ARG *pOSArg, const char *pcFilename, int iType, ARGS *pArgs )
+{
+	DIR_ENTRY	*pEntry;
+	void		*pvNew;
+	size_t		iNameLen;
+
+	if( _skipFile( pcFilename, pArgs ) )
+	{
+		return 1;
+	}
+	// Drop entries whose name doesn't match the query before they are stat-ed,
+	// unless the entry may be a directory of a deep search.
+	if( pArgs->pQuery && !queryMatchName( pArgs->pQuery, pcFilename ) &&
+		(!pArgs->pOptions->bDeep || (iType != DT_DIR && iType != DT_LNK && iType != DT_UNKNOWN)) )
+	{
+		return 1;
+	}
+	iNameLen = strlen( pcFilename ) + 1;
+	if( pOSArg->iCount == pOSArg->iSize )
+	{
+		pOSArg->iSize = pOSArg->iSize ? pOSArg->iSize * 2 : 64;
+		if( !(pvNew = realloc( pOSArg->pEntries, pOSArg->iSize * sizeof(DIR_ENTRY) )) )
+		{
+			return 0;
+		}
+		pOSArg->pEntries = (DIR_ENTRY *)pvNew;
+	}
+	if( pOSArg->iNameLen + iNameLen > pOSArg->iNameSize )
+	{
+		pOSArg->iNameSize = pOSArg->iNameSize ? pOSArg->iNameSize * 2 : 4096;
+		if( pOSArg->iNameSize < pOSArg->iNameLen + iNameLen )
+		{
+			pOSArg->iNameSize = pOSArg->iNameLen + iNameLen;
+		}
+		if( !(pvNew = realloc( pOSArg->pcNames, pOSArg->iNameSize )) )
+		{
+			return 0;
+		}
+		pOSArg->pcNames = (char *)pvNew;
+	}
+	pEntry = &pOSArg->pEntries[pOSArg->iCount++];
+	pEntry->iName = pOSArg->iNameLen;
+	pEntry->bLink = false;
+	memcpy( &pOSArg->pcNames[pOSArg->iNameLen], pcFilename, iNameLen );
+	pOSArg->iNameLen += iNameLen;
+
+	// Symbolic links and unknown entry types always need a file status.
+	if( (pArgs->iNeedMask & (PROP_M_SIZE | PROP_M_MODIFIED)) || iType == DT_UNKNOWN || iType == DT_LNK )
+	{
+		pEntry->iStatus = STAT_V_PENDING;
+	}
+	else
+	{
+		pEntry->directory = (iType == DT_DIR);
+		pEntry->iStatus	  = STAT_V_NONE;
+	}
+	return 1;
+}
+
+/**
+*	_loadDirectory
+*
+*		Load all entries of the directory associated with an OS_ARG struct. If the
+*		directory listing cache holds a valid listing of the directory the entries
+*		are taken from the cache, otherwise the directory entries are read in large
+*		batches using getdents64() and the listing is added to the cache. A listing
+*		is a sequence of records, each record holds the entry type followed by the
+*		zero terminated filename. The listing includes all entries, except "." and
+*		"..", regardless of the arguments of the current search.
+*
+*	@param	pOSArg			Address OS_ARG struct of the current search.
+*	@param	pcDirPath		Address C-string containing the full directory path.
+*	@param	pArgs			Address arguments struct
+*
+*	@return		1 if successful otherwise 0.
+**/
+static int _loadDirectory( OS_ARG *pOSArg, const char *pcDirPath, ARGS *pArgs )
+{
+	struct linux_dirent64	*pDirEnt;
+	struct stat	sStat;
+	CACHE_KEY	sKey;
+	void		*pvNew;
+	char		*pcDirBuf,
+				*pcList = NULL,
+				*pcRecord;
+	size_t		iListLen  = 0,
+				iListSize = 0,
+				iNameLen;
+	bool		bCache = false;
+	long		lCount,
+				lPos;
+
+	if( cacheEnabled() )
+	{
+		sysCountAdd( lStat );
+		bCache = !fstat( pOSArg->iDirFd, &sStat ) && cacheKey( &sKey, pcDirPath, &sStat );
+	}
+	if( bCache && (pcList = cacheRead( &sKey, &iListLen )) )
+	{
+		for( pcRecord = pcList; pcRecord < &pcList[iListLen]; pcRecord += strlen( &pcRecord[1] ) + 2 )
+		{
+			if( !_addEntry( pOSArg, &pcRecord[1], (unsigned char)pcRecord[0], pArgs ) )
+			{
+				break;
+			}
+		}
+		free( pcList );
+		return 1;
+	}
+	if( !(pcDirBuf = (char *)malloc( DIRENT_BUF_SIZE )) )
+	{
+		return 0;
+	}
+	while( true )
+	{
+		sysCountAdd( lRead );
+		lCount = syscall( SYS_getdents64, pOSArg->iDirFd, pcDirBuf, DIRENT_BUF_SIZE );
+		if( lCount <= 0 )
+		{
+			bCache = bCache && (lCount == 0);
+			break;
+		}
+		for( lPos = 0; lPos < lCount; lPos += pDirEnt->d_reclen )
+		{
+			pDirEnt = (struct linux_dirent64 *)&pcDirBuf[lPos];
+			if( bCache && !(pDirEnt->d_name[0] == '.' && (!pDirEnt->d_name[1] || 
+							(pDirEnt->d_name[1] == '.' && !pDirEnt->d_name[2]))) )
+			{
+				// Append the raw entry to the listing to be cached.
+				iNameLen = strlen( pDirEnt->d_name ) + 1;
+				if( iListLen + iNameLen + 1 > iListSize )
+				{
+					iListSize = (iListSize ? iListSize * 2 : 4096) + iNameLen + 1;
+					if( (pvNew = realloc( pcList, iListSize )) )
+					{
+						pcList = (char *)pvNew;
+					}
+					else // Out of memory, don't cache the listing.
+					{
+						bCache = false;
+					}
+				}
+				if( bCache )
+				{
+					pcList[iListLen] = (char)pDirEnt->d_type;
+					memcpy( &pcList[iListLen + 1], pDirEnt->d_name, iNameLen );
+					iListLen += iNameLen + 1;
+				}
+			}
+			if( !_addEntry( pOSArg, pDirEnt->d_name, pDirEnt->d_type, pArgs ) )
+			{
+				bCache = false;
+				break;
+			}
+		}
+	}
+	if( bCache )
+	{
+		cacheWrite( &sKey, pcList ? pcList : "", iListLen );
+	}
+	free( pcList );
+	free( pcDirBuf );
+	return 1;
+}
+
+/**
+*	_loadResident
+*
+*		Load all entries of a directory from the resident file tree (daemon mode
+*		only, see cbtreeTree.c). The file status of each entry is taken from the
+*		tree therefore no system calls are made at all.
+*
+*	@param	pOSArg			Address OS_ARG struct of the current search.
+*	@param	pNode			Address TREE_NODE struct of the directory.
+*	@param	pArgs			Address arguments struct
+*
+*	@return		1 if successful otherwise 0.
+**/
+static int _loadResident( OS_ARG *pOSArg, TREE_NODE *pNode, ARGS *pArgs )
+{
+	TREE_NODE	*pChild;
+	DIR_ENTRY	*pEntry;
+	int			iCount,
+				i;
+
+	for( i = 0; i < pNode->iCount; i++ )
+	{
+		pChild = pNode->ppChildren[i];
+		iCount = pOSArg->iCount;
+		if( !_addEntry( pOSArg, pChild->cName, (pChild->directory ? DT_DIR : DT_REG), pArgs ) )
+		{
+			return 0;
+		}
+		if( pOSArg->iCount > iCount )
+		{
+			pEntry = &pOSArg->pEntries[iCount];
+			if( pEntry->iStatus == STAT_V_PENDING )
+			{
+				pEntry->directory = pChild->directory;
+				pEntry->lSize	  = pChild->lSize;
+				pEntry->lModified = pChild->lModified;
+				pEntry->iLinks	  = 0;
+				pEntry->iStatus	  = STAT_V_OK;
+			}
+		}
+	}
+	return 1;
+}
+
+/**
+*	_loadSnapshot
+*
+*		Load all entries of a directory from the file tree snapshot (see cbtreeIndex.c).
+*		The file status of each entry is taken from the snapshot therefore no system
+*		calls are made at all.
+*
+*	@param	pOSArg			Address OS_ARG struct of the current search.
+*	@param	pDir			Address INDEX_NODE struct of the directory.
+*	@param	pArgs			Address arguments struct
+*
+*	@return		1 if successful otherwise 0.
+**/
+static int _loadSnapshot( OS_ARG *pOSArg, const INDEX_NODE *pDir, ARGS *pArgs )
+{
+	const INDEX_NODE	*pChild;
+	INDEX_ITER	sIter;
+	DIR_ENTRY	*pEntry;
+	int			iCount;
+
+	for( indexFirst( &sIter, pDir ); (pChild = indexNext( &sIter )); )
+	{
+		iCount = pOSArg->iCount;
+		if( !_addEntry( pOSArg, sIter.cName, ((pChild->iFlags & INDEX_M_DIRECTORY) ? DT_DIR : DT_REG), pArgs ) )
+		{
+			return 0;
+		}
+		if( pOSArg->iCount > iCount )
+		{
+			pEntry = &pOSArg->pEntries[iCount];
+			if( pEntry->iStatus == STAT_V_PENDING )
+			{
+				pEntry->directory = (pChild->iFlags & INDEX_M_DIRECTORY) ? true : false;
+				pEntry->lSize	  = (long)pChild->lSize;
+				pEntry->lModified = (long)pChild->lModified;
+				pEntry->iLinks	  = 0;
+				pEntry->iStatus	  = STAT_V_OK;
+			}
+		}
+	}
+	return 1;
+}
+
+/**
+*	_readDirectory
+*
+*		Returns the next entry of the directory level loaded by _loadDirectory()
+*		as a FILE_INFO struct. If the entry still requires a file status, the
+*		status of the next batch of entries is retrieved first. Entries that
+*		vanished after being read from the directory or do not match the query
+*		are skipped.
+*
+*	@param	pOSArg			Address OS_ARG struct of the current search.
+*	@param	pArgs			Address arguments struct
+*
+*	@return		On sucess, pointer to a FILE_INFO struct otherwise NULL
+**/
+static FILE_INFO *_readDirectory( OS_ARG *pOSArg, ARGS *pArgs )
+{
+	DIR_ENTRY	*pEntry;
+
+	while( pOSArg->iNext < pOSArg->iCount )
+	{
+		pEntry = &pOSArg->pEntries[pOSArg->iNext];
+		if( pEntry->iStatus == STAT_V_PENDING )
+		{
+			_statDirectory( pOSArg, pOSArg->iNext );
+		}
+		pOSArg->iNext++;
+		if( pEntry->iStatus != STAT_V_FAILED && 
+			!_queryFilter( &pOSArg->pcNames[pEntry->iName], pEntry, pArgs ) )
+		{
+			return _fileToStruct( pOSArg, &pOSArg->pcNames[pEntry->iName], pEntry, pArgs );
+		}
+	}
 	return NULL;
-#endif /* WIN32 */
 }
 
+/**
+*	_skipDirectory
+*
+*		Skip the next entry of the directory level loaded by _loadDirectory(). The
+*		entry is not converted to a FILE_INFO struct and no file status is retrieved
+*		unless the query tests any properties other than the filename.
+*
+*	@param	pOSArg			Address OS_ARG struct of the current search.
+*	@param	pArgs			Address arguments struct
+*
+*	@return		True if an entry was skipped, false if there are no more entries.
+**/
+static bool _skipDirectory( OS_ARG *pOSArg, ARGS *pArgs )
+{
+	DIR_ENTRY	*pEntry;
+
+	if( !pArgs->pQuery || !(pArgs->pQuery->iPropMask & ~PROP_M_NAME) )
+	{
+		if( pOSArg->iNext < pOSArg->iCount )
+		{
+			pOSArg->iNext++;
+			return true;
+		}
+		return false;
+	}
+	while( pOSArg->iNext < pOSArg->iCount )
+	{
+		pEntry = &pOSArg->pEntries[pOSArg->iNext];
+		if( pEntry->iStatus == STAT_V_PENDING )
+		{
+			_statDirectory( pOSArg, pOSArg->iNext );
+		}
+		pOSArg->iNext++;
+		if( pEntry->iStatus != STAT_V_FAILED && 
+			!_queryFilter( &pOSArg->pcNames[pEntry->iName], pEntry, pArgs ) )
+		{
+			return true;
+		}
+	}
+	return false;
+}
+#else
+/**
+*	_selectEntry
+*
+*		Returns true if a directory entry is selected, that is, it isn't skipped,
+*		it still exists and it matches the query, if any. If the file size and last
+*		modified properties are not required and the directory entry type is known
+*		no file status is retrieved.
+*
+*	@param	pOSArg			Address OS_ARG struct of the current search.
+*	@param	pDirEnt			Address dirent struct.
+*	@param	pEntry			Address DIR_ENTRY struct receiving the file status.
+*	@param	pArgs			Address arguments struct
+*
+*	@return		True or false.
+**/
+static bool _selectEntry( OS_ARG *pOSArg, struct dirent *pDirEnt, DIR_ENTRY *pEntry, ARGS *pArgs )
+{
+	if( _skipFile( pDirEnt->d_name, pArgs ) ||
+		(pArgs->pQuery && !pArgs->pOptions->bDeep && !queryMatchName( pArgs->pQuery, pDirEnt->d_name )) )
+	{
+		return false;
+	}
+	pEntry->iStatus = STAT_V_PENDING;
+	pEntry->bLink	= false;
+  #ifdef DT_UNKNOWN
+	// Classify by entry type if neither size nor modified is required.
+	if( !(pArgs->iNeedMask & (PROP_M_SIZE | PROP_M_MODIFIED)) &&
+		pDirEnt->d_type != DT_UNKNOWN && pDirEnt->d_type != DT_LNK )
+	{
+		pEntry->directory = (pDirEnt->d_type == DT_DIR);
+		pEntry->iStatus	  = STAT_V_NONE;
+	}
+  #endif /* DT_UNKNOWN */
+	if( pEntry->iStatus == STAT_V_PENDING && _statAt( pOSArg->iDirFd, pDirEnt->d_name, pEntry ) )
+	{
+		return false;
+	}
+	return !_queryFilter( pDirEnt->d_name, pEntry, pArgs );
+}
+
+/**
+*	_readDirectory
+*
+*		Read the next selected entry from the directory stream associated with an
+*		OS_ARG struct and convert it to a FILE_INFO struct (see _selectEntry()).
+*
+*	@param	pOSArg			Address OS_ARG struct of the current search.
+*	@param	pArgs			Address arguments struct
+*
+*	@return		On sucess, pointer to a FILE_INFO struct otherwise NULL
+**/
+static FILE_INFO *_readDirectory( OS_ARG *pOSArg, ARGS *pArgs )
+{
+	struct dirent	*pDirEnt;
+	DIR_ENTRY		sEntry;
+
+	if( pOSArg->pDir )
+	{
+		sysCountAdd( lRead );
+		while( (pDirEnt = readdir( pOSArg->pDir )) )
+		{
+			if( _selectEntry( pOSArg, pDirEnt, &sEntry, pArgs ) )
+			{
+				return _fileToStruct( pOSArg, pDirEnt->d_name, &sEntry, pArgs );
+			}
+			sysCountAdd( lRead );
+		}
+	}
+	return NULL;
+}
+
+/**
+*	_skipDirectory
+*
+*		Skip the next entry of the directory stream associated with an OS_ARG
+*		struct. No file status is retrieved for the skipped entry unless there is
+*		a query.
+*
+*	@param	pOSArg			Address OS_ARG struct of the current search.
+*	@param	pArgs			Address arguments struct
+*
+*	@return		True if an entry was skipped, false if there are no more entries.
+**/
+static bool _skipDirectory( OS_ARG *pOSArg, ARGS *pArgs )
+{
+	struct dirent	*pDirEnt;
+	DIR_ENTRY		sEntry;
+
+	if( pOSArg->pDir )
+	{
+		sysCountAdd( lRead );
+		while( (pDirEnt = readdir( pOSArg->pDir )) )
+		{
+			if( pArgs->pQuery ? _selectEntry( pOSArg, pDirEnt, &sEntry, pArgs ) 
+							  : !_skipFile( pDirEnt->d_name, pArgs ) )
+			{
+				return true;
+			}
+			sysCountAdd( lRead );
+		}
+	}
+	return false;
+}
+#endif /* __linux__ */
+#endif /* WIN32 */
+
 /**
 *	findFile_NP
 *
@@ -111,9 +1157,19 @@ static FILE_INFO *_fileToStruct( char *pcFullPath, char *pcRootDir, void *pvFile
 *		The value of the handle must be passed as an argument to all subsequent calls
 *		to findNextFile_NP().
 *
+*		On POSIX systems, if the last segment of pcFullPath is an asterisk (*) the
+*		directory is opened and the first directory entry is returned, otherwise the
+*		file identified by pcFullPath is returned. In the latter case findNextFile_NP()
+*		will not return any additional files.
+*
+*		The resident file tree and the file tree snapshot, if any, are only used
+*		to answer read-only searches. Requests that mutate the file system set
+*		pArgs->bLive and always search the live file system.
+*
 *	@param	pcFullPath		Address C-string containing the full directory path.
 *	@param	pcRootDir		Address C-string containing the root directory.
 *	@param	pvOsArgm		Address of an OS specific argument returned to the caller.
+*	@param	pArgs			Address arguments struct
 *	@param	piResult		Address of an integer recieving the result code
 *							HTTP_V_OK or HTTP_V_NOT_FOUND.
 *
@@ -125,11 +1181,23 @@ FILE_INFO *findFile_NP( char *pcFullPath, char *pcRootDir, void *pvOsArgm, ARGS
 	WIN32_FIND_DATA	sFileData;
 	FILE_INFO		*pFileInfo = NULL;
 	HANDLE			handle;	
+	size_t			iPathLen = strlen( pcFullPath );
 
+	sysCountAdd( lOpen );
 	handle = FindFirstFile( pcFullPath, &sFileData );
 	if( handle != INVALID_HANDLE_VALUE )
 	{
-		pFileInfo = _fileToStruct( pcFullPath, pcRootDir, &sFileData, pArgs );
+		// The first entry of a directory search is subject to the same selection
+		// as all subsequent entries.
+		if( iPathLen > 1 && !strcmp( &pcFullPath[iPathLen-2], "/*" ) && 
+			_skipFindData( &sFileData, pArgs ) )
+		{
+			pFileInfo = findNextFile_NP( pcFullPath, pcRootDir, &handle, pArgs );
+		}
+		else
+		{
+			pFileInfo = _fileToStruct( pcFullPath, pcRootDir, &sFileData, pArgs );
+		}
 		*piResult = HTTP_V_OK;
 		if( pvOsArgm ) {
 			*((HANDLE *)pvOsArgm) = handle;
@@ -143,8 +1211,115 @@ FILE_INFO *findFile_NP( char *pcFullPath, char *pcRootDir, void *pvOsArgm, ARGS
 	}
 	return pFileInfo;
 #else
-	#error Function findFile_NP() not implemented
-	return NULL;
+	OS_ARG		sOSArg,
+				*pOSArg = pvOsArgm ? (OS_ARG *)pvOsArgm : &sOSArg;
+	FILE_INFO	*pFileInfo = NULL;
+	DIR_ENTRY	sEntry;
+  #ifdef __linux__
+	const INDEX_NODE	*pIndex = NULL;
+	TREE_NODE	*pNode = NULL;
+  #endif /* __linux__ */
+	char		cDirPath[MAX_PATH_SIZE],
+				*pcRelPath = pOSArg->cRelPath,
+				*pcFilename;
+	size_t		iPathLen = strlen( pcFullPath );
+
+	memset( pOSArg, 0, sizeof(OS_ARG) );
+	pOSArg->iDirFd = -1;
+	*piResult	   = HTTP_V_NOT_FOUND;
+
+	if( iPathLen >= sizeof(cDirPath) )
+	{
+		return NULL;
+	}
+	// Get the relative path of the directory (including the trailing slash).
+	getRelativePath( pcFullPath, pcRootDir, "", &pcRelPath );
+	pOSArg->iRelLen = strlen( pcRelPath );
+
+	if( iPathLen > 1 && !strcmp( &pcFullPath[iPathLen-2], "/*" ) )
+	{
+		strncpyz( cDirPath, pcFullPath, iPathLen-2 );
+  #ifdef __linux__
+		// Use the resident file tree or snapshot, if any, unless the directory isn't
+		// resident or the request mutates the file system.
+		if( !pArgs->bLive && (pNode = treeLookup( cDirPath )) && pNode->directory && pNode->iWatch != -1 )
+		{
+			if( _loadResident( pOSArg, pNode, pArgs ) )
+			{
+				*piResult = HTTP_V_OK;
+				pFileInfo = _readDirectory( pOSArg, pArgs );
+			}
+		}
+		else if( !pArgs->bLive && (pIndex = indexLookup( cDirPath )) && (pIndex->iFlags & INDEX_M_LISTED) )
+		{
+			if( _loadSnapshot( pOSArg, pIndex, pArgs ) )
+			{
+				*piResult = HTTP_V_OK;
+				pFileInfo = _readDirectory( pOSArg, pArgs );
+			}
+		}
+		else
+  #endif /* __linux__ */
+		{
+			// Requests that modify the file system never open a directory through a
+			// symbolic link.
+			sysCountAdd( lOpen );
+			if( (pOSArg->iDirFd = open( cDirPath, O_RDONLY | O_DIRECTORY | O_CLOEXEC | (pArgs->bLive ? O_NOFOLLOW : 0) )) != -1 )
+			{
+  #ifdef __linux__
+				if( _loadDirectory( pOSArg, cDirPath, pArgs ) )
+  #else
+				if( (pOSArg->pDir = fdopendir( pOSArg->iDirFd )) )
+  #endif /* __linux__ */
+				{
+					*piResult = HTTP_V_OK;
+					pFileInfo = _readDirectory( pOSArg, pArgs );
+				}
+				else
+				{
+					close( pOSArg->iDirFd );
+					pOSArg->iDirFd = -1;
+				}
+			}
+		}
+	}
+	else // Single file
+	{
+  #ifdef __linux__
+		// Mutations must see the file system as it is now.
+		if( !pArgs->bLive && (pNode = treeLookup( pcFullPath )) )
+		{
+			sEntry.directory = pNode->directory;
+			sEntry.lSize	 = pNode->lSize;
+			sEntry.lModified = pNode->lModified;
+			sEntry.iLinks	 = 0;
+			sEntry.bLink	 = false;
+			sEntry.iStatus	 = STAT_V_OK;
+		}
+		else if( !pArgs->bLive && (pIndex = indexLookup( pcFullPath )) )
+		{
+			sEntry.directory = (pIndex->iFlags & INDEX_M_DIRECTORY) ? true : false;
+			sEntry.lSize	 = (long)pIndex->lSize;
+			sEntry.lModified = (long)pIndex->lModified;
+			sEntry.iLinks	 = 0;
+			sEntry.bLink	 = false;
+			sEntry.iStatus	 = STAT_V_OK;
+		}
+		if( pNode || pIndex || !_statAt( AT_FDCWD, pcFullPath, &sEntry ) )
+  #else
+		if( !_statAt( AT_FDCWD, pcFullPath, &sEntry ) )
+  #endif /* __linux__ */
+		{
+			pcFilename = strrchr( pcFullPath, '/' );
+			pFileInfo  = _fileToStruct( pOSArg, (pcFilename ? pcFilename + 1 : pcFullPath), &sEntry, pArgs );
+			*piResult  = HTTP_V_OK;
+		}
+	}
+	if( pOSArg == &sOSArg )
+	{
+		findEnd_NP( pOSArg );
+	}
+	return pFileInfo;
 #endif /* WIN32 */
 }
 
@@ -166,24 +1341,84 @@ FILE_INFO *findNextFile_NP( char *pcFullPath, char *pcRootDir, void *pvOsArgm, A
 
 	if( pvOsArgm )
 	{
-		if( FindNextFile( *((HANDLE *)pvOsArgm), &sFileData ) )
+		sysCountAdd( lRead );
+		while( FindNextFile( *((HANDLE *)pvOsArgm), &sFileData ) )
 		{
-			return _fileToStruct( pcFullPath, pcRootDir, &sFileData, pArgs );
+			if( !_skipFindData( &sFileData, pArgs ) )
+			{
+				return _fileToStruct( pcFullPath, pcRootDir, &sFileData, pArgs );
+			}
+			sysCountAdd( lRead );
 		}
 	}
 	return NULL;
 #else
-	#error Function findNextFile_NP() not implemented
+	(void)pcFullPath;
+	(void)pcRootDir;
+
+	if( pvOsArgm )
+	{
+		return _readDirectory( (OS_ARG *)pvOsArgm, pArgs );
+	}
 	return NULL;
 #endif /* WIN32 */
 
 }
 
+/**
+*	findSkipFile_NP
+*
+*		Skip the next file of a file search started by findFile_NP(). The file is
+*		subject to the same selection as the files returned by findNextFile_NP()
+*		but no FILE_INFO struct is allocated and, if possible, no file status is
+*		retrieved. This allows the caller to count files cheaply.
+*
+*	@param	pcFullPath		Address C-string containing the full directory path.
+*	@param	pcRootDir		Address C-string containing the root directory.
+*	@param	pvOsArgm		Address OS specific argument, if any
+*	@param	pArgs			Address arguments struct
+*
+*	@return		True if a file was skipped, false if there are no more files.
+**/
+bool findSkipFile_NP( char *pcFullPath, char *pcRootDir, void *pvOsArgm, ARGS *pArgs )
+{
+#ifdef WIN32
+	WIN32_FIND_DATA	sFileData;
+
+	(void)pcFullPath;
+	(void)pcRootDir;
+
+	if( pvOsArgm )
+	{
+		sysCountAdd( lRead );
+		while( FindNextFile( *((HANDLE *)pvOsArgm), &sFileData ) )
+		{
+			if( !_skipFindData( &sFileData, pArgs ) )
+			{
+				return true;
+			}
+			sysCountAdd( lRead );
+		}
+	}
+	return false;
+#else
+	(void)pcFullPath;
+	(void)pcRootDir;
+
+	if( pvOsArgm )
+	{
+		return _skipDirectory( (OS_ARG *)pvOsArgm, pArgs );
+	}
+	return false;
+#endif /* WIN32 */
+}
+
 /**
 *	findEnd_NP
 *
 *		Terminate the file search. In case of Microsoft Windows the stream associated
-*		with the search handle is closed. Other operating systems may not require any
+*		with the search handle is closed. On POSIX systems the directory stream and
+*		its file descriptor are closed. Other operating systems may not require any
 *		action.
 **/
 void findEnd_NP( void *pvOsArg )
@@ -191,6 +1426,204 @@ void findEnd_NP( void *pvOsArg )
 #ifdef WIN32
 	FindClose( *((HANDLE *)pvOsArg) );
 #else
-	#error Function findEnd_NP() not implemented
+	OS_ARG	*pOSArg = (OS_ARG *)pvOsArg;
+
+  #ifdef __linux__
+	if( pOSArg->iDirFd != -1 )
+	{
+		close( pOSArg->iDirFd );
+	}
+	free( pOSArg->pEntries );
+	free( pOSArg->pcNames );
+	pOSArg->pEntries = NULL;
+	pOSArg->pcNames  = NULL;
+	pOSArg->iCount	 = 0;
+  #else
+	if( pOSArg->pDir )
+	{
+		closedir( pOSArg->pDir );		// Also closes iDirFd
+	}
+	pOSArg->pDir   = NULL;
+  #endif /* __linux__ */
+	pOSArg->iDirFd = -1;
+#endif /* WIN32 */
+}
+
+/**
+*	getFileTag_NP
+*
+*		Compute the validator of a file search result without performing the
+*		search. The validator is derived from the identity and last modified time
+*		of the file and the query string. The last modified time of a directory
+*		does not reflect changes to the size or last modified time of its children
+*		or to its subdirectories. Therefore, unless the file tree is served from
+*		the resident file tree or a snapshot, the only directory search that gets
+*		a validator is a search that is not deep and needs neither the size nor
+*		the last modified time of the children. That response consists of the
+*		names and types of the children only. Creating, removing or renaming a
+*		child changes the directory itself.
+*
+*		NOTE:	The type of a symbolic link child is the type of its target. If a
+*				link is replaced in place, or its target is replaced, by a file of
+*				another type (file versus directory) the directory is unchanged and
+*				so is the validator. A client may then receive 304 Not Modified
+*				with a stale 'directory' property for that child.
+*
+*	@param	pcFullPath		Address C-string containing the full path.
+*	@param	pcQuery			Address C-string containing the query string or NULL.
+*	@param	bDeep			True if a deep search is requested.
+*	@param	iNeedMask		File properties returned, searched or sorted (PROP_M_xxx)
+*	@param	pTag			Address FILE_TAG struct receiving the validator.
+*
+*	@return		True if the file exists otherwise false.
+**/
+bool getFileTag_NP( const char *pcFullPath, const char *pcQuery, bool bDeep, int iNeedMask, FILE_TAG *pTag )
+{
+	unsigned long	alState[5] = { 0, 0, 0, 0, 0 };
+	const unsigned char	*pcByte;
+	size_t			i;
+	bool			bNamesOnly = !bDeep && !(iNeedMask & (PROP_M_SIZE | PROP_M_MODIFIED));
+#ifdef WIN32
+	WIN32_FILE_ATTRIBUTE_DATA	sData;
+#else
+	struct stat		sStat;
+  #ifdef __linux__
+	const INDEX_NODE	*pIndex;
+	TREE_NODE		*pNode;
+  #endif /* __linux__ */
+#endif /* WIN32 */
+
+	pTag->lHash		= 2166136261UL;		// FNV-1a
+	pTag->lModified	= -1;
+	pTag->bValid	= false;
+
+#ifdef WIN32
+	sysCountAdd( lStat );
+	if( !GetFileAttributesEx( pcFullPath, GetFileExInfoStandard, &sData ) )
+	{
+		return false;
+	}
+	if( (sData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && !bNamesOnly )
+	{
+		return true;
+	}
+	alState[0] = sData.ftLastWriteTime.dwLowDateTime;
+	alState[1] = sData.ftLastWriteTime.dwHighDateTime;
+	alState[2] = sData.nFileSizeLow;
+	pTag->lModified = (long)_fileTimeToTime( &sData.ftLastWriteTime );
+#else
+  #ifdef __linux__
+	if( (pNode = treeLookup( pcFullPath )) && (!pNode->directory || pNode->iWatch != -1) )
+	{
+		// Any change to the resident file tree changes the validator.
+		alState[0] = (unsigned long)treeStats()->lLoaded;
+		alState[1] = (unsigned long)treeStats()->lEvents;
+		alState[2] = (unsigned long)pNode->lSize;
+		pTag->lModified = bDeep ? -1 : pNode->lModified;
+	}
+	else if( (pIndex = indexLookup( pcFullPath )) )
+	{
+		alState[0] = (unsigned long)indexCreated();
+		alState[1] = (unsigned long)pIndex->lSize;
+		pTag->lModified = (long)indexCreated();
+	}
+	else
+  #endif /* __linux__ */
+	{
+		sysCountAdd( lStat );
+		if( stat( pcFullPath, &sStat ) )
+		{
+			return false;
+		}
+		if( S_ISDIR( sStat.st_mode ) && !bNamesOnly )
+		{
+			return true;
+		}
+		alState[0] = (unsigned long)sStat.st_ino;
+		alState[1] = (unsigned long)sStat.st_dev;
+		alState[2] = (unsigned long)sStat.st_size;
+  #ifdef __linux__
+		alState[3] = (unsigned long)sStat.st_mtim.tv_nsec;
+  #endif /* __linux__ */
+		pTag->lModified = (long)sStat.st_mtime;
+		if( S_ISDIR( sStat.st_mode ) )
+		{
+			// The modification time of a directory can be restored (touch -r) but
+			// its status change time can not.
+			alState[2] = (unsigned long)sStat.st_ctime;
+  #ifdef __linux__
+			alState[4] = (unsigned long)sStat.st_ctim.tv_nsec;
+  #endif /* __linux__ */
+			pTag->lModified = (long)(sStat.st_ctime > sStat.st_mtime ? sStat.st_ctime : sStat.st_mtime);
+		}
+	}
+#endif /* WIN32 */
+	for( pcByte = (const unsigned char *)alState, i = 0; i < sizeof(alState); i++ )
+	{
+		pTag->lHash = (pTag->lHash ^ pcByte[i]) * 16777619UL;
+	}
+	for( pcByte = (const unsigned char *)&pTag->lModified, i = 0; i < sizeof(long); i++ )
+	{
+		pTag->lHash = (pTag->lHash ^ pcByte[i]) * 16777619UL;
+	}
+	for( pcByte = (const unsigned char *)pcFullPath; *pcByte; pcByte++ )
+	{
+		pTag->lHash = (pTag->lHash ^ *pcByte) * 16777619UL;
+	}
+	for( pcByte = (const unsigned char *)(pcQuery ? pcQuery : ""); *pcByte; pcByte++ )
+	{
+		pTag->lHash = (pTag->lHash ^ *pcByte) * 16777619UL;
+	}
+	pTag->bValid = true;
+	return true;
+}
+
+/**
+*	getSysCount_NP
+*
+*		Returns the address of the system call counters. The counters reflect the
+*		number of directories opened, the number of directory read calls, the number
+*		of file status calls and the number of batched file status submissions made
+*		since the application started.
+*
+*	@return		Address SYS_COUNT struct.
+**/
+SYS_COUNT *getSysCount_NP( void )
+{
+	return &sysCount;
+}
+
+/**
+*	removeFile_NP
+*
+*		Delete a file or an empty directory. If the file was returned by a directory
+*		search, and pvOsArgm is the OS specific argument of that search, the file is
+*		deleted relative to the open directory (POSIX only). Otherwise the file is
+*		deleted using its full path. A symbolic link is deleted itself, never its
+*		target. Permissions are never changed, a file the file system refuses to
+*		delete is reported as such (EACCES or EPERM).
+*
+*	@param	pFileInfo		Address FILE_INFO struct of the file.
+*	@param	pcRootDir		Address C-string containing the root directory.
+*	@param	pvOsArgm		Address OS specific argument of the directory search or NULL.
+*
+*	@return		0 if successful otherwise -1 (errno holds the error code).
+**/
+int removeFile_NP( FILE_INFO *pFileInfo, char *pcRootDir, void *pvOsArgm )
+{
+	char	cFullPath[MAX_PATH_SIZE];
+#ifndef WIN32
+	OS_ARG	*pOSArg = (OS_ARG *)pvOsArgm;
+	int		iFlags  = (pFileInfo->directory && !pFileInfo->bIsLink) ? AT_REMOVEDIR : 0;
+
+	if( pOSArg && pOSArg->iDirFd != -1 )
+	{
+		return unlinkat( pOSArg->iDirFd, pFileInfo->pcName, iFlags );
+	}
+#else
+	(void)pvOsArgm;
 #endif /* WIN32 */
+	snprintf( cFullPath, sizeof(cFullPath)-1, "%s/%s%s", pcRootDir, pFileInfo->pcDir, pFileInfo->pcName );
+	normalizePath( cFullPath );
+	return (pFileInfo->directory && !pFileInfo->bIsLink) ? rmdir( cFullPath ) : remove( cFullPath );
 }
@@ -13,23 +13,84 @@
   #define FindFirstFile		FindFirstFileA
   #define FindNextFile		FindNextFileA
   #define WIN32_FIND_DATA	WIN32_FIND_DATAA
+#else
+  #include <dirent.h>
 #endif /* WIN32 */
 
 #include "cbtreeFiles.h"
 
+#define DIRENT_BUF_SIZE		65536		// Size of the Linux getdents64() batch buffer.
+#define IO_RING_ENTRIES		256			// Size of the io_uring submission queue.
+
+// File status of a directory entry.
+#define STAT_V_NONE			0			// Classified by its entry type, no stat required.
+#define STAT_V_PENDING		1			// Stat required but not yet performed.
+#define STAT_V_OK			2			// File status available.
+#define STAT_V_FAILED		3			// File status unavailable (file vanished).
+
+#ifndef WIN32
+typedef struct dirEntry {
+	size_t		iName;					// Offset of the filename in the name pool.
+	int			iStatus;				// File status (STAT_V_xxx)
+	bool		directory;				// True if file is a directory
+	bool		bLink;					// True if file is a symbolic link (iStatus == STAT_V_OK only)
+	long		lSize;					// File size (iStatus == STAT_V_OK only)
+	long		lModified;				// Last modified (iStatus == STAT_V_OK only)
+	unsigned long	lDevice;			// Device of the file (iLinks > 0 only)
+	unsigned long	lInode;				// Inode of the file (iLinks > 0 only)
+	int			iLinks;					// Number of hard links (0 = unknown)
+} DIR_ENTRY;
+#endif /* WIN32 */
+
 typedef struct OS_ARG {
 #ifdef WIN32
 	HANDLE		handle;
+#else
+  #ifdef __linux__
+	DIR_ENTRY	*pEntries;				// All entries of the directory level.
+	int			iCount;					// Number of entries
+	int			iSize;					// Number of entries allocated.
+	int			iNext;					// Index of the next entry to be returned.
+	char		*pcNames;				// Filename pool
+	size_t		iNameLen;				// Number of bytes used in the filename pool.
+	size_t		iNameSize;				// Number of bytes allocated for the filename pool.
+  #else
+	DIR			*pDir;					// Directory stream (owns iDirFd)
+  #endif /* __linux__ */
+	int			iDirFd;					// Directory file descriptor, all children are
+										// stat-ed relative to this descriptor.
+	size_t		iRelLen;				// Length of the relative directory path.
+	char		cRelPath[MAX_PATH_SIZE];	// Relative directory path ("./dir/")
+	char		*pcRelDir;				// Relative directory path shared by all files (request arena only)
 #endif /* WIN32 */
 } OS_ARG;
 
+// System call counters (per request).
+typedef struct sysCount {
+	long		lOpen;					// Number of directories opened.
+	long		lRead;					// Number of directory read calls.
+	long		lStat;					// Number of file status calls.
+	long		lSubmit;				// Number of batched file status submissions.
+} SYS_COUNT;
+
+// File validator used to answer conditional requests.
+typedef struct fileTag {
+	unsigned long	lHash;				// Hash of the file identity and state.
+	long			lModified;			// Last modified (seconds since Jan 1, 1970) or -1
+	bool			bValid;				// False if no validator is available.
+} FILE_TAG;
+
 #ifdef __cplusplus
 	extern "C" {
 #endif
 
 FILE_INFO *findFile_NP( char *pcFullPath, char *pcRootDir, void *pvOsArgm, ARGS *pArgs, int *piResult );
 FILE_INFO *findNextFile_NP( char *pcFullPath, char *pcRootDir, void *pvOsArgm, ARGS *pArgs );
+bool findSkipFile_NP( char *pcFullPath, char *pcRootDir, void *pvOsArgm, ARGS *pArgs );
 void findEnd_NP( void *pvOsArg );
+bool getFileTag_NP( const char *pcFullPath, const char *pcQuery, bool bDeep, int iNeedMask, FILE_TAG *pTag );
+SYS_COUNT *getSysCount_NP( void );
+int removeFile_NP( FILE_INFO *pFileInfo, char *pcRootDir, void *pvOsArgm );
 
 #ifdef __cplusplus
 	}